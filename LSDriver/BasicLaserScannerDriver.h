@@ -0,0 +1,204 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "LaserScannerDriver.h"
+#include "ScanLookup.h"
+#include "ScanValidation.h"
+
+// Variante di LaserScannerDriver in cui risoluzione angolare e capacità del buffer sono note in fase di compilazione.
+// Il numero di misurazioni è constexpr e il buffer è un std::array interno all'oggetto: nessuna allocazione nel free store e cicli con numero
+// di iterazioni fisso. LaserScannerDriver resta la versione "dinamica", da usare quando la risoluzione è nota solo a runtime.
+//
+// Invarianti:
+// - Resolution >= 0.1 && Resolution <= 1 && Capacity >= 1 (verificate con static_assert)
+// - size_ >= 0 && size_ <= Capacity, front_ e back_ nel range [0, kSlots) con back_ == (front_ + size_) % kSlots
+// - il buffer ha kSlots == Capacity + 1 slot: lo slot back_ non contiene mai una scansione valida, nemmeno a buffer pieno
+// - lo slot i-esimo inizia in buffer_.data() + i * kStride
+//
+// Nota: con risoluzione 0.1 ogni scansione occupa circa 14 KB, che vanno moltiplicati per Capacity + 1. Se l'oggetto è grande conviene allocarlo
+// nel free store (ad esempio con std::make_unique) piuttosto che sullo stack
+template <double Resolution, int Capacity>
+class BasicLaserScannerDriver
+{
+	static_assert(Resolution >= 0.1 && Resolution <= 1, "Scanner resolution must be in the range [ 0.1 , 1 ]");
+	static_assert(Capacity >= 1, "Buffer capacity must be at least 1");
+
+public:
+	static constexpr double kMaxAngle = LaserScannerDriver::kMaxAngle;
+	/*!
+	 * @brief Numero di misurazioni per scansione. Per angoli positivi il cast tronca come floor(), quindi il valore coincide con quello calcolato
+	 * da evalute_measurement_index(kMaxAngle, Resolution) + 1 nella versione dinamica
+	*/
+	static constexpr int kMeasurements = static_cast<int>(kMaxAngle / Resolution) + 1;
+	using EmptyBufferException = LaserScannerDriver::EmptyBufferException;
+
+	BasicLaserScannerDriver() = default;
+
+	/*!
+	 * @brief Inserisce la scansione fornita nel buffer, scartando la meno recente se il buffer è pieno.
+	 * @details Come in LaserScannerDriver: i valori oltre kMeasurements vengono ignorati, quelli mancanti valgono 0 e le misurazioni non valide sono
+	 * gestite secondo invalid_value_policy()
+	 * @return il numero di misurazioni non valide sostituite (sempre 0 con la politica kThrow)
+	 * @throws std::invalid_argument se la politica è kThrow e la scansione contiene misurazioni non valide. La scansione non viene inserita
+	*/
+	int new_scan(std::span<const double> scan)
+	{
+		//Lo slot back_ è sempre libero: la scansione viene validata lì e la meno recente viene scartata solo se la validazione riesce
+		double* dest = slot(back_);
+		ValidationResult result;
+		if (scan.size() >= static_cast<std::size_t>(kMeasurements))		//Caso comune: il ciclo ha kMeasurements iterazioni, note in compilazione
+			result = copy_validated<kMeasurements>(scan.data(), dest, invalid_policy_);
+		else
+		{
+			int min_size = static_cast<int>(scan.size());
+			result = copy_validated(scan.data(), dest, min_size, invalid_policy_);
+			std::fill(dest + min_size, dest + kMeasurements, 0.0);
+		}
+
+		if (is_full())
+		{
+			front_ = next_circular_index(front_);
+			size_--;
+		}
+		back_ = next_circular_index(back_);
+		size_++;
+		return result.invalid_count();
+	}
+	int new_scan(const std::vector<double>& v) { return new_scan(std::span<const double>(v)); }
+
+	/*!
+	 * @brief Ritorna la scansione più vecchia, eliminandola dal buffer.
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::vector<double> get_scan()
+	{
+		std::span<const double> oldest = oldest_scan();
+		std::vector<double> v(oldest.begin(), oldest.end());
+		front_ = next_circular_index(front_);
+		size_--;
+		return v;
+	}
+
+	/*!
+	 * @brief Elimina tutte le scansioni
+	*/
+	void clear_buffer() { front_ = back_ = size_ = 0; }
+
+	/*!
+	 * @brief Ritorna la distanza della scansione più recente presente all'angolo fornito, approssimando al valore più vicino
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se angle è NaN
+	*/
+	double get_distance(double angle) const
+	{
+		if (std::isnan(angle))
+			throw std::invalid_argument("The given angle is Not A Number (NaN)");
+
+		return newest_scan()[nearest_measurement_index(angle, kInverseResolution, kMeasurements - 1)];
+	}
+
+	/*!
+	 * @brief Versione "a lotti" di get_distance(), vedi LaserScannerDriver::get_distances()
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se distances è più piccolo di angles o se almeno un angolo è NaN
+	*/
+	void get_distances(std::span<const double> angles, std::span<double> distances) const
+	{
+		if (distances.size() < angles.size())
+			throw std::invalid_argument("The output span is smaller than the number of angles");
+
+		const double* last_scan = newest_scan().data();
+		if (!lookup_distances(last_scan, kMeasurements - 1, kInverseResolution, angles.data(), distances.data(), static_cast<int>(angles.size())))
+			throw std::invalid_argument("The given angle is Not A Number (NaN)");
+	}
+
+	/*!
+	 * @brief Vista (senza copia né rimozione) sulla scansione meno recente, valida fino alla prossima modifica del buffer
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::span<const double, kMeasurements> oldest_scan() const
+	{
+		if (is_empty())
+			throw EmptyBufferException();
+		return std::span<const double, kMeasurements>(slot(front_), kMeasurements);
+	}
+
+	/*!
+	 * @brief Vista (senza copia né rimozione) sulla scansione più recente, valida fino alla prossima modifica del buffer
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::span<const double, kMeasurements> newest_scan() const
+	{
+		if (is_empty())
+			throw EmptyBufferException();
+		return std::span<const double, kMeasurements>(slot(previous_circular_index(back_)), kMeasurements);
+	}
+
+	static constexpr double angular_resolution() { return Resolution; }
+	static constexpr int capacity() { return Capacity; }
+	static constexpr int measurements() { return kMeasurements; }
+	inline int size() const { return size_; }
+	inline bool is_empty() const { return size_ == 0; }
+	inline bool is_full() const { return size_ == Capacity; }
+
+	inline InvalidValuePolicy invalid_value_policy() const { return invalid_policy_; }
+	inline void set_invalid_value_policy(InvalidValuePolicy policy) { invalid_policy_ = policy; }
+
+private:
+	static constexpr int kCacheLineSize = 64;
+	static constexpr int kDoublesPerCacheLine = kCacheLineSize / sizeof(double);
+	static constexpr int kStride = (kMeasurements + kDoublesPerCacheLine - 1) / kDoublesPerCacheLine * kDoublesPerCacheLine;
+	static constexpr double kInverseResolution = 1 / Resolution;
+	static constexpr int kSlots = Capacity + 1;		//Uno slot in più, sempre libero: una scansione rifiutata non fa scartare la meno recente
+
+	alignas(kCacheLineSize) std::array<double, static_cast<std::size_t>(kSlots) * kStride> buffer_{};
+	int front_ = 0;
+	int back_ = 0;
+	int size_ = 0;
+	InvalidValuePolicy invalid_policy_ = InvalidValuePolicy::kThrow;
+
+	static constexpr int next_circular_index(int index) { return (index + 1) % kSlots; }
+	static constexpr int previous_circular_index(int index) { return (index - 1 + kSlots) % kSlots; }
+	inline double* slot(int index) { return buffer_.data() + static_cast<std::size_t>(index) * kStride; }
+	inline const double* slot(int index) const { return buffer_.data() + static_cast<std::size_t>(index) * kStride; }
+};
+
+/*!
+ * @brief Stampa la scansione più recente di un BasicLaserScannerDriver, con lo stesso formato usato per LaserScannerDriver
+*/
+template <double Resolution, int Capacity>
+std::ostream& operator<< (std::ostream& os, const BasicLaserScannerDriver<Resolution, Capacity>& lsd)
+{
+	if (lsd.is_empty())
+		os << "No scan found in the buffer. Cannot print most recent scan.";
+	else
+	{
+		std::span<const double> scan = lsd.newest_scan();
+		constexpr int values_per_row = 4;
+		for (int i = 0; i < values_per_row; i++)
+			os << std::setw(10) << "Angle" << std::setw(9) << " Value";
+		os << std::endl;
+		os << std::fixed << std::setprecision(3);
+		for (int i = 0; i < lsd.measurements(); i++)
+		{
+			os << std::setw(9) << i * lsd.angular_resolution() << ":" << std::setw(8) << scan[i] << ",";
+			if ((i + 1) % values_per_row == 0)
+				os << std::endl;
+		}
+	}
+	os << std::endl;
+	return os;
+}
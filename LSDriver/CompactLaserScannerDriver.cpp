@@ -0,0 +1,228 @@
+#include "CompactLaserScannerDriver.h"
+#include "ScanLookup.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+CompactLaserScannerDriver::CompactLaserScannerDriver(double resolution, int capacity, StoragePrecision precision, double scale)
+	: angular_resolution_{ resolution }, capacity_{ capacity }, measurements_{ 0 }, precision_{ precision }, scale_{ scale }, stride_{ 0 },
+	front_{ 0 }, back_{ 0 }, size_{ 0 }, invalid_policy_{ InvalidValuePolicy::kThrow }
+{
+	measurements_ = measurement_count(resolution);
+	if (capacity < 1)
+		throw out_of_range("Buffer capacity " + to_string(capacity) + " invalid: must be at least 1");
+	if (!(scale > 0) || isinf(scale))
+		throw out_of_range("Storage scale " + to_string(scale) + " invalid: must be positive");
+
+	stride_ = (measurements_ * storage_size(precision_) + 15) / 16 * 16;
+	storage_.resize(static_cast<size_t>(capacity_) * stride_);
+	staging_.resize(measurements_);
+}
+
+CompactLaserScannerDriver::CompactLaserScannerDriver(CompactLaserScannerDriver&& lsd) noexcept
+	: angular_resolution_{ lsd.angular_resolution_ }, capacity_{ lsd.capacity_ }, measurements_{ lsd.measurements_ }, precision_{ lsd.precision_ },
+	scale_{ lsd.scale_ }, stride_{ lsd.stride_ }, front_{ lsd.front_ }, back_{ lsd.back_ }, size_{ lsd.size_ }, invalid_policy_{ lsd.invalid_policy_ },
+	storage_{ std::move(lsd.storage_) }, staging_{ std::move(lsd.staging_) }
+{
+	lsd.reset_moved();
+}
+
+CompactLaserScannerDriver& CompactLaserScannerDriver::operator=(CompactLaserScannerDriver&& lsd) noexcept
+{
+	angular_resolution_ = lsd.angular_resolution_;
+	capacity_ = lsd.capacity_;
+	measurements_ = lsd.measurements_;
+	precision_ = lsd.precision_;
+	scale_ = lsd.scale_;
+	stride_ = lsd.stride_;
+	front_ = lsd.front_;
+	back_ = lsd.back_;
+	size_ = lsd.size_;
+	invalid_policy_ = lsd.invalid_policy_;
+	storage_ = std::move(lsd.storage_);
+	staging_ = std::move(lsd.staging_);
+	lsd.reset_moved();
+	return *this;
+}
+
+void CompactLaserScannerDriver::reset_moved()
+{
+	//Stesso stato "non valido" di un LaserScannerDriver spostato: vuoto e senza slot
+	storage_.clear();
+	staging_.clear();
+	angular_resolution_ = 0;
+	capacity_ = measurements_ = stride_ = front_ = back_ = size_ = 0;
+}
+
+int CompactLaserScannerDriver::new_scan(const vector<double>& vec)
+{
+	//La validazione avviene nel buffer di appoggio, prima di toccare il buffer: se viene lanciata eccezione la scansione meno recente non viene scartata
+	int min_size = min(static_cast<int>(vec.size()), measurements_);
+	ValidationResult result = copy_validated(vec.data(), staging_.data(), min_size, invalid_policy_);
+	fill(staging_.begin() + min_size, staging_.end(), 0.0);
+
+	if (is_full())
+	{
+		front_ = (front_ + 1) % capacity_;
+		size_--;
+	}
+
+	byte* dest = slot(back_);
+	switch (precision_)
+	{
+	case StoragePrecision::kDouble:
+		memcpy(dest, staging_.data(), measurements_ * sizeof(double));
+		break;
+	case StoragePrecision::kFloat:
+		quantize(staging_.data(), reinterpret_cast<float*>(dest), measurements_);
+		break;
+	case StoragePrecision::kFixed16:
+		quantize(staging_.data(), reinterpret_cast<uint16_t*>(dest), measurements_, 1 / scale_);
+		break;
+	}
+
+	back_ = (back_ + 1) % capacity_;
+	size_++;
+	return result.invalid_count();
+}
+
+void CompactLaserScannerDriver::read_slot(int index, double* dest) const
+{
+	const byte* src = slot(index);
+	switch (precision_)
+	{
+	case StoragePrecision::kDouble:
+		memcpy(dest, src, measurements_ * sizeof(double));
+		break;
+	case StoragePrecision::kFloat:
+		dequantize(reinterpret_cast<const float*>(src), dest, measurements_);
+		break;
+	case StoragePrecision::kFixed16:
+		dequantize(reinterpret_cast<const uint16_t*>(src), dest, measurements_, scale_);
+		break;
+	}
+}
+
+double CompactLaserScannerDriver::read_measurement(int index, int measurement) const
+{
+	const byte* src = slot(index);
+	switch (precision_)
+	{
+	case StoragePrecision::kFloat:
+		return reinterpret_cast<const float*>(src)[measurement];
+	case StoragePrecision::kFixed16:
+	{
+		uint16_t value = reinterpret_cast<const uint16_t*>(src)[measurement];
+		return value == kFixed16Invalid ? numeric_limits<double>::quiet_NaN() : value * scale_;
+	}
+	default:
+		return reinterpret_cast<const double*>(src)[measurement];
+	}
+}
+
+vector<double> CompactLaserScannerDriver::get_scan()
+{
+	if (is_empty())
+		throw EmptyBufferException();
+
+	vector<double> scan(measurements_);
+	get_scan(scan);
+	return scan;
+}
+
+void CompactLaserScannerDriver::get_scan(span<double> scan)
+{
+	if (is_empty())
+		throw EmptyBufferException();
+	if (scan.size() < static_cast<size_t>(measurements_))
+		throw invalid_argument("The output span is smaller than the number of measurements");
+
+	read_slot(front_, scan.data());
+	front_ = (front_ + 1) % capacity_;
+	size_--;
+}
+
+void CompactLaserScannerDriver::newest_scan(span<double> scan) const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+	if (scan.size() < static_cast<size_t>(measurements_))
+		throw invalid_argument("The output span is smaller than the number of measurements");
+
+	read_slot((back_ - 1 + capacity_) % capacity_, scan.data());
+}
+
+void CompactLaserScannerDriver::clear_buffer()
+{
+	front_ = back_ = size_ = 0;
+}
+
+double CompactLaserScannerDriver::get_distance(double angle) const
+{
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	int measurement_index = nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1);
+	return read_measurement((back_ - 1 + capacity_) % capacity_, measurement_index);
+}
+
+void CompactLaserScannerDriver::get_distances(span<const double> angles, span<double> distances) const
+{
+	if (distances.size() < angles.size())
+		throw invalid_argument("The output span is smaller than the number of angles");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	int last_scan = (back_ - 1 + capacity_) % capacity_;
+	if (precision_ == StoragePrecision::kDouble)
+	{
+		//Le misurazioni sono già double: si usa direttamente la versione vettoriale di LaserScannerDriver
+		if (!lookup_distances(reinterpret_cast<const double*>(slot(last_scan)), measurements_ - 1, 1 / angular_resolution_, angles.data(), distances.data(),
+			static_cast<int>(angles.size())))
+			throw invalid_argument("The given angle is Not A Number (NaN)");
+		return;
+	}
+
+	double inverse_resolution = 1 / angular_resolution_;
+	for (double angle : angles)
+		if (isnan(angle))
+			throw invalid_argument("The given angle is Not A Number (NaN)");
+	for (size_t i = 0; i < angles.size(); i++)
+		distances[i] = read_measurement(last_scan, nearest_measurement_index(angles[i], inverse_resolution, measurements_ - 1));
+}
+
+std::ostream& operator<< (std::ostream& os, const CompactLaserScannerDriver& lsd)
+{
+	if (lsd.is_empty())
+		os << "No scan found in the buffer. Cannot print most recent scan.";
+	else
+	{
+		vector<double> scan(lsd.measurements());
+		lsd.newest_scan(scan);
+		constexpr int values_per_row = 4;
+		for (int i = 0; i < values_per_row; i++)
+			os << setw(10) << "Angle" << setw(9) << " Value";
+		os << endl;
+		os << fixed;
+		os << setprecision(3);
+		for (int i = 0; i < lsd.measurements(); i++)
+		{
+			os << setw(9) << i * lsd.angular_resolution() << ":" << setw(8) << scan[i] << ",";
+
+			if ((i + 1) % values_per_row == 0)
+				os << endl;
+		}
+	}
+	os << endl;
+	return os;
+}
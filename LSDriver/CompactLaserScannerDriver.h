@@ -0,0 +1,144 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <vector>
+#include "LaserScannerDriver.h"
+#include "ScanQuantization.h"
+#include "ScanValidation.h"
+
+// Variante di LaserScannerDriver che memorizza le scansioni con una precisione ridotta scelta alla costruzione (StoragePrecision): float dimezza
+// la memoria del buffer, kFixed16 (ad esempio millimetri con scale = 0.001) la riduce a un quarto. Utile per buffer con molte scansioni su schede
+// con poca memoria, dove conta anche la banda verso la memoria.
+// L'interfaccia pubblica resta in double: le misurazioni vengono convertite (con istruzioni SSE2, se disponibili) in new_scan() e nei metodi di lettura.
+// Poichè le scansioni non sono memorizzate come double non esistono le viste senza copia di LaserScannerDriver (take_scan(), newest_scan() con span,
+// acquire_write_slot(), osservatori): le letture scrivono le distanze in un vector o in un buffer fornito dal chiamante.
+//
+// Invarianti:
+// - angular_resolution_ >= 0.1 && angular_resolution_ <= 1 && capacity_ >= 1
+// - measurements_ == evalute_measurement_index(kMaxAngle, angular_resolution_) + 1
+// - scale_ > 0 e finito; con kFixed16 la distanza memorizzata come v vale v * scale_ (NaN se v == kFixed16Invalid)
+// - lo slot i-esimo inizia in storage_.data() + i * stride_ e contiene measurements_ valori di storage_size(precision_) byte
+// - size_ >= 0 && size_ <= capacity_, front_ e back_ nel range [0, capacity_) con back_ == (front_ + size_) % capacity_
+// - dopo un move l'oggetto spostato è vuoto con capacity_ == 0: può solo essere distrutto o riassegnato
+class CompactLaserScannerDriver
+{
+public:
+	static constexpr double kMaxAngle = LaserScannerDriver::kMaxAngle;
+	using EmptyBufferException = LaserScannerDriver::EmptyBufferException;
+
+	/*!
+	 * @brief Crea il driver e alloca l'intero buffer, una sola volta
+	 * @param resolution risoluzione angolare del LIDAR
+	 * @param capacity numero massimo di scansioni mantenute nel buffer
+	 * @param precision precisione delle misurazioni memorizzate
+	 * @param scale con kFixed16, distanza rappresentata da un'unità (ignorata con le altre precisioni). La distanza massima memorizzabile è kFixed16Max * scale
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1], se capacity < 1 o se scale non è positiva
+	*/
+	explicit CompactLaserScannerDriver(double resolution = 1, int capacity = 2, StoragePrecision precision = StoragePrecision::kDouble, double scale = 0.001);
+	CompactLaserScannerDriver(const CompactLaserScannerDriver&) = default;
+	CompactLaserScannerDriver(CompactLaserScannerDriver&& lsd) noexcept;
+	CompactLaserScannerDriver& operator=(const CompactLaserScannerDriver&) = default;
+	CompactLaserScannerDriver& operator=(CompactLaserScannerDriver&& lsd) noexcept;
+
+	/*!
+	 * @brief Inserisce la scansione fornita nel buffer, scartando la meno recente se il buffer è pieno.
+	 * @details Come in LaserScannerDriver: i valori oltre measurements() vengono ignorati, quelli mancanti valgono 0 e le misurazioni non valide sono
+	 * gestite secondo invalid_value_policy(). Con kFixed16 le distanze vengono arrotondate al multiplo di scale() più vicino e saturate alla distanza massima
+	 * @return il numero di misurazioni non valide sostituite (sempre 0 con la politica kThrow)
+	 * @throws std::invalid_argument se la politica è kThrow e la scansione contiene misurazioni non valide. La scansione non viene inserita
+	*/
+	int new_scan(const std::vector<double>& v);
+	/*!
+	 * @brief Ritorna la scansione più vecchia, eliminandola dal buffer
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::vector<double> get_scan();
+	/*!
+	 * @brief Come get_scan(), ma scrive la scansione in scan senza allocare
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se scan ha meno di measurements() elementi (la scansione resta nel buffer)
+	*/
+	void get_scan(std::span<double> scan);
+	/*!
+	 * @brief Scrive in scan la scansione più recente, senza rimuoverla
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se scan ha meno di measurements() elementi
+	*/
+	void newest_scan(std::span<double> scan) const;
+	/*!
+	 * @brief Elimina tutte le scansioni
+	*/
+	void clear_buffer();
+	/*!
+	 * @brief Ritorna la distanza della scansione più recente all'angolo fornito, approssimando alla misurazione più vicina come LaserScannerDriver::get_distance()
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se angle è NaN
+	*/
+	double get_distance(double angle) const;
+	/*!
+	 * @brief Versione "a lotti" di get_distance(), vedi LaserScannerDriver::get_distances()
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se distances è più piccolo di angles o se almeno un angolo è NaN
+	*/
+	void get_distances(std::span<const double> angles, std::span<double> distances) const;
+
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int capacity() const { return capacity_; }
+	inline int measurements() const { return measurements_; }
+	inline int size() const { return size_; }
+	inline bool is_empty() const { return size_ == 0; }
+	inline bool is_full() const { return size_ == capacity_; }
+	inline StoragePrecision precision() const { return precision_; }
+	inline double scale() const { return scale_; }
+	/*!
+	 * @brief Byte occupati dal buffer delle scansioni
+	*/
+	inline std::size_t storage_bytes() const { return storage_.size(); }
+	inline InvalidValuePolicy invalid_value_policy() const { return invalid_policy_; }
+	inline void set_invalid_value_policy(InvalidValuePolicy policy) { invalid_policy_ = policy; }
+
+private:
+	//NOTA DI PROGETTAZIONE:
+	//Il buffer è un unico blocco di byte, come lo slab di LaserScannerDriver: il formato delle misurazioni è scelto a runtime, quindi lo slot viene
+	//interpretato come array di double, float o uint16_t in base a precision_. stride_ è arrotondato a 16 byte così che ogni slot sia allineato
+	//per qualsiasi formato. La copia del driver copia il buffer (nessun copy-on-write: le scansioni sono già piccole)
+	double angular_resolution_;
+	int capacity_;
+	int measurements_;
+	StoragePrecision precision_;
+	double scale_;
+	int stride_;		//Distanza (in byte) tra l'inizio di due slot consecutivi
+	int front_;
+	int back_;
+	int size_;
+	InvalidValuePolicy invalid_policy_;
+	std::vector<std::byte> storage_;
+	std::vector<double> staging_;	//Scansione validata in new_scan(), prima della conversione. Allocata una sola volta nel costruttore
+
+	inline std::byte* slot(int index) { return storage_.data() + static_cast<std::size_t>(index) * stride_; }
+	inline const std::byte* slot(int index) const { return storage_.data() + static_cast<std::size_t>(index) * stride_; }
+	/*!
+	 * @brief Converte in double le misurazioni dello slot index
+	*/
+	void read_slot(int index, double* dest) const;
+	/*!
+	 * @brief Converte in double la misurazione measurement dello slot index
+	*/
+	double read_measurement(int index, int measurement) const;
+	/*!
+	 * @brief Invalida l'oggetto dopo che il buffer è stato spostato
+	*/
+	void reset_moved();
+};
+
+/*!
+ * @brief Stampa la scansione più recente, con lo stesso formato usato per LaserScannerDriver
+*/
+std::ostream& operator<< (std::ostream& os, const CompactLaserScannerDriver& lsd);
@@ -0,0 +1,238 @@
+#include "ConcurrentLaserScannerDriver.h"
+#include "ScanLookup.h"
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+ConcurrentLaserScannerDriver::ConcurrentLaserScannerDriver(double resolution, int capacity, FullBufferPolicy full_policy) : angular_resolution_{ resolution },
+	capacity_{ capacity }, slot_count_{ capacity + 1 }, measurements_{ 0 }, stride_{ 0 }, full_policy_{ full_policy }, buffer_{ nullptr }, head_{ 0 }, tail_{ 0 },
+	consumer_waiting_{ false }, producer_waiting_{ false }, subscriber_count_{ 0 }, next_subscriber_id_{ 1 }
+{
+	measurements_ = measurement_count(resolution);
+	if (capacity < 1)
+		throw out_of_range("Buffer capacity " + to_string(capacity) + " invalid: must be at least 1");
+
+	stride_ = (measurements_ + kDoublesPerCacheLine - 1) / kDoublesPerCacheLine * kDoublesPerCacheLine;
+
+	size_t values = static_cast<size_t>(slot_count_) * stride_;
+	sequences_ = make_unique<SlotSequence[]>(slot_count_);
+	buffer_ = static_cast<double*>(::operator new[](values * sizeof(double), align_val_t{ kCacheLineSize }));
+	fill(buffer_, buffer_ + values, 0.0);
+}
+
+ConcurrentLaserScannerDriver::~ConcurrentLaserScannerDriver()
+{
+	::operator delete[](buffer_, align_val_t{ kCacheLineSize });
+}
+
+//NOTA DI PROGETTAZIONE (protocollo tra produttore e consumatore):
+//Il produttore, prima di scrivere uno slot, porta il suo contatore di sequenza ad un valore dispari e, terminata la scrittura, al valore committed_sequence().
+//Gli slot sono capacity_ + 1: lo slot della scansione tail_ non contiene mai una scansione valida, per cui il produttore valida e copia la nuova scansione
+//prima di decidere cosa fare a buffer pieno, e una scansione rifiutata dalla validazione non fa scartare la meno recente.
+//Solo dopo pubblica la scansione incrementando tail_ (release). Se il buffer è pieno scarta la scansione meno recente con una compare_exchange su head_:
+//se fallisce vuol dire che il consumatore l'ha appena prelevata e quindi il buffer non è più pieno.
+//Il consumatore copia lo slot e controlla che il contatore di sequenza non sia cambiato durante la copia (seqlock). Solo allora "prenota" la scansione
+//con una compare_exchange su head_: se il produttore l'ha scartata nel frattempo la copia viene buttata e si riprova con la nuova scansione meno recente.
+//Così il consumatore non restituisce mai una scansione parzialmente sovrascritta, e con kOverwriteOldest il produttore non si blocca mai.
+//Lo slot copiato può essere sovrascritto solo se, durante la copia, il produttore scarta quella scansione e ne inserisce altre capacity_.
+//Con kBlockProducer e kRejectNewest il produttore non tocca head_: a buffer pieno attende o rinuncia, e lo slot in tail_ non può essere quello
+//che il consumatore sta copiando
+bool ConcurrentLaserScannerDriver::new_scan(const vector<double>& vec, Clock::time_point timestamp)
+{
+	uint64_t tail = tail_.load(memory_order_relaxed);		//Solo questo thread modifica tail_
+	const uint64_t capacity = static_cast<uint64_t>(capacity_);
+
+	atomic<uint64_t>& seq = sequence(tail);
+	seq.store(committed_sequence(tail) - 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);				//La scrittura dei valori non può essere anticipata prima del valore dispari
+
+	double* dest = slot(tail);
+	int min_size = min(static_cast<int>(vec.size()), measurements_);
+	//Se viene lanciata l'eccezione lo slot non viene pubblicato: tail_ e head_ non cambiano e nessun lettore lo considera valido
+	copy_validated(vec.data(), dest, min_size, InvalidValuePolicy::kThrow);
+	fill(dest + min_size, dest + measurements_, 0.0);
+	sequences_[tail % slot_count_].timestamp = timestamp;
+
+	uint64_t head = head_.load(memory_order_acquire);
+	bool dropped = false;
+	if (tail - head == capacity)
+	{
+		switch (full_policy_)
+		{
+		case FullBufferPolicy::kOverwriteOldest:
+			dropped = head_.compare_exchange_strong(head, head + 1, memory_order_acq_rel, memory_order_acquire);
+			break;
+		case FullBufferPolicy::kRejectNewest:
+			return true;
+		case FullBufferPolicy::kBlockProducer:
+		{
+			unique_lock<mutex> lock(wait_mutex_);
+			producer_waiting_.store(true, memory_order_seq_cst);
+			atomic_thread_fence(memory_order_seq_cst);
+			space_available_.wait(lock, [&] { return tail - head_.load(memory_order_seq_cst) < capacity; });
+			producer_waiting_.store(false, memory_order_relaxed);
+			break;
+		}
+		}
+	}
+
+	seq.store(committed_sequence(tail), memory_order_release);
+	tail_.store(tail + 1, memory_order_release);
+	wake(consumer_waiting_, scan_available_);
+
+	if (subscriber_count_.load(memory_order_acquire) > 0)
+	{
+		lock_guard<mutex> lock(subscribers_mutex_);
+		for (const Subscriber& subscriber : subscribers_)
+			subscriber.callback(tail, timestamp);
+	}
+	return dropped;
+}
+
+void ConcurrentLaserScannerDriver::wake(atomic<bool>& waiting, condition_variable& condition)
+{
+	//La fence ordina la modifica di head_/tail_ appena eseguita prima della lettura del flag (vedi la nota di progettazione nell'header).
+	//Acquisire il mutex garantisce che il thread in attesa, se ha già controllato il buffer, sia entrato in wait() prima della notifica
+	atomic_thread_fence(memory_order_seq_cst);
+	if (waiting.load(memory_order_relaxed))
+	{
+		{
+			lock_guard<mutex> lock(wait_mutex_);
+		}
+		condition.notify_one();
+	}
+}
+
+vector<double> ConcurrentLaserScannerDriver::get_scan()
+{
+	vector<double> v;
+	Clock::time_point timestamp;
+	if (!try_get_scan(v, timestamp))
+		throw EmptyBufferException();
+	return v;
+}
+
+bool ConcurrentLaserScannerDriver::try_get_scan(vector<double>& v, Clock::time_point& timestamp)
+{
+	while (true)
+	{
+		uint64_t head = head_.load(memory_order_acquire);
+		uint64_t tail = tail_.load(memory_order_acquire);
+		if (head == tail)
+			return false;
+		v.resize(measurements_);		//Alloca solo alla prima chiamata con un vector vuoto
+
+		const atomic<uint64_t>& seq = sequence(head);
+		uint64_t before = seq.load(memory_order_acquire);
+		if (before != committed_sequence(head))				//Il produttore sta già sovrascrivendo lo slot: head_ è stato spostato, riprovo
+			continue;
+
+		const double* src = slot(head);
+		copy(src, src + measurements_, v.begin());
+		Clock::time_point scan_timestamp = sequences_[head % slot_count_].timestamp;
+
+		atomic_thread_fence(memory_order_acquire);			//La lettura del contatore non può essere anticipata prima della copia
+		if (seq.load(memory_order_relaxed) != before)
+			continue;
+
+		if (head_.compare_exchange_strong(head, head + 1, memory_order_acq_rel, memory_order_acquire))
+		{
+			timestamp = scan_timestamp;
+			scans_removed();
+			return true;
+		}
+	}
+}
+
+bool ConcurrentLaserScannerDriver::wait_scan(vector<double>& v, Clock::time_point& timestamp, chrono::nanoseconds timeout)
+{
+	Clock::time_point deadline = Clock::now() + timeout;
+	while (true)
+	{
+		if (try_get_scan(v, timestamp))
+			return true;
+
+		unique_lock<mutex> lock(wait_mutex_);
+		consumer_waiting_.store(true, memory_order_seq_cst);
+		atomic_thread_fence(memory_order_seq_cst);
+		bool available = scan_available_.wait_until(lock, deadline,
+			[this] { return tail_.load(memory_order_seq_cst) > head_.load(memory_order_seq_cst); });
+		consumer_waiting_.store(false, memory_order_relaxed);
+		if (!available)
+			return false;
+		//La scansione viene prelevata fuori dal lock: se nel frattempo il produttore l'ha scartata (kOverwriteOldest) ce n'è comunque una più recente
+	}
+}
+
+uint64_t ConcurrentLaserScannerDriver::subscribe(function<void(uint64_t, Clock::time_point)> callback)
+{
+	lock_guard<mutex> lock(subscribers_mutex_);
+	uint64_t id = next_subscriber_id_++;
+	subscribers_.push_back(Subscriber{ id, std::move(callback) });
+	subscriber_count_.store(static_cast<int>(subscribers_.size()), memory_order_release);
+	return id;
+}
+
+bool ConcurrentLaserScannerDriver::unsubscribe(uint64_t id)
+{
+	lock_guard<mutex> lock(subscribers_mutex_);
+	auto it = find_if(subscribers_.begin(), subscribers_.end(), [id](const Subscriber& subscriber) { return subscriber.id == id; });
+	if (it == subscribers_.end())
+		return false;
+	subscribers_.erase(it);
+	subscriber_count_.store(static_cast<int>(subscribers_.size()), memory_order_release);
+	return true;
+}
+
+void ConcurrentLaserScannerDriver::clear_buffer()
+{
+	uint64_t head = head_.load(memory_order_acquire);
+	uint64_t tail = tail_.load(memory_order_acquire);
+
+	//Se la compare_exchange fallisce il produttore ha scartato delle scansioni: head viene aggiornato e si riprova finchè ci sono scansioni da eliminare
+	while (head < tail && !head_.compare_exchange_weak(head, tail, memory_order_acq_rel, memory_order_acquire))
+		;
+	scans_removed();
+}
+
+double ConcurrentLaserScannerDriver::get_distance(double angle) const
+{
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	//Stessa conversione di LaserScannerDriver::get_distance(): l'indice non supera mai l'ultima misurazione (evalute_measurement_index() arrotonda
+	//per eccesso gli angoli appena inferiori a kMaxAngle, che con alcune risoluzioni finirebbero sul riempimento dello slot)
+	int measurement_index = nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1);
+
+	while (true)
+	{
+		uint64_t tail = tail_.load(memory_order_acquire);
+		uint64_t head = head_.load(memory_order_acquire);
+		if (head == tail)
+			throw EmptyBufferException();
+		if (head > tail)									//tail_ letto prima di un inserimento e head_ dopo: istantanea non consistente
+			continue;
+
+		uint64_t last_scan = tail - 1;
+		const atomic<uint64_t>& seq = sequence(last_scan);
+		uint64_t before = seq.load(memory_order_acquire);
+		if (before != committed_sequence(last_scan))
+			continue;
+
+		double distance = slot(last_scan)[measurement_index];
+
+		atomic_thread_fence(memory_order_acquire);
+		if (seq.load(memory_order_relaxed) == before)
+			return distance;
+	}
+}
+
+int ConcurrentLaserScannerDriver::size() const
+{
+	uint64_t tail = tail_.load(memory_order_acquire);
+	uint64_t head = head_.load(memory_order_acquire);
+	return head < tail ? static_cast<int>(tail - head) : 0;
+}
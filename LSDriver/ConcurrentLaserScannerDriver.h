@@ -0,0 +1,197 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LaserScannerDriver.h"
+
+/*!
+ * @brief Comportamento di ConcurrentLaserScannerDriver::new_scan() a buffer pieno
+*/
+enum class FullBufferPolicy
+{
+	kOverwriteOldest,	//La scansione meno recente viene scartata (latenza minima, comportamento storico)
+	kBlockProducer,		//Il produttore attende che il consumatore prelevi una scansione (nessuna perdita, il produttore può rallentare)
+	kRejectNewest		//La nuova scansione viene scartata: il consumatore riceve le scansioni più vecchie senza buchi
+};
+
+// Variante di LaserScannerDriver utilizzabile da due thread contemporaneamente senza lock: un solo thread produttore (new_scan())
+// e un solo thread consumatore (get_scan(), wait_scan(), get_distance(), clear_buffer()).
+// Il consumatore può attendere una scansione con wait_scan() invece di interrogare il buffer a vuoto, oppure registrare una funzione con subscribe()
+// che viene chiamata ad ogni inserimento (ad esempio per riprendere una coroutine o accodare un lavoro in un executor).
+//
+// Invarianti:
+// - angular_resolution_ >= 0.1 && angular_resolution_ <= 1
+// - capacity_ >= 1
+// - slot_count_ == capacity_ + 1: lo slot della scansione tail_ non contiene mai una scansione valida, nemmeno a buffer pieno
+// - head_ e tail_ sono contatori monotoni (non vengono mai riportati a 0): la scansione n-esima inserita risiede nello slot n % slot_count_
+// - head_ <= tail_ && tail_ - head_ <= capacity_. Le scansioni valide sono quelle di indice [head_, tail_)
+// - tail_ viene modificato solo dal produttore, head_ dal consumatore e dal produttore (quest'ultimo solo per scartare la scansione meno recente a buffer pieno)
+// - sequences_[n % slot_count_] == 2 * n + 2 se e solo se lo slot contiene la scansione n-esima completamente scritta.
+//   Un valore dispari indica che il produttore sta scrivendo lo slot
+// - con kBlockProducer e kRejectNewest head_ viene modificato solo dal consumatore
+class ConcurrentLaserScannerDriver
+{
+public:
+	static constexpr double kMaxAngle = LaserScannerDriver::kMaxAngle;
+	using EmptyBufferException = LaserScannerDriver::EmptyBufferException;
+	using Clock = std::chrono::steady_clock;
+
+	/*!
+	 * @brief Crea una nuova istanza di ConcurrentLaserScannerDriver allocando tutto il buffer
+	 * @param resolution risoluzione angolare del LIDAR
+	 * @param capacity numero massimo di scansioni mantenute nel buffer
+	 * @param full_policy comportamento di new_scan() a buffer pieno
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1] o se capacity < 1
+	*/
+	explicit ConcurrentLaserScannerDriver(double resolution = 1, int capacity = 2, FullBufferPolicy full_policy = FullBufferPolicy::kOverwriteOldest);
+	/*!
+	 * @brief Distruttore, rilascia lo slab. Nessun thread deve usare l'oggetto durante la distruzione
+	*/
+	~ConcurrentLaserScannerDriver();
+
+	//Nota di progettazione:
+	//L'oggetto è condiviso tra due thread che ne tengono un riferimento: copiarlo o spostarlo mentre uno dei due thread lo sta usando non avrebbe senso,
+	//per cui copia e move sono disabilitati
+	ConcurrentLaserScannerDriver(const ConcurrentLaserScannerDriver&) = delete;
+	ConcurrentLaserScannerDriver& operator=(const ConcurrentLaserScannerDriver&) = delete;
+
+	/*!
+	 * @brief Inserisce la scansione fornita nel buffer. Se il buffer è pieno si comporta secondo full_buffer_policy(): con kBlockProducer attende
+	 * (senza limite di tempo) che il consumatore prelevi una scansione.
+	 * @details Da invocare solo dal thread produttore. Risveglia un consumatore in attesa in wait_scan() e chiama le funzioni registrate con subscribe()
+	 * @param timestamp istante di acquisizione della scansione, restituito insieme alla scansione da try_get_scan()
+	 * @return true se una scansione è andata persa: la meno recente con kOverwriteOldest, quella fornita con kRejectNewest
+	 * @throws std::invalid_argument se la scansione contiene NaN o valori negativi (la scansione non viene inserita)
+	*/
+	bool new_scan(const std::vector<double>& v, Clock::time_point timestamp = Clock::now());
+	/*!
+	 * @brief Ritorna la scansione più vecchia, eliminandola dal buffer. La scansione ritornata non è mai parzialmente sovrascritta dal produttore.
+	 * @details Da invocare solo dal thread consumatore
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::vector<double> get_scan();
+	/*!
+	 * @brief Come get_scan(), ma senza eccezioni a buffer vuoto: la scansione viene scritta in v (riutilizzandone la memoria) insieme al suo timestamp.
+	 * @details Da invocare solo dal thread consumatore
+	 * @return false se il buffer è vuoto (v e timestamp non vengono modificati)
+	*/
+	bool try_get_scan(std::vector<double>& v, Clock::time_point& timestamp);
+	/*!
+	 * @brief Come try_get_scan(), ma se il buffer è vuoto attende (senza consumare CPU) l'inserimento di una scansione, al più per timeout.
+	 * @details Da invocare solo dal thread consumatore
+	 * @return false se entro timeout non è stata inserita alcuna scansione (v e timestamp non vengono modificati)
+	*/
+	bool wait_scan(std::vector<double>& v, Clock::time_point& timestamp, std::chrono::nanoseconds timeout);
+	/*!
+	 * @brief Registra una funzione chiamata dal thread produttore dopo ogni scansione inserita, con il numero progressivo della scansione
+	 * (a partire da 0) e il suo timestamp. La funzione deve essere breve e non deve chiamare subscribe() o unsubscribe().
+	 * @details Può essere invocato da qualsiasi thread
+	 * @return l'identificativo da passare a unsubscribe()
+	*/
+	std::uint64_t subscribe(std::function<void(std::uint64_t sequence, Clock::time_point timestamp)> callback);
+	/*!
+	 * @brief Rimuove la funzione registrata con subscribe(). Al ritorno la funzione non è in esecuzione e non verrà più chiamata.
+	 * @details Può essere invocato da qualsiasi thread, ma non dalla funzione stessa
+	 * @return false se non esiste alcuna funzione con l'identificativo fornito
+	*/
+	bool unsubscribe(std::uint64_t id);
+	/*!
+	 * @brief Elimina tutte le scansioni presenti.
+	 * @details Da invocare solo dal thread consumatore
+	*/
+	void clear_buffer();
+	/*!
+	 * @brief Ritorna la distanza della scansione più recente presente all'angolo fornito, approssimando al valore più vicino come LaserScannerDriver::get_distance()
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se angle è NaN
+	*/
+	double get_distance(double angle) const;
+
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int capacity() const { return capacity_; }
+	inline int measurements() const { return measurements_; }
+	inline FullBufferPolicy full_buffer_policy() const { return full_policy_; }
+
+	//Nota di progettazione:
+	//Con due thread attivi i seguenti valori sono solo un'istantanea: possono cambiare subito dopo essere stati letti
+	int size() const;
+	inline bool is_empty() const { return size() == 0; }
+	inline bool is_full() const { return size() == capacity_; }
+
+private:
+	static constexpr int kCacheLineSize = 64;
+	static constexpr int kDoublesPerCacheLine = kCacheLineSize / sizeof(double);
+
+	/*!
+	 * @brief Contatore di sequenza di uno slot. Ogni contatore occupa una propria linea di cache per evitare false sharing tra slot vicini.
+	 * Il timestamp della scansione è protetto dal contatore come le misurazioni
+	*/
+	struct alignas(kCacheLineSize) SlotSequence
+	{
+		std::atomic<std::uint64_t> value{ 0 };
+		Clock::time_point timestamp{};
+	};
+
+	double angular_resolution_;
+	int capacity_;
+	int slot_count_;		//Uno slot in più della capacità, in cui il produttore valida la nuova scansione
+	int measurements_;
+	int stride_;
+
+	FullBufferPolicy full_policy_;
+
+	double* buffer_;								//Slab di slot_count_ * stride_ double, come in LaserScannerDriver
+	std::unique_ptr<SlotSequence[]> sequences_;
+
+	//head_ e tail_ su linee di cache diverse: il produttore scrive quasi sempre solo tail_, il consumatore solo head_
+	alignas(kCacheLineSize) std::atomic<std::uint64_t> head_;	//Indice della scansione meno recente
+	alignas(kCacheLineSize) std::atomic<std::uint64_t> tail_;	//Indice della prossima scansione da inserire
+
+	//NOTA DI PROGETTAZIONE:
+	//Le attese usano mutex e condition variable (le uniche primitive standard con timeout), ma solo nel caso lento: chi sta per attendere
+	//segnala la propria presenza in consumer_waiting_ / producer_waiting_ e ricontrolla il buffer sotto wait_mutex_. L'altro thread, dopo aver
+	//modificato tail_ o head_, legge il flag e acquisisce il mutex solo se qualcuno è in attesa: senza attese new_scan() e get_scan() restano senza lock.
+	//Flag e indici vengono scritti e letti con ordinamento seq_cst, così almeno uno dei due thread vede la modifica dell'altro (nessun risveglio perso)
+	alignas(kCacheLineSize) std::atomic<bool> consumer_waiting_;
+	std::atomic<bool> producer_waiting_;
+	std::mutex wait_mutex_;
+	std::condition_variable scan_available_;
+	std::condition_variable space_available_;
+
+	struct Subscriber
+	{
+		std::uint64_t id;
+		std::function<void(std::uint64_t, Clock::time_point)> callback;
+	};
+	std::atomic<int> subscriber_count_;			//Letto dal produttore senza lock: il mutex viene acquisito solo se ci sono funzioni registrate
+	std::mutex subscribers_mutex_;
+	std::vector<Subscriber> subscribers_;
+	std::uint64_t next_subscriber_id_;
+
+	inline double* slot(std::uint64_t index) { return buffer_ + (index % slot_count_) * stride_; }
+	inline const double* slot(std::uint64_t index) const { return buffer_ + (index % slot_count_) * stride_; }
+	inline std::atomic<std::uint64_t>& sequence(std::uint64_t index) const { return sequences_[index % slot_count_].value; }
+	/*!
+	 * @brief Valore del contatore di sequenza dello slot quando contiene la scansione index completamente scritta
+	*/
+	static inline std::uint64_t committed_sequence(std::uint64_t index) { return 2 * index + 2; }
+	/*!
+	 * @brief Risveglia il thread in attesa (se c'è) dopo che l'altro thread ha modificato head_ o tail_
+	*/
+	void wake(std::atomic<bool>& waiting, std::condition_variable& condition);
+	/*!
+	 * @brief Consumatore: head_ è stato spostato, il produttore bloccato (kBlockProducer) può proseguire
+	*/
+	inline void scans_removed() { if (full_policy_ == FullBufferPolicy::kBlockProducer) wake(producer_waiting_, space_available_); }
+};
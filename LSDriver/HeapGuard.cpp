@@ -0,0 +1,63 @@
+#include "HeapGuard.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+namespace
+{
+	thread_local int guard_depth = 0;		//Guardie attive nel thread
+	atomic<HeapGuard::ViolationHandler> violation_handler{ nullptr };
+	atomic<uint64_t> violation_count{ 0 };
+
+	void default_violation(size_t size)
+	{
+		//Niente iostream: la stampa non deve a sua volta allocare
+		fprintf(stderr, "HeapGuard: heap allocation of %zu bytes while the heap is forbidden\n", size);
+		abort();
+	}
+}
+
+HeapGuard::HeapGuard()
+{
+	guard_depth++;
+}
+
+HeapGuard::~HeapGuard()
+{
+	guard_depth--;
+}
+
+bool HeapGuard::armed()
+{
+	return guard_depth > 0;
+}
+
+HeapGuard::ViolationHandler HeapGuard::set_violation_handler(ViolationHandler handler)
+{
+	return violation_handler.exchange(handler, memory_order_acq_rel);
+}
+
+void HeapGuard::check_allocation(size_t size)
+{
+	if (guard_depth == 0)
+		return;
+
+	//Durante l'handler la guardia è sospesa, così può allocare senza generare altre violazioni. Viene ripristinata anche se l'handler lancia eccezione
+	struct Suspend
+	{
+		int depth = guard_depth;
+		Suspend() { guard_depth = 0; }
+		~Suspend() { guard_depth = depth; }
+	} suspend;
+
+	violation_count.fetch_add(1, memory_order_relaxed);
+	ViolationHandler handler = violation_handler.load(memory_order_acquire);
+	(handler ? handler : default_violation)(size);
+}
+
+uint64_t HeapGuard::violations()
+{
+	return violation_count.load(memory_order_relaxed);
+}
@@ -0,0 +1,63 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//NOTA DI PROGETTAZIONE:
+//Per accorgersi delle allocazioni sul free store gli operatori new e delete globali del programma vanno sostituiti con quelli di HeapGuardOperators.cpp
+//(che continuano ad usare malloc e free, come quelli della libreria standard). La sostituzione è opzionale e non fa parte della libreria: una
+//definizione di operator new in un archivio verrebbe collegata in ogni programma che alloca, anche senza usare HeapGuard, e andrebbe in conflitto
+//con gli operatori già sostituiti dal programma. Con CMake si collega il target lsdriver_heap_guard (una object library, sempre collegata per intero),
+//che definisce anche LSDRIVER_HEAP_GUARD_OPERATORS; senza CMake si compila HeapGuardOperators.cpp nel programma definendo la stessa macro.
+//Senza gli operatori sostitutivi HeapGuard non rileva nulla
+#if defined(LSDRIVER_HEAP_GUARD_OPERATORS)
+constexpr bool kHeapGuardEnabled = true;
+#else
+constexpr bool kHeapGuardEnabled = false;
+#endif
+
+// Guardia RAII per la modalità di debug dei sistemi real-time: finchè è in vita, ogni allocazione del thread che l'ha creata che raggiunge il free
+// store (operator new globale, e quindi anche std::vector con l'allocatore predefinito e la risorsa predefinita di std::pmr) è una violazione.
+// Di default una violazione stampa la dimensione richiesta su stderr e termina il programma con std::abort(). Le guardie possono essere annidate.
+// Tipicamente viene creata dal thread real-time al termine dell'inizializzazione, dopo aver creato i driver su un'arena std::pmr.
+//
+// Invarianti:
+// - il thread ha tante guardie attive quante ne sono state create e non ancora distrutte
+class HeapGuard
+{
+public:
+	/*!
+	 * @brief Funzione chiamata ad ogni violazione con la dimensione richiesta. Se ritorna, l'allocazione viene eseguita normalmente;
+	 * può anche lanciare un'eccezione (ad esempio std::bad_alloc), che viene propagata dall'operatore new
+	*/
+	using ViolationHandler = void (*)(std::size_t size);
+
+	HeapGuard();
+	~HeapGuard();
+	HeapGuard(const HeapGuard&) = delete;
+	HeapGuard& operator=(const HeapGuard&) = delete;
+
+	/*!
+	 * @brief Vero se il thread chiamante ha almeno una guardia attiva
+	*/
+	static bool armed();
+	/*!
+	 * @brief Imposta la funzione chiamata ad ogni violazione (in tutti i thread), nullptr per ripristinare quella predefinita (stampa e std::abort())
+	 * @details Durante la chiamata la guardia del thread è sospesa, per cui la funzione può allocare. Va impostata prima di creare le guardie
+	 * @return la funzione impostata in precedenza (nullptr se era quella predefinita)
+	*/
+	static ViolationHandler set_violation_handler(ViolationHandler handler);
+	/*!
+	 * @brief Numero totale di violazioni rilevate (in tutti i thread)
+	*/
+	static std::uint64_t violations();
+	/*!
+	 * @brief Chiamata dagli operatori sostitutivi ad ogni allocazione: se il thread chiamante ha una guardia attiva segnala la violazione
+	*/
+	static void check_allocation(std::size_t size);
+};
@@ -0,0 +1,94 @@
+#include "HeapGuard.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+//NOTA DI PROGETTAZIONE:
+//Gli operatori sostitutivi riproducono il comportamento di quelli della libreria standard (new_handler compreso) aggiungendo solo il controllo
+//della guardia. Le versioni allineate usano aligned_alloc (_aligned_malloc con MSVC, che richiede la deallocazione con _aligned_free)
+namespace
+{
+	void* allocate(size_t size)
+	{
+		HeapGuard::check_allocation(size);
+		if (size == 0)
+			size = 1;
+		for (;;)
+		{
+			if (void* p = malloc(size))
+				return p;
+			new_handler handler = get_new_handler();
+			if (!handler)
+				throw bad_alloc();
+			handler();
+		}
+	}
+
+	void* allocate_aligned(size_t size, align_val_t alignment)
+	{
+		HeapGuard::check_allocation(size);
+		size_t align = static_cast<size_t>(alignment);
+		size = (size + align - 1) / align * align;		//aligned_alloc richiede un multiplo dell'allineamento
+		if (size == 0)
+			size = align;
+		for (;;)
+		{
+#if defined(_MSC_VER)
+			void* p = _aligned_malloc(size, align);
+#else
+			void* p = aligned_alloc(align, size);
+#endif
+			if (p)
+				return p;
+			new_handler handler = get_new_handler();
+			if (!handler)
+				throw bad_alloc();
+			handler();
+		}
+	}
+
+	void deallocate_aligned(void* p) noexcept
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	template <class Allocate>
+	void* allocate_nothrow(Allocate allocate) noexcept
+	{
+		try
+		{
+			return allocate();
+		}
+		catch (const bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocate_nothrow([size] { return allocate(size); }); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocate_nothrow([size] { return allocate(size); }); }
+void* operator new(size_t size, align_val_t alignment) { return allocate_aligned(size, alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return allocate_aligned(size, alignment); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocate_nothrow([=] { return allocate_aligned(size, alignment); }); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocate_nothrow([=] { return allocate_aligned(size, alignment); }); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete[](void* p, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { deallocate_aligned(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { deallocate_aligned(p); }
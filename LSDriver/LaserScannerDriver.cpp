@@ -1,266 +1,754 @@
-#include "LaserScannerDriver.h"
-#include <iomanip>
-#include <cmath>
-#include <stdexcept>
-#include <algorithm>
-
-using namespace std;
-
-LaserScannerDriver::LaserScannerDriver(double resolution) : angular_resolution_{ resolution }, front_{ 0 }, back_{ 0 }
-{
-	//Impedisco di inserire risoluzioni angolari non valide: una modifica al valore inserito senza informare l'utente potrebbe dar luogo a comportamenti
-	//non voluti del programma non comprensibili all'utente.
-	//Ritornare un valore non  possibile perch siamo nel costruttore, se non venisse lanciata l'eccezione l'oggetto si troverebbe in uno stato non valido
-	if (isnan(resolution) || resolution < 0.1 || resolution > 1)
-		throw out_of_range("Scanner resolution " + to_string(resolution) + " invalid: must be in the range [ 0.1 , 1 ]");
-
-	//Ho allocato nel free store uno spazio per un numero di puntatori a double di dimensione pari a BUFFER_DIM 
-	//E' stato allocato qui e non nella initialization list per evitare memory leaks: nel caso in cui venisse lanciata l'eccezione relativa alla risoluzione
-	//il puntatore inizializzato prima di chiamare il costruttore non verrebbe deallocato automaticamente.
-	buffer_ = new double* [BUFFER_DIM];	
-	
-	//Inizializzo il buffer settando tutti i puntatori a nullptr per rispettare le invarianti
-	for (int i = 0; i < BUFFER_DIM; i++)
-	{
-		buffer_[i] = nullptr;
-	}
-}
-
-LaserScannerDriver::~LaserScannerDriver()
-{
-	//Chiama clear_buffer() per deallocare tutte le scansioni e poi dealloca lo spazio riservato al buffer stesso. Questo perch deallocando solamente il buffer
-	//non verrebbero deallocate anche le scansioni
-	if (buffer_)			//if eseguito perch il distruttore viene chiamato dopo aver fatto il move che ha lasciato l'oggetto in uno stato "non valido" per cui clear_buffer non funzionerebbe
-	{
-		clear_buffer();
-	}
-	delete[] buffer_;
-	buffer_ = nullptr;
-}
-
-LaserScannerDriver::LaserScannerDriver(const LaserScannerDriver& lsd) : front_{ lsd.front_ }, back_{ lsd.back_ }, angular_resolution_{ lsd.angular_resolution_ }
-{
-	int measurements = evalute_measurement_index(kMaxAngle, angular_resolution_) + 1;
-	buffer_ = copy_buffer(lsd.buffer_, measurements);
-}
-
-LaserScannerDriver::LaserScannerDriver(LaserScannerDriver&& lsd) : front_{ lsd.front_ }, back_{ lsd.back_ }, angular_resolution_{ lsd.angular_resolution_ }, buffer_ {lsd.buffer_}
-{
-	//Setto a nullptr per lasciare oggetto in stato non valido ed evitare che il distruttore elimini i dati spostati nell'oggetto corrente
-	lsd.buffer_ = nullptr;
-	lsd.angular_resolution_ = lsd.back_ = lsd.front_ = 0;
-}
-
-//Nota sugli assegnamenti di copia e move: si  deciso di adottare la politica per cui un Driver ha semplicemente il compito di *gestire* un LIDAR. Per questo motivo
-//in qualsiasi punto del programma  possibile decidere di far cambiare il LIDAR che un certo Driver sta gestendo con un altro qualsiasi, 
-//operazione che comporter il cambio dunque di risoluzione, valori inseriti nel buffer e l'indice delle scansioni pi e meno recenti (ovvero front e back)
-LaserScannerDriver& LaserScannerDriver::operator=(const LaserScannerDriver& lsd)
-{
-	//Creo una copia di sicurezza del buffer in tmp per evitare problemi dovuti all'autoassegnamento
-	int measurements = evalute_measurement_index(kMaxAngle, lsd.angular_resolution_) + 1;
-	double** tmp = copy_buffer(lsd.buffer_, measurements);
-
-	//Dealloco il buffer di questo oggetto e i valori a cui sta puntando
-	clear_buffer();
-	delete[] buffer_;
-		
-	//Inserisco i nuovi valori nell'oggetto corrente
-	buffer_ = tmp;
-	front_ = lsd.front_;
-	back_ = lsd.back_;
-	angular_resolution_ = lsd.angular_resolution_;
-
-	return *this;
-}
-
-LaserScannerDriver& LaserScannerDriver::operator=(LaserScannerDriver&& lsd)
-{
-	//Dealloco i vecchi elementi. Non mi preoccupo del self-assignment in quanto il parametro passato  un oggetto temporaneo
-	//https://stackoverflow.com/questions/9322174/move-assignment-operator-and-if-this-rhs
-	clear_buffer();
-	delete[] buffer_;
-
-	//Copio i valori in questo oggetto
-	buffer_ = lsd.buffer_;
-	front_ = lsd.front_;
-	back_ = lsd.back_;
-	angular_resolution_ = lsd.angular_resolution_;
-
-	//Invalido l'oggetto passato
-	lsd.buffer_ = nullptr;
-	lsd.angular_resolution_ = lsd.back_ = lsd.front_ = 0;
-
-	return *this;
-}
-
-//Funzione creata per evitare duplicazione di codice nei copy constructor e nel copy assignment. E' necessario passare anche values_per_scan
-//perch nel caso di copy assignment il numero di misurazioni si ottiene a partire dalla risoluzione angolare del parametro passato e non di
-//questo oggetto
-double** LaserScannerDriver::copy_buffer(double** from,int values_per_scan) const
-{
-	double** res = new double* [BUFFER_DIM];
-
-	for (int i = 0; i < BUFFER_DIM; i++)
-	{
-		if (!from[i])
-			res[i] = nullptr;
-		else
-		{
-			res[i] = new double[values_per_scan];
-			copy(from[i], from[i] + values_per_scan, res[i]);
-		}
-	}
-	
-	return res;
-}
-
-
-void LaserScannerDriver::new_scan(const vector<double>& vec)
-{
-	if (is_full())	//se il buffer  pieno devo deallocare la memoria occupata da scansioni precedenti, settare a null la cella(rispetto l'invariante) e spostare l'indice di front
-	{
-		delete[] buffer_[front_];
-		buffer_[front_] = nullptr;
-		front_ = next_circular_index(front_);
-	}
-		
-	int measurements = evalute_measurement_index(kMaxAngle, angular_resolution_) + 1;	//Il numero di misurazioni totali  l'indice della misurazione in corrispondenza a maxAngle + 1
-	buffer_[back_] = new double[measurements];											//Sovrascrivo il puntatore alla vecchia zona di memoria deallocata con un puntatore alla nuova
-
-	int min_size = min(static_cast<int>(vec.size()), measurements);
-
-	for (int i = 0; i < min_size; i++)
-	{
-		double element = vec[i];														//Accedo solo una volta al free store per ogni dato cos da ridurre il numero totale di accessi
-		//Se viene passato un NaN o un numero negativo ritengo opportuno avvisare l'utente: il LIDAR ha dei problemi nell'effettuare delle misurazioni,
-		//se agissi in modo "silenzioso" (inserendo 0 ad esempio) l'utente non verrebbe a conoscenza dei problemi (gravi) del dispostivo
-		if (isnan(element))												
-			throw invalid_argument("Check your LIDAR! You are passing a value which is Not A Number (NaN)");
-		if(element < 0)
-			throw invalid_argument("Check your LIDAR! You are passing a negative distance");
-		buffer_[back_][i] = element;
-	}
-
-	//Se la dimensione del vector  minore del numero di misurazioni massime, inserisco 0 nelle celle rimanenti
-	for (int i = vec.size(); i < measurements; i++)
-		buffer_[back_][i] = 0;
-
-	back_ = next_circular_index(back_);
-	
-}
-
-
-vector<double> LaserScannerDriver::get_scan()
-{
-	if (is_empty())
-		throw EmptyBufferException();
-
-	//Poich posso conoscere in anticipo la dimensione del vector da restituire, alloco un vector riservando il numero corretto di elementi cos da evitare ridimensionamenti in fase di inserimento
-	//che peggiorano le prestazioni del metodo (in questo modo 1 inserimento: O(1) in media ===> O(1) sempre)
-	int measurements = evalute_measurement_index(kMaxAngle, angular_resolution_) + 1;
-	vector<double> v;
-	v.reserve(measurements);
-
-	for (int i = 0; i < measurements; i++)
-	{
-		v.push_back(buffer_[front_][i]);
-	}
-
-	//elimino la scansione appena rimossa
-	delete[] buffer_[front_];
-	buffer_[front_] = nullptr;
-
-	//front punta alla scansione meno recente dopo quella rimossa
-	front_ = next_circular_index(front_);
-
-	//Viene ritornato un vector per valore perch verr usato l'assegnamento/costruttore di move della classe vector (o l'ottimizzazione da parte del compilatore di copy elision).
-	return v;
-}
-
-void LaserScannerDriver::clear_buffer()
-{
-	//Nota sul ciclo while: elimino solo le celle che hanno un riferimento. Tutte le celle fuori dall'area del buffer valida hanno gi il puntatore settato a nullptr, andare a deallocarle
-	//e settare il puntatore della cella a nullptr fa diventare questa operazione O(n) => Theta(n) senza alcun motivo
-
-	while (!is_empty())							
-	{											
-		delete[] buffer_[front_];
-		buffer_[front_] = nullptr;
-		front_ = next_circular_index(front_);
-	}
-	front_ = back_ = 0;
-}
-
-double LaserScannerDriver::get_distance(double angle) const
-{
-	if (isnan(angle))
-		throw invalid_argument("The given angle is Not A Number (NaN)");
-
-	if (is_empty())
-		throw EmptyBufferException();
-
-	int measurement_index = evalute_measurement_index(angle, angular_resolution_);	//Prende l'indice della misurazione richiesta (con eventuale arrotondamento)
-	int last_scan_index = previous_circular_index(back_);							//Calcola l'indice della scansione pi recente
-	double distance = buffer_[last_scan_index][measurement_index];
-
-	return distance;
-}
-
-
-double LaserScannerDriver::angular_resolution() const
-{
-	return angular_resolution_;
-}
-
-
-std::ostream& operator<< (std::ostream& os, const LaserScannerDriver& lsd)
-{
-	if (lsd.is_empty())
-		os << "No scan found in the buffer. Cannot print most recent scan.";
-	else
-	{
-		int measurements = evalute_measurement_index(LaserScannerDriver::kMaxAngle, lsd.angular_resolution()) + 1;
-		constexpr int values_per_row = 4;														//Mi dice quante coppie stampare per riga
-		for (int i = 0; i < values_per_row; i++)												//Stampo le intestazioni delle colonne
-			os << setw(10) << "Angle" << setw(9) << " Value";
-		os << endl;
-		os << fixed;
-		os << setprecision(3);
-		for (int i = 0; i < measurements; i++)													//Stampo tutte le coppie angolo/valore (4 per riga)
-		{
-			double angle = i * lsd.angular_resolution();
-			os << setw(9) << angle << ":" << setw(8) << lsd.get_distance(angle) << ",";
-
-			if ((i + 1) % values_per_row == 0)
-				os << endl;
-		}
-	}
-	os << endl;
-	return os;
-}
-
-//Nota sulla funzione:  stata creata come helper function perch pu essere utilizzata anche in modo scollegato dal LIDAR,
-//Si pu anche utilizzare per ottenere l'indice della scansione all'interno del vector. 
-//
-//Poich ritorna l'indice dell'ultima scansione, per ottenere il numero di scansioni bisogna incrementare di 1 il valore ritornato da questa funzione
-int evalute_measurement_index(double angle, double resolution)
-{
-	//Nota sul funzionamento: 
-	// - la risoluzione < 0 viene controllata nel caso in cui la funzione sia invocata dall'esterno (la classe passer sempre un parametro valido per le invarianti)
-	// - Se l'angolo  nel range giusto calcolo la misurazione e arrotondo al valore pi vicino con round() (come da richiesta)
-	// - Se l'angolo  >= di kMaxAngle viene ritornato l'indice dell'ultima scansione eseguita (come da richiesta dell'esercizio). Viene usata la funzione floor() perch
-	//   ad esempio con resolution = 0.76 e angle = 180 -> 180/0.87 = 206.90, ma l'ultima scansione possibile  quella all'indice 206 (se arrotondassi otterrei 207, che non va bene)
-	// - Se l'angolo  <= 0 viene ritornato 0 che  l'indice della scansione pi vicina al grado fornito (ovvero quella di grado 0). Non viene fatto alcun controllo perch 0  il valore 
-	//   che assegno inizialmente alla variabile da ritornare
-
-	int measurements = 0;
-
-	if (isnan(angle) || isnan(resolution) || resolution <= 0)
-		measurements = -1;
-	else if (isgreaterequal(angle, LaserScannerDriver::kMaxAngle))
-		measurements = static_cast<int>(floor(LaserScannerDriver::kMaxAngle / resolution));
-	else if (angle > 0)
-		measurements = static_cast<int>(round(angle / resolution));
-
-	return measurements;
-}
+#include "LaserScannerDriver.h"
+#include "ScanLookup.h"
+#include <iomanip>
+#include <charconv>
+#include <string>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+LaserScannerDriver::LaserScannerDriver(double resolution, int capacity, pmr::memory_resource* resource) : slots_(resource), angular_resolution_{ resolution },
+	capacity_{ capacity }, measurements_{ 0 }, stride_{ 0 }, front_{ 0 }, back_{ 0 }, size_{ 0 }, leased_{ false }, writing_{ false },
+	invalid_policy_{ InvalidValuePolicy::kThrow }, observers_(resource), generation_{ 1 }, indexed_generation_{ 0 }, range_index_{ resource },
+	downsampled_(resource)
+{
+	//Impedisco di inserire risoluzioni angolari non valide: una modifica al valore inserito senza informare l'utente potrebbe dar luogo a comportamenti
+	//non voluti del programma non comprensibili all'utente.
+	//Ritornare un valore non è possibile perchè siamo nel costruttore, se non venisse lanciata l'eccezione l'oggetto si troverebbe in uno stato non valido
+	measurements_ = measurement_count(resolution);
+	if (capacity < 1)
+		throw out_of_range("Buffer capacity " + to_string(capacity) + " invalid: must be at least 1");
+
+	stride_ = slot_stride(measurements_);
+
+	//Alloco dalla memory_resource (di default il free store) l'intero slab di capacity_ scansioni più lo slot di scrittura. Questa è l'unica allocazione del buffer:
+	//da qui in poi new_scan() e get_scan() si limitano a spostare gli indici, a copiare i valori e a scambiare puntatori (finchè il driver non viene copiato, vedi prepare_write_slot()).
+	//E' stato allocato qui e non nella initialization list per evitare memory leaks: nel caso in cui venisse lanciata l'eccezione relativa alla risoluzione
+	//il puntatore inizializzato prima di chiamare il costruttore non verrebbe deallocato automaticamente.
+	allocate_slab(slots_, capacity_ + 1, stride_, resource);
+}
+
+size_t LaserScannerDriver::storage_bytes(double resolution, int capacity)
+{
+	//Stessi calcoli del costruttore, senza allocare nulla: viene chiamata durante la preparazione dell'arena, anche con una HeapGuard attiva
+	int stride = slot_stride(measurement_count(resolution));
+	if (capacity < 1)
+		throw out_of_range("Buffer capacity " + to_string(capacity) + " invalid: must be at least 1");
+	return slab_bytes(capacity + 1, stride) + (capacity + 1) * sizeof(double*);		//+ 1: lo slot di scrittura
+}
+
+LaserScannerDriver::~LaserScannerDriver()
+{
+	//Gli slot vengono deallocati solo se nessuna copia li sta ancora usando.
+	//slots_ è vuoto se l'oggetto è stato spostato con un move che lo ha lasciato in uno stato "non valido"
+	release_slots();
+}
+
+LaserScannerDriver::LaserScannerDriver(const LaserScannerDriver& lsd) : slots_(lsd.slots_, lsd.memory_resource()), angular_resolution_{ lsd.angular_resolution_ },
+	capacity_{ lsd.capacity_ }, measurements_{ lsd.measurements_ }, stride_{ lsd.stride_ }, front_{ lsd.front_ }, back_{ lsd.back_ }, size_{ lsd.size_ },
+	leased_{ false }, writing_{ false }, invalid_policy_{ lsd.invalid_policy_ }, observers_(lsd.memory_resource()), generation_{ 1 }, indexed_generation_{ 0 },
+	range_index_{ lsd.memory_resource() }, downsampled_(lsd.memory_resource())
+{
+	//Il prestito riguarda l'oggetto originale: nella copia la scansione meno recente è disponibile normalmente.
+	//Gli slot sono condivisi con lsd: la copia delle misurazioni avviene solo se uno dei due driver deve riutilizzare uno slot ancora condiviso
+	share_slots(slots_);
+}
+
+LaserScannerDriver::LaserScannerDriver(LaserScannerDriver&& lsd) : slots_{ std::move(lsd.slots_) }, angular_resolution_{ lsd.angular_resolution_ }, capacity_{ lsd.capacity_ },
+	measurements_{ lsd.measurements_ }, stride_{ lsd.stride_ }, front_{ lsd.front_ }, back_{ lsd.back_ }, size_{ lsd.size_ }, leased_{ false }, writing_{ lsd.writing_ },
+	invalid_policy_{ lsd.invalid_policy_ }, observers_{ std::move(lsd.observers_) }, generation_{ 1 }, indexed_generation_{ 0 }, range_index_{ lsd.memory_resource() },
+	downsampled_(lsd.memory_resource())
+{
+	//Svuoto slots_ per lasciare oggetto in stato non valido ed evitare che il distruttore rilasci gli slot spostati nell'oggetto corrente.
+	//size_ = 0 fa sì che l'oggetto spostato risulti vuoto, senza mai accedere agli slot
+	lsd.slots_.clear();
+	lsd.angular_resolution_ = 0;
+	lsd.capacity_ = lsd.measurements_ = lsd.stride_ = lsd.back_ = lsd.front_ = lsd.size_ = 0;
+	lsd.leased_ = lsd.writing_ = false;
+}
+
+//Nota sugli assegnamenti di copia e move: si è deciso di adottare la politica per cui un Driver ha semplicemente il compito di *gestire* un LIDAR. Per questo motivo
+//in qualsiasi punto del programma è possibile decidere di far cambiare il LIDAR che un certo Driver sta gestendo con un altro qualsiasi, 
+//operazione che comporterà il cambio dunque di risoluzione, valori inseriti nel buffer e l'indice delle scansioni più e meno recenti (ovvero front e back)
+LaserScannerDriver& LaserScannerDriver::operator=(const LaserScannerDriver& lsd)
+{
+	//Aggiungo i riferimenti agli slot di lsd prima di rilasciare i miei, per evitare problemi dovuti all'autoassegnamento
+	//tmp usa la risorsa di questo oggetto, così l'assegnamento finale sposta il buffer di tmp senza copiarlo
+	pmr::vector<double*> tmp(lsd.slots_, memory_resource());
+	share_slots(tmp);
+
+	//Rilascio gli slot di questo oggetto. Gli osservatori vengono avvisati solo alla fine, con notify_replaced()
+	release_slots();
+		
+	//Inserisco i nuovi valori nell'oggetto corrente
+	slots_ = std::move(tmp);
+	angular_resolution_ = lsd.angular_resolution_;
+	capacity_ = lsd.capacity_;
+	measurements_ = lsd.measurements_;
+	stride_ = lsd.stride_;
+	front_ = lsd.front_;
+	back_ = lsd.back_;
+	size_ = lsd.size_;
+	leased_ = writing_ = false;
+	invalid_policy_ = lsd.invalid_policy_;
+	generation_++;
+
+	notify_replaced();
+	return *this;
+}
+
+LaserScannerDriver& LaserScannerDriver::operator=(LaserScannerDriver&& lsd)
+{
+	//Dealloco i vecchi elementi. Non mi preoccupo del self-assignment in quanto il parametro passato è un oggetto temporaneo
+	//https://stackoverflow.com/questions/9322174/move-assignment-operator-and-if-this-rhs
+	release_slots();
+
+	//Copio i valori in questo oggetto
+	slots_ = std::move(lsd.slots_);
+	angular_resolution_ = lsd.angular_resolution_;
+	capacity_ = lsd.capacity_;
+	measurements_ = lsd.measurements_;
+	stride_ = lsd.stride_;
+	front_ = lsd.front_;
+	back_ = lsd.back_;
+	size_ = lsd.size_;
+	leased_ = false;		//Un'eventuale ScanLease punta ancora a lsd, che dopo il move non ha più scansioni da rilasciare
+	writing_ = lsd.writing_;	//Gli slot sono gli stessi: lo slot riservato resta valido anche dopo il move
+	invalid_policy_ = lsd.invalid_policy_;
+	generation_++;
+	notify_replaced();
+
+	//Invalido l'oggetto passato
+	lsd.slots_.clear();
+	lsd.angular_resolution_ = 0;
+	lsd.capacity_ = lsd.measurements_ = lsd.stride_ = lsd.back_ = lsd.front_ = lsd.size_ = 0;
+	lsd.leased_ = lsd.writing_ = false;
+	lsd.observers_.clear();
+
+	return *this;
+}
+
+void LaserScannerDriver::allocate_slab(pmr::vector<double*>& slots, int count, int stride, pmr::memory_resource* resource)
+{
+	//Lo slab contiene la propria intestazione seguita da count slot, ciascuno formato da intestazione e misurazioni
+	size_t slot_size = slot_bytes(stride);
+	size_t bytes = slab_bytes(count, stride);
+	char* slab = static_cast<char*>(resource->allocate(bytes, kCacheLineSize));
+	SlotHeader* slab_header = new (slab) SlotHeader{ { count }, nullptr, {}, resource, bytes };
+
+	slots.clear();
+	slots.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		char* block = slab + sizeof(SlotHeader) + i * slot_size;
+		new (block) SlotHeader{ { 1 }, slab_header, {}, nullptr, 0 };
+		double* data = reinterpret_cast<double*>(block + sizeof(SlotHeader));
+		fill(data, data + stride, 0.0);		//Evito di lasciare valori indeterminati negli slot
+		slots.push_back(data);
+	}
+}
+
+double* LaserScannerDriver::allocate_slot(int stride, pmr::memory_resource* resource)
+{
+	size_t bytes = slot_bytes(stride);
+	char* block = static_cast<char*>(resource->allocate(bytes, kCacheLineSize));
+	new (block) SlotHeader{ { 1 }, nullptr, {}, resource, bytes };
+	double* data = reinterpret_cast<double*>(block + sizeof(SlotHeader));
+	fill(data, data + stride, 0.0);
+	return data;
+}
+
+void LaserScannerDriver::share_slots(const pmr::vector<double*>& slots)
+{
+	//Basta relaxed: chi incrementa possiede già un riferimento, come per std::shared_ptr
+	for (double* slot : slots)
+		header(slot)->references.fetch_add(1, memory_order_relaxed);
+}
+
+void LaserScannerDriver::release_slot(double* slot)
+{
+	//acq_rel: le letture fatte tramite questo riferimento avvengono prima dell'eventuale riutilizzo o deallocazione da parte di un altro driver
+	SlotHeader* slot_header = header(slot);
+	if (slot_header->references.fetch_sub(1, memory_order_acq_rel) != 1)
+		return;
+
+	SlotHeader* slab = slot_header->slab;
+	if (!slab)
+		slot_header->resource->deallocate(slot_header, slot_header->bytes, kCacheLineSize);
+	else if (slab->references.fetch_sub(1, memory_order_acq_rel) == 1)
+		slab->resource->deallocate(slab, slab->bytes, kCacheLineSize);
+}
+
+void LaserScannerDriver::release_slots()
+{
+	for (double* slot : slots_)
+		release_slot(slot);
+	slots_.clear();
+}
+
+double* LaserScannerDriver::prepare_write_slot()
+{
+	//Se lo slot di scrittura è condiviso con una copia del driver (che lo ha ricevuto come uno qualsiasi degli slot) non può essere modificato: lo sostituisco
+	//con uno slot nuovo. Non serve copiarne il contenuto perchè verrà sovrascritto per intero. L'allocazione avviene solo se esiste ancora una copia che usa lo slot
+	double*& spare = slots_[capacity_];
+	if (header(spare)->references.load(memory_order_acquire) > 1)
+	{
+		double* fresh = allocate_slot(stride_, memory_resource());
+		release_slot(spare);
+		spare = fresh;
+	}
+	return spare;
+}
+
+void LaserScannerDriver::check_overwrite() const
+{
+	if (is_full() && leased_)
+		throw logic_error("Cannot overwrite the oldest scan: it is still leased");
+}
+
+void LaserScannerDriver::check_timestamp(Clock::time_point timestamp) const
+{
+	if (!is_empty() && timestamp < header(slot(previous_circular_index(back_)))->timestamp)
+		throw invalid_argument("Scan timestamps must not decrease");
+}
+
+void LaserScannerDriver::publish_write_slot(Clock::time_point timestamp)
+{
+	//Solo ora, con la scansione già validata, se il buffer è pieno scarto la meno recente spostando l'indice di front: il suo slot (che è proprio back_)
+	//diventa il nuovo slot di scrittura. Una scansione rifiutata non fa quindi perdere nulla
+	if (is_full())
+	{
+		stats_.overwritten();
+		notify_evicted(front_);
+		front_ = next_circular_index(front_);
+		size_--;
+	}
+
+	int index = back_;
+	swap(slots_[index], slots_[capacity_]);
+	//L'istante viene scritto nell'intestazione dello slot, già presente: memorizzarlo non richiede allocazioni e le copie del driver lo condividono con la scansione
+	header(slot(index))->timestamp = timestamp;
+	back_ = next_circular_index(back_);
+	size_++;
+	generation_++;		//La scansione più recente è cambiata: l'indice di min_distance() va ricostruito
+
+	for (ScanObserver* observer : observers_)
+		observer->on_scan_committed(*this, span<const double>(slot(index), measurements_));
+}
+
+int LaserScannerDriver::new_scan(const vector<double>& vec, Clock::time_point timestamp)
+{
+	//Un eventuale slot riservato con acquire_write_slot() è proprio quello che verrà sovrascritto: la scrittura in corso viene annullata
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kNewScan);
+	check_timestamp(timestamp);
+	check_overwrite();
+	writing_ = false;
+	double* dest = prepare_write_slot();
+	int min_size = min(static_cast<int>(vec.size()), measurements_);
+
+	//Validazione e copia in un solo passaggio. Di default (kThrow) se viene passato un NaN o un numero negativo avviso l'utente: il LIDAR ha dei problemi
+	//nell'effettuare delle misurazioni, se agissi in modo "silenzioso" l'utente non verrebbe a conoscenza dei problemi (gravi) del dispostivo.
+	//Le altre politiche vanno scelte esplicitamente da chi sa di avere un sensore che restituisce saltuariamente valori non validi
+	ValidationResult result = validate(vec.data(), dest, min_size);
+
+	//Se la dimensione del vector è minore del numero di misurazioni massime, inserisco 0 nelle celle rimanenti
+	fill(dest + min_size, dest + measurements_, 0.0);
+
+	//La scansione diventa valida solo ora: se è stata lanciata un'eccezione è stato scritto solo lo slot di scrittura e il buffer non è cambiato
+	publish_write_slot(timestamp);
+	stats_.committed(size_, result.invalid_count());
+	return result.invalid_count();
+}
+
+ValidationResult LaserScannerDriver::validate(const double* src, double* dest, int count)
+{
+	try
+	{
+		return copy_validated(src, dest, count, invalid_policy_);
+	}
+	catch (const invalid_argument&)
+	{
+		stats_.rejected();
+		throw;
+	}
+}
+
+span<double> LaserScannerDriver::acquire_write_slot()
+{
+	if (writing_)
+		return span<double>(slots_[capacity_], measurements_);
+
+	double* dest = prepare_write_slot();
+	writing_ = true;
+	return span<double>(dest, measurements_);
+}
+
+int LaserScannerDriver::commit(Clock::time_point timestamp)
+{
+	if (!writing_)
+		throw logic_error("No write slot acquired: call acquire_write_slot() before commit()");
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kNewScan);
+	check_overwrite();		//Lo slot resta riservato: il produttore può riprovare dopo aver rilasciato la scansione in prestito
+
+	//Lo slot viene rilasciato prima della validazione: se viene lanciata eccezione la scansione semplicemente non viene inserita
+	writing_ = false;
+	check_timestamp(timestamp);
+
+	//Stessi controlli di new_scan(), eseguiti sul posto direttamente sullo slot in cui il produttore ha scritto
+	double* dest = slots_[capacity_];
+	ValidationResult result = validate(dest, dest, measurements_);
+
+	publish_write_slot(timestamp);
+	stats_.committed(size_, result.invalid_count());
+	return result.invalid_count();
+}
+
+
+vector<double> LaserScannerDriver::get_scan()
+{
+	//Costruisco il vector direttamente dal range dello slot prestato: viene eseguita un'unica allocazione della dimensione corretta e una copia in blocco.
+	//La scansione viene rimossa alla distruzione di lease, cioè dopo la copia
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kGetScan);
+	ScanLease lease = take_scan();
+	vector<double> v(lease.begin(), lease.end());
+
+	//Viene ritornato un vector per valore perchè verrà usato l'assegnamento/costruttore di move della classe vector (o l'ottimizzazione da parte del compilatore di copy elision).
+	return v;
+}
+
+pmr::vector<double> LaserScannerDriver::get_scan(pmr::memory_resource* resource)
+{
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kGetScan);
+	ScanLease lease = take_scan();
+	return pmr::vector<double>(lease.begin(), lease.end(), resource);
+}
+
+LaserScannerDriver::ScanLease LaserScannerDriver::take_scan()
+{
+	if (is_empty())
+		throw EmptyBufferException();
+	if (leased_)
+		throw logic_error("The oldest scan is already leased");
+
+	leased_ = true;
+	return ScanLease(this, span<const double>(slot(front_), measurements_));
+}
+
+void LaserScannerDriver::release_lease()
+{
+	//Se nel frattempo il buffer è stato svuotato (clear_buffer()) non c'è più nulla da rimuovere
+	if (!leased_)
+		return;
+
+	//front punta alla scansione meno recente dopo quella rimossa. Lo slot non viene deallocato: verrà riutilizzato da new_scan()
+	leased_ = false;
+	notify_evicted(front_);
+	front_ = next_circular_index(front_);
+	size_--;
+}
+
+span<const double> LaserScannerDriver::oldest_scan() const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+
+	return span<const double>(slot(front_), measurements_);
+}
+
+span<const double> LaserScannerDriver::newest_scan() const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+
+	return span<const double>(slot(previous_circular_index(back_)), measurements_);
+}
+
+span<const double> LaserScannerDriver::scan(int index) const
+{
+	if (index < 0 || index >= size_)
+		throw out_of_range("Scan index " + to_string(index) + " out of range");
+
+	return span<const double>(slot((front_ + index) % capacity_), measurements_);
+}
+
+LaserScannerDriver::Clock::time_point LaserScannerDriver::timestamp(int index) const
+{
+	return timestamp(scan(index));
+}
+
+LaserScannerDriver::ScanLease::ScanLease(ScanLease&& lease) noexcept : owner_{ lease.owner_ }, scan_{ lease.scan_ }
+{
+	lease.owner_ = nullptr;
+}
+
+LaserScannerDriver::ScanLease& LaserScannerDriver::ScanLease::operator=(ScanLease&& lease) noexcept
+{
+	if (this != &lease)
+	{
+		release();
+		owner_ = lease.owner_;
+		scan_ = lease.scan_;
+		lease.owner_ = nullptr;
+	}
+	return *this;
+}
+
+LaserScannerDriver::ScanLease::~ScanLease()
+{
+	release();
+}
+
+void LaserScannerDriver::ScanLease::release()
+{
+	if (owner_)
+		owner_->release_lease();
+	owner_ = nullptr;
+	scan_ = span<const double>();
+}
+
+void LaserScannerDriver::clear_buffer()
+{
+	//Gli slot restano al driver e non vanno deallocati: è sufficiente invalidarli azzerando gli indici, operazione O(1)
+	//(O(size_) solo se ci sono osservatori da avvisare)
+	notify_all_evicted();
+	front_ = back_ = size_ = 0;
+	leased_ = writing_ = false;
+}
+
+void LaserScannerDriver::add_observer(ScanObserver* observer)
+{
+	if (observer && find(observers_.begin(), observers_.end(), observer) == observers_.end())
+		observers_.push_back(observer);
+}
+
+void LaserScannerDriver::remove_observer(ScanObserver* observer)
+{
+	observers_.erase(remove(observers_.begin(), observers_.end(), observer), observers_.end());
+}
+
+void LaserScannerDriver::notify_evicted(int index) const
+{
+	for (ScanObserver* observer : observers_)
+		observer->on_scan_evicted(*this, span<const double>(slot(index), measurements_));
+}
+
+void LaserScannerDriver::notify_all_evicted() const
+{
+	if (observers_.empty())
+		return;
+	for (int i = 0, index = front_; i < size_; i++, index = next_circular_index(index))
+		notify_evicted(index);
+}
+
+void LaserScannerDriver::notify_replaced() const
+{
+	for (ScanObserver* observer : observers_)
+		observer->on_buffer_replaced(*this);
+}
+
+double LaserScannerDriver::get_distance(double angle) const
+{
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kGetDistance);
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	//Prende l'indice della misurazione richiesta (con eventuale arrotondamento). Si usa la stessa funzione di get_distances() così che i due metodi
+	//diano sempre lo stesso risultato; inoltre l'indice non supera mai l'ultima misurazione anche per angoli appena inferiori a kMaxAngle
+	int measurement_index = nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1);
+	int last_scan_index = previous_circular_index(back_);							//Calcola l'indice della scansione più recente
+	double distance = slot(last_scan_index)[measurement_index];
+
+	return distance;
+}
+
+double LaserScannerDriver::get_distance(double angle, Clock::time_point time) const
+{
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kGetDistance);
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	int measurement_index = nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1);
+
+	//NOTA DI PROGETTAZIONE:
+	//Gli istanti non decrescono lungo il buffer (vedi check_timestamp()), per cui la prima scansione acquisita dopo time si trova con una ricerca binaria
+	//sugli indici logici [0, size_): O(log capacity_) letture di intestazioni, senza mantenere un indice separato degli istanti.
+	//next è la prima scansione con istante > time: tra next - 1 e next c'è time
+	int low = 0, high = size_;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (header(slot((front_ + middle) % capacity_))->timestamp <= time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	int next = low;
+
+	if (next == 0)				//time precede la scansione meno recente
+		return slot(front_)[measurement_index];
+	if (next == size_)			//time segue la scansione più recente
+		return slot(previous_circular_index(back_))[measurement_index];
+
+	const double* before = slot((front_ + next - 1) % capacity_);
+	const double* after = slot((front_ + next) % capacity_);
+	Clock::time_point before_time = header(before)->timestamp;
+	double weight = chrono::duration<double>(time - before_time) / chrono::duration<double>(header(after)->timestamp - before_time);
+
+	double first = before[measurement_index], second = after[measurement_index];
+	if (isnan(first) || isnan(second))
+		return weight < 0.5 ? first : second;
+	return first + (second - first) * weight;
+}
+
+void LaserScannerDriver::get_distances(span<const double> angles, span<double> distances) const
+{
+	if (distances.size() < angles.size())
+		throw invalid_argument("The output span is smaller than the number of angles");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	const double* last_scan = slot(previous_circular_index(back_));
+	if (!lookup_distances(last_scan, measurements_ - 1, 1 / angular_resolution_, angles.data(), distances.data(), static_cast<int>(angles.size())))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+}
+
+void LaserScannerDriver::get_points(span<double> x, span<double> y) const
+{
+	convert_last_scan(x, y, nullptr);
+}
+
+void LaserScannerDriver::get_points(span<double> x, span<double> y, const MountingTransform& mounting) const
+{
+	convert_last_scan(x, y, &mounting);
+}
+
+void LaserScannerDriver::convert_last_scan(span<double> x, span<double> y, const MountingTransform* mounting) const
+{
+	if (x.size() < static_cast<size_t>(measurements_) || y.size() < static_cast<size_t>(measurements_))
+		throw invalid_argument("The output span is smaller than the number of measurements");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	const double* last_scan = slot(previous_circular_index(back_));
+	polar_to_cartesian(TrigTable::for_resolution(angular_resolution_), span<const double>(last_scan, measurements_), x, y, mounting);
+}
+
+const ScanRangeIndex& LaserScannerDriver::range_index(double first_angle, double last_angle, int& first, int& last) const
+{
+	if (isnan(first_angle) || isnan(last_angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+	if (first_angle > last_angle)
+		throw invalid_argument("The first angle of the range is greater than the last one");
+
+	if (is_empty())
+		throw EmptyBufferException();
+
+	if (indexed_generation_ != generation_)
+	{
+		range_index_.build(span<const double>(slot(previous_circular_index(back_)), measurements_));
+		indexed_generation_ = generation_;
+	}
+
+	double inverse_resolution = 1 / angular_resolution_;
+	first = nearest_measurement_index(first_angle, inverse_resolution, measurements_ - 1);
+	last = nearest_measurement_index(last_angle, inverse_resolution, measurements_ - 1);
+	return range_index_;
+}
+
+double LaserScannerDriver::min_distance(double first_angle, double last_angle) const
+{
+	int first, last;
+	const ScanRangeIndex& index = range_index(first_angle, last_angle, first, last);
+	return slot(previous_circular_index(back_))[index.argmin(first, last)];
+}
+
+double LaserScannerDriver::max_distance(double first_angle, double last_angle) const
+{
+	int first, last;
+	const ScanRangeIndex& index = range_index(first_angle, last_angle, first, last);
+	return slot(previous_circular_index(back_))[index.argmax(first, last)];
+}
+
+double LaserScannerDriver::argmin_distance(double first_angle, double last_angle) const
+{
+	int first, last;
+	const ScanRangeIndex& index = range_index(first_angle, last_angle, first, last);
+	return index.argmin(first, last) * angular_resolution_;
+}
+
+
+const LaserScannerDriver::DownsampledView& LaserScannerDriver::downsampled_view(double resolution, Downsampling mode) const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+	long factor = isnan(resolution) ? 0 : lround(resolution / angular_resolution_);
+	if (factor < 1 || factor > measurements_ || abs(factor * angular_resolution_ - resolution) > 1e-9 * resolution)
+		throw invalid_argument("Downsampled resolution must be a positive multiple of the driver resolution");
+
+	DownsampledView* view = nullptr;
+	for (DownsampledView& candidate : downsampled_)
+		if (candidate.factor == factor && candidate.mode == mode)
+			view = &candidate;
+
+	if (!view)
+	{
+		//Le generazioni crescono ad ogni scansione: la riduzione con la generazione minore è quella aggiornata meno di recente
+		if (downsampled_.size() < static_cast<size_t>(kMaxDownsampledViews))
+		{
+			downsampled_.reserve(kMaxDownsampledViews);		//Una sola allocazione per tutte le riduzioni
+			downsampled_.push_back(DownsampledView{ 0, mode, 0, pmr::vector<double>(memory_resource()) });
+			view = &downsampled_.back();
+		}
+		else
+			view = &*min_element(downsampled_.begin(), downsampled_.end(),
+				[](const DownsampledView& a, const DownsampledView& b) { return a.generation < b.generation; });
+		view->factor = static_cast<int>(factor);
+		view->mode = mode;
+		view->generation = 0;
+	}
+
+	if (view->generation != generation_)
+	{
+		//Ridimensionata ad ogni aggiornamento: dopo un assegnamento measurements_ può essere cambiato (un altro LIDAR) mentre la riduzione resta
+		//in cache. Con lo stesso numero di misurazioni resize() non fa nulla
+		view->values.resize(downsampled_size(measurements_, view->factor));
+		downsample(span<const double>(slot(previous_circular_index(back_)), measurements_), view->factor, mode, view->values);
+		view->generation = generation_;
+	}
+	return *view;
+}
+
+span<const double> LaserScannerDriver::downsampled_scan(double resolution, Downsampling mode) const
+{
+	return downsampled_view(resolution, mode).values;
+}
+
+double LaserScannerDriver::get_distance(double angle, double resolution, Downsampling mode) const
+{
+	ScanStatsCounters::ScopedLatency latency(stats_, ScanStatsCounters::kGetDistance);
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	const DownsampledView& view = downsampled_view(resolution, mode);
+	int last_index = static_cast<int>(view.values.size()) - 1;
+	return view.values[nearest_measurement_index(angle, 1 / (view.factor * angular_resolution_), last_index)];
+}
+
+int LaserScannerDriver::changed_ranges(double threshold, vector<ScanRange>& ranges) const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+	if (isnan(threshold) || threshold < 0)
+		throw invalid_argument("Change threshold must be a non-negative number");
+
+	int newest = previous_circular_index(back_);
+	if (size_ == 1)
+	{
+		ranges.assign(1, ScanRange{ 0, measurements_ });
+		return measurements_;
+	}
+	//La scansione precedente è nello slot prima della più recente: il confronto avviene direttamente sugli slot, senza copie
+	return find_changed_ranges(span<const double>(slot(previous_circular_index(newest)), measurements_), span<const double>(slot(newest), measurements_),
+		threshold, ranges);
+}
+
+void LaserScannerDriver::newest_delta(double threshold, ScanDelta& delta) const
+{
+	if (is_empty())
+		throw EmptyBufferException();
+
+	int newest = previous_circular_index(back_);
+	span<const double> previous = size_ > 1 ? span<const double>(slot(previous_circular_index(newest)), measurements_) : span<const double>();
+	delta.encode(previous, span<const double>(slot(newest), measurements_), threshold);
+}
+
+double LaserScannerDriver::angular_resolution() const
+{
+	return angular_resolution_;
+}
+
+
+std::ostream& operator<< (std::ostream& os, const LaserScannerDriver& lsd)
+{
+	if (lsd.is_empty())
+		os << "No scan found in the buffer. Cannot print most recent scan.";
+	else
+	{
+		//Stesso testo della versione con setw/setprecision, ma le distanze vengono lette direttamente dallo slot (senza convertire ogni indice
+		//in angolo e poi di nuovo in indice con get_distance()) e formattate con to_chars in una stringa scritta con una sola write()
+		constexpr int values_per_row = 4;														//Mi dice quante coppie stampare per riga
+		span<const double> scan = lsd.newest_scan();
+		string text;
+		text.reserve(scan.size() * 20 + 80);
+		for (int i = 0; i < values_per_row; i++)												//Stampo le intestazioni delle colonne
+			text += "     Angle    Value";
+		text += '\n';
+
+		char number[400];
+		auto append_padded = [&](double value, size_t width)
+		{
+			size_t length = to_chars(number, number + sizeof(number), value, chars_format::fixed, 3).ptr - number;
+			if (length < width)
+				text.append(width - length, ' ');
+			text.append(number, length);
+		};
+		for (size_t i = 0; i < scan.size(); i++)												//Stampo tutte le coppie angolo/valore (4 per riga)
+		{
+			append_padded(i * lsd.angular_resolution(), 9);
+			text += ':';
+			append_padded(scan[i], 8);
+			text += ',';
+
+			if ((i + 1) % values_per_row == 0)
+				text += '\n';
+		}
+		os.write(text.data(), text.size());
+		os << fixed << setprecision(3);		//Lo stato dello stream resta quello lasciato dalla versione precedente
+	}
+	os << endl;
+	return os;
+}
+
+//Nota sulla funzione: è stata creata come helper function perchè può essere utilizzata anche in modo scollegato dal LIDAR,
+//Si può anche utilizzare per ottenere l'indice della scansione all'interno del vector. 
+//
+//Poichè ritorna l'indice dell'ultima scansione, per ottenere il numero di scansioni bisogna incrementare di 1 il valore ritornato da questa funzione
+int evalute_measurement_index(double angle, double resolution)
+{
+	//Nota sul funzionamento: 
+	// - la risoluzione < 0 viene controllata nel caso in cui la funzione sia invocata dall'esterno (la classe passerà sempre un parametro valido per le invarianti)
+	// - Se l'angolo è nel range giusto calcolo la misurazione e arrotondo al valore più vicino con round() (come da richiesta)
+	// - Se l'angolo è >= di kMaxAngle viene ritornato l'indice dell'ultima scansione eseguita (come da richiesta dell'esercizio). Viene usata la funzione floor() perchè
+	//   ad esempio con resolution = 0.76 e angle = 180 -> 180/0.87 = 206.90, ma l'ultima scansione possibile è quella all'indice 206 (se arrotondassi otterrei 207, che non va bene)
+	// - Se l'angolo è <= 0 viene ritornato 0 che è l'indice della scansione più vicina al grado fornito (ovvero quella di grado 0). Non viene fatto alcun controllo perchè 0 è il valore 
+	//   che assegno inizialmente alla variabile da ritornare
+
+	int measurements = 0;
+
+	if (isnan(angle) || isnan(resolution) || resolution <= 0)
+		measurements = -1;
+	else if (isgreaterequal(angle, LaserScannerDriver::kMaxAngle))
+		measurements = static_cast<int>(floor(LaserScannerDriver::kMaxAngle / resolution));
+	else if (angle > 0)
+		measurements = static_cast<int>(round(angle / resolution));
+
+	return measurements;
+}
+
+int measurement_count(double resolution)
+{
+	if (isnan(resolution) || resolution < 0.1 || resolution > 1)
+		throw out_of_range("Scanner resolution " + to_string(resolution) + " invalid: must be in the range [ 0.1 , 1 ]");
+	return evalute_measurement_index(LaserScannerDriver::kMaxAngle, resolution) + 1;	//Il numero di misurazioni totali è l'indice della misurazione in corrispondenza a maxAngle + 1
+}
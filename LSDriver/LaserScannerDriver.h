@@ -1,164 +1,591 @@
-/*!
-*  @author Formaggio Alberto
-*  @date 3/12/2020
-*/
-
-#include <vector>
-#include <string>
-#include <iostream>
-
-
-// Invarianti:
-// - angular_resolution_ > 0.1 && angular_resolution_ < 1
-// - front_ >= 0 && front_ < BUFFER_DIM
-// - front_  l'indice del puntatore alla scansione meno recente (la prima da rimuovere) o nullptr se il buffer  vuoto
-// - back_ >= 0 && back_ < BUFFER_DIM
-// - back_  l'indice del puntatore alla locazione di buffer_ in cui inserire una nuova scansione. (buffer_[back] != nullptr se buffer pieno, buffer[back_] == nullptr altrimenti).
-// - buffer_  allocato con un array (di puntatori) di dimensione BUFFER_DIM
-// - le celle di buffer_ non valide == nullptr
-// - le costanti all'interno del codice devono avere valori validi gi in fase di compilazione:
-//       - kMaxAngle > 0
-//       - BUFFER_DIM >= 0
-//       - kDefaultResolution >= 0.1 && kDefaultResolution <= 1
-class LaserScannerDriver
-{
-public:
-	/*!
-	 * @brief Angolo massimo raggiungibile da una scansione del lidar
-	 * Essendo costante posso renderla anche pubblica, sar utilizzabile in fase di solo accesso.
-	 * Utile per evitare di avere "magic numbers" sparsi per il codice
-	*/
-	static constexpr double kMaxAngle = 180;
-
-	/*!
-	 * @brief Eccezione lanciata se si fanno operazioni non consentite su buffer vuoto
-	*/
-	class EmptyBufferException {};
-
-	/*!
-	 * @brief Crea una nuova istanza di LaserScannerDriver.
-	 * @details Deve essere chiamato esplicitamente per evitare la conversione che in questo caso  indesiderata
-	 * @throws std::out_of_range se resolution non  nel range [0.1 , 1]
-	*/
-	explicit LaserScannerDriver(double resolution = kDefaultResolution);
-	/*!
-	 * @brief Distruttore di LaserScannerDriver. Rilascia la memoria
-	*/
-	~LaserScannerDriver();
-	/*!
-	 * @brief copy constructor
-	*/
-	LaserScannerDriver(const LaserScannerDriver& lsd);
-	/*!
-	 * @brief move constructor
-	 */
-	LaserScannerDriver(LaserScannerDriver&& lsd);
-
-	/*!
-	 * @brief Copy assignment, esegue una deep copy.
-	*/
-	LaserScannerDriver& operator=(const LaserScannerDriver& lsd);
-	/*!
-	 * @brief Move assignment
-	*/
-	LaserScannerDriver& operator=(LaserScannerDriver&& lsd);
-
-	/*!
-	 * @brief Inserisce la scansione fornita nel vector all'interno del buffer. 
-	*/
-	void new_scan(const std::vector<double>& v);
-	/*!
-	 * @brief Ritorna la scansione pi vecchia, eliminandola dal buffer.
-	 * @throws EmptyBufferException qualora il buffer sia vuoto
-	*/
-	std::vector<double> get_scan();
-	/*!
-	 * @brief Elimina tutte le scansioni
-	*/
-	void clear_buffer();
-	/*!
-	 * @brief Ritorna la distanza della scansione pi recente presente all'angolo fornito. Si approssima al valore pi vicino se tale angolo
-	 * non  presente
-	 * @throws EmptyBufferException qualora il buffer sia vuoto
-	*/
-	double get_distance(double angle) const;
-	/*!
-	 * @brief Accessor che ritorna la risoluzione angolare di questo oggetto
-	 * @details Stesso nome della variabile di esemplare per l'accessor
-	*/
-	double angular_resolution() const;
-
-	//Nota di progettazione:
-	//I seguenti metodi son stati resi pubblici per far sapere all'esterno se il buffer  pieno o vuoto. Usando tali metodi  l'utente pu sapere se un'invocazione futura 
-	//di new_scan() sovrascriver una lettura (buffer pieno) o se una futura invocazione di get_scan() / get_distance() pu lanciare eccezione (buffer vuoto) e gestire tale caso
-	inline bool is_empty() const { return buffer_[front_] == nullptr; }
-	inline bool is_full() const { return buffer_[back_] != nullptr; }
-
-private:
-	/*! 
-	*  @brief Dimensione del buffer
-	*/
-	static constexpr int BUFFER_DIM = 2;	
-
-	//NOTA DI PROGETTAZIONE:
-	//Il buffer  stato allocato nel free store come da specifiche dell'esercizio. Nel buffer saranno presenti solo puntatori a elementi validi,
-	//cio una volta che una scasione sar rimossa dal buffer, questa verr anche deallocata (anzich semplicemente spostare l'indice front_). 
-	//Questo mi permette di tenere riservato in memoria solo lo spazio che  effettivamente necessario
-	double** buffer_;
-
-	//Default initializer
-	static constexpr double kDefaultResolution = 1;
-
-	//NOTA DI PROGETTAZIONE:
-	//Si fa notare come sia stata inserita solo la risoluzione angolare e non il numero di misurazioni che possono essere eseguite per ciascuna scansione.
-	//Questo perch tale valore pu essere ricavato in un tempo costante (prestazioni O(1)) grazie al metodo evaluate_measurement_index(), quindi non vi  
-	//era motivo di riservare uno spazio in memoria per tale variabile. Verr calcolata all'occorrenza.
-
-	/*!
-	 * @brief La risoluzione angolare dell'oggetto
-	 * @details E' stata dichiarata privata e non costante per permettere di eseguire l'assegnamento di copia e di move (vedi spiegazione a riguardo nella **definizione** dei
-	 * relativi metodi). Essendo privata e nessun metodo vi pu accedere (se non in lettura) rispetta la specifica secondo cui la risoluzione angolare del LIDAR
-	 * non pu cambiare durante tutta la sua vita
-	*/
-	double angular_resolution_;
-
-	int front_;	//Punta alla scansione meno recente
-	int back_;	//Punta alla prossima locazione in cui inserire
-
-	/*!
-	 * @brief Ritorna l'indice successivo nel buffer circolare dell'indice passato (eventualmente ricominciando dalla posizione 0)
-	 * @param index L'indice di cui calcolare il successivo
-	 * @return L'indice succesivo di index
-	*/
-	inline int next_circular_index(int index) const { return (index + 1) % BUFFER_DIM; }
-	/*!
-	 * @brief Ritorna l'indice precedente nel buffer circolare dell'indice passato (eventualmente ricominciando dalla posizione (BUFFER_DIM - 1))
-	 * @param index L'indice di cui calcolare il precedente
-	 * @return L'indice precedente di index
-	*/
-	inline int previous_circular_index(int index) const { return (index - 1 + BUFFER_DIM) % BUFFER_DIM; }
-	/*!
-	 * @brief Esegue una deep copy dei valori del buffer passato in un nuovo buffer di dimensione BUFFER_DIM
-	 * @param from buffer originario
-	 * @param values_per_scan numero di valori da copiare
-	 * @return buffer con gli elementi di from
-	*/
-	double** copy_buffer(double** from, int values_per_scan) const;
-};
-
-/*!
- * @brief Stampa i valori del LaserScannerDriver su os.
- * @param os stream di output di origine
- * @param lsd oggetto di origine
- * @return os con i valori di lsd formattati opportunamente
-*/
-std::ostream& operator<< (std::ostream& os, const LaserScannerDriver& lsd);
-/*!
- * @brief Calcola l'indice della misurazione corrente data la risoluzione angolare.
- *
- * @param angle un angolo
- * @param resolution una risoluzione angolare
- * @return L'indice della misurazione. Se l'angolo  troppo grande, ritorna il numero dell'ultima misurazione eseguita (pi piccola di kMaxAngle). Se l'angolo  minore di 0 ritorna 0.
- *		   Se resolution < 0 ritorna -1
-*/
-int evalute_measurement_index(double angle, double resolution);
\ No newline at end of file
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <memory_resource>
+#include <span>
+#include "ScanDelta.h"
+#include "ScanDownsampling.h"
+#include "ScanGeometry.h"
+#include "ScanRangeIndex.h"
+#include "ScanStats.h"
+#include "ScanValidation.h"
+
+
+// Invarianti:
+// - angular_resolution_ > 0.1 && angular_resolution_ < 1
+// - capacity_ >= 1
+// - measurements_ == evalute_measurement_index(kMaxAngle, angular_resolution_) + 1
+// - stride_ >= measurements_ && stride_ è multiplo di kDoublesPerCacheLine
+// - slots_.size() == capacity_ + 1 (0 solo negli oggetti spostati). slots_[i] punta alle stride_ misurazioni dello slot i-esimo, allineate a kCacheLineSize
+//   e precedute dalla relativa SlotHeader. slots_[capacity_] è lo slot di scrittura, che non contiene mai una scansione valida
+// - uno slot con references > 1 è condiviso con delle copie del driver e non viene mai modificato: prima di scriverci viene sostituito da uno slot nuovo.
+//   Unica eccezione lo slot di scrittura riservato con acquire_write_slot() al momento della copia, che per la copia non contiene una scansione valida
+// - size_ >= 0 && size_ <= capacity_ è il numero di scansioni valide presenti nel buffer
+// - front_ >= 0 && front_ < capacity_
+// - front_ è l'indice dello slot contenente la scansione meno recente (la prima da rimuovere), non significativo se il buffer è vuoto
+// - back_ >= 0 && back_ < capacity_
+// - back_ è l'indice dello slot in cui inserire una nuova scansione. back_ == (front_ + size_) % capacity_
+// - leased_ implica size_ > 0: lo slot front_ è prestato e non può essere sovrascritto né rimosso se non dalla ScanLease
+// - writing_ implica che lo slot di scrittura sia riservato al produttore
+// - gli istanti di acquisizione delle scansioni valide non decrescono dalla meno recente alla più recente
+// - le costanti all'interno del codice devono avere valori validi già in fase di compilazione:
+//       - kMaxAngle > 0
+//       - kDefaultCapacity >= 1
+//       - kDefaultResolution >= 0.1 && kDefaultResolution <= 1
+class LaserScannerDriver
+{
+public:
+	/*!
+	 * @brief Angolo massimo raggiungibile da una scansione del lidar
+	 * Essendo costante posso renderla anche pubblica, sarà utilizzabile in fase di solo accesso.
+	 * Utile per evitare di avere "magic numbers" sparsi per il codice
+	*/
+	static constexpr double kMaxAngle = 180;
+	/*!
+	 * @brief Numero massimo di riduzioni della scansione più recente mantenute contemporaneamente (vedi downsampled_scan())
+	*/
+	static constexpr int kMaxDownsampledViews = 4;
+	/*!
+	 * @brief Orologio con cui vengono misurati gli istanti di acquisizione delle scansioni (lo stesso di ConcurrentLaserScannerDriver)
+	*/
+	using Clock = std::chrono::steady_clock;
+
+	/*!
+	 * @brief Eccezione lanciata se si fanno operazioni non consentite su buffer vuoto
+	*/
+	class EmptyBufferException {};
+
+	/*!
+	 * @brief Guardia RAII che presta al chiamante la scansione meno recente senza copiarla.
+	 * @details Lo slot resta riservato finchè la guardia è in vita: alla sua distruzione (o con release()) la scansione viene rimossa dal buffer,
+	 * esattamente come farebbe get_scan(). Il LaserScannerDriver che l'ha creata deve sopravvivere alla guardia e non deve essere spostato nel frattempo
+	*/
+	class ScanLease
+	{
+	public:
+		ScanLease(ScanLease&& lease) noexcept;
+		ScanLease& operator=(ScanLease&& lease) noexcept;
+		ScanLease(const ScanLease&) = delete;
+		ScanLease& operator=(const ScanLease&) = delete;
+		/*!
+		 * @brief Rilascia lo slot, rimuovendo la scansione dal buffer
+		*/
+		~ScanLease();
+
+		/*!
+		 * @brief Rimuove la scansione dal buffer prima della distruzione della guardia. Dopo la chiamata la vista non è più valida
+		*/
+		void release();
+
+		inline std::span<const double> scan() const { return scan_; }
+		inline std::size_t size() const { return scan_.size(); }
+		inline double operator[](std::size_t index) const { return scan_[index]; }
+		inline std::span<const double>::iterator begin() const { return scan_.begin(); }
+		inline std::span<const double>::iterator end() const { return scan_.end(); }
+
+	private:
+		friend class LaserScannerDriver;
+		ScanLease(LaserScannerDriver* owner, std::span<const double> scan) : owner_{ owner }, scan_{ scan } {}
+
+		LaserScannerDriver* owner_;		//nullptr se la guardia è già stata rilasciata o spostata
+		std::span<const double> scan_;
+	};
+
+	/*!
+	 * @brief Interfaccia per gli stadi che devono essere avvisati quando una scansione entra o esce dal buffer (registratori, filtri, ...).
+	 * @details I metodi vengono chiamati in modo sincrono dal thread che modifica il buffer: non devono modificare il driver nè lanciare eccezioni.
+	 * La scansione passata è valida solo per la durata della chiamata
+	*/
+	class ScanObserver
+	{
+	public:
+		virtual ~ScanObserver() = default;
+		/*!
+		 * @brief Chiamato dopo che una nuova scansione è stata inserita (new_scan() o commit()). scan è la scansione più recente
+		*/
+		virtual void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) = 0;
+		/*!
+		 * @brief Chiamato prima che una scansione esca dal buffer: sovrascritta a buffer pieno, rimossa con get_scan()/take_scan() o con clear_buffer()
+		*/
+		virtual void on_scan_evicted(const LaserScannerDriver&, std::span<const double>) {}
+		/*!
+		 * @brief Chiamato dopo che un assegnamento ha sostituito per intero il contenuto del buffer. Le scansioni uscite e quelle entrate non vengono
+		 * notificate una per una: sono già state notificate al driver da cui provengono, e gli osservatori che registrano il flusso delle scansioni
+		 * (registratori, filtri, ...) le riceverebbero due volte. Chi rispecchia il contenuto del buffer deve ricostruirlo da driver
+		*/
+		virtual void on_buffer_replaced(const LaserScannerDriver&) {}
+	};
+
+	/*!
+	 * @brief Crea una nuova istanza di LaserScannerDriver.
+	 * @details Deve essere chiamato esplicitamente per evitare la conversione che in questo caso è indesiderata.
+	 * Tutta la memoria del buffer viene allocata qui, una sola volta: new_scan() e get_scan() non eseguono ulteriori allocazioni sul buffer
+	 * @param resolution risoluzione angolare del LIDAR
+	 * @param capacity numero massimo di scansioni mantenute nel buffer
+	 * @param resource risorsa da cui allocare tutta la memoria del driver (buffer, slot sostituiti dal copy-on-write, osservatori, indice di
+	 * min_distance()). Deve sopravvivere al driver e alle sue copie. Di default è la risorsa predefinita di std::pmr, cioè il free store
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1] o se capacity < 1
+	 * @throws std::bad_alloc se resource non riesce ad allocare il buffer
+	*/
+	explicit LaserScannerDriver(double resolution = kDefaultResolution, int capacity = kDefaultCapacity,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	/*!
+	 * @brief Distruttore di LaserScannerDriver. Rilascia la memoria
+	*/
+	~LaserScannerDriver();
+	/*!
+	 * @brief copy constructor
+	 * @details Le scansioni non vengono copiate ma condivise (copy-on-write): il costo è un incremento di contatore per slot, senza allocare nè copiare
+	 * le misurazioni. Gli osservatori non vengono copiati: la copia parte senza osservatori registrati. La copia usa la stessa memory_resource di lsd
+	*/
+	LaserScannerDriver(const LaserScannerDriver& lsd);
+	/*!
+	 * @brief move constructor
+	 * @details Gli osservatori registrati su lsd passano al nuovo oggetto
+	 */
+	LaserScannerDriver(LaserScannerDriver&& lsd);
+
+	/*!
+	 * @brief Copy assignment, condivide le scansioni di lsd come il copy constructor.
+	 * @details Gli osservatori di questo oggetto restano registrati e ricevono solo on_buffer_replaced(): le scansioni di lsd non vengono notificate di nuovo
+	*/
+	LaserScannerDriver& operator=(const LaserScannerDriver& lsd);
+	/*!
+	 * @brief Move assignment
+	 * @details Come per il copy assignment gli osservatori di questo oggetto restano registrati, quelli di lsd vengono rimossi
+	*/
+	LaserScannerDriver& operator=(LaserScannerDriver&& lsd);
+
+	/*!
+	 * @brief Inserisce la scansione fornita nel vector all'interno del buffer. 
+	 * @details Le misurazioni NaN o negative vengono gestite secondo invalid_value_policy()
+	 * @param timestamp istante di acquisizione della scansione, memorizzato insieme ad essa (di default l'istante della chiamata)
+	 * @return il numero di misurazioni non valide sostituite (sempre 0 con la politica kThrow)
+	 * @throws std::invalid_argument se la politica è kThrow e la scansione contiene misurazioni non valide, o se timestamp è precedente
+	 * a quello della scansione più recente. La scansione non viene inserita
+	*/
+	int new_scan(const std::vector<double>& v, Clock::time_point timestamp = Clock::now());
+	/*!
+	 * @brief Riserva lo slot in cui verrà inserita la prossima scansione, così che il produttore possa scriverci direttamente senza passare da un vector.
+	 * @details Se il buffer è pieno la scansione meno recente viene scartata solo da commit(), come in new_scan(). Lo slot contiene valori non significativi:
+	 * vanno scritte tutte le measurements() misurazioni. La scansione diventa visibile solo dopo commit(). Se lo slot è già stato riservato viene ritornato lo stesso slot
+	 * @throws std::bad_alloc se lo slot è condiviso con una copia del driver e non è possibile allocarne uno nuovo
+	*/
+	std::span<double> acquire_write_slot();
+	/*!
+	 * @brief Valida secondo invalid_value_policy() e inserisce nel buffer la scansione scritta nello slot ottenuto con acquire_write_slot()
+	 * @return il numero di misurazioni non valide sostituite (sempre 0 con la politica kThrow)
+	 * @throws std::logic_error se non è stato riservato alcuno slot, o se il buffer è pieno e la scansione meno recente è in prestito (lo slot resta riservato)
+	 * @param timestamp come in new_scan()
+	 * @throws std::invalid_argument se la politica è kThrow e la scansione contiene NaN o valori negativi, o se timestamp è precedente a quello della
+	 * scansione più recente. In tal caso lo slot viene rilasciato senza inserire la scansione
+	*/
+	int commit(Clock::time_point timestamp = Clock::now());
+	/*!
+	 * @brief Ritorna la scansione più vecchia, eliminandola dal buffer.
+	 * @details Equivale a copiare in un vector la scansione prestata da take_scan()
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::logic_error se la scansione meno recente è già in prestito
+	*/
+	std::vector<double> get_scan();
+	/*!
+	 * @brief Come get_scan(), ma il vector ritornato alloca la propria memoria da resource (ad esempio un'arena del consumatore)
+	*/
+	std::pmr::vector<double> get_scan(std::pmr::memory_resource* resource);
+	/*!
+	 * @brief Presta la scansione più vecchia senza copiarla. Verrà rimossa dal buffer alla distruzione della guardia ritornata.
+	 * @details Finchè la guardia è in vita new_scan() non può sovrascrivere lo slot prestato
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::logic_error se la scansione meno recente è già in prestito
+	*/
+	ScanLease take_scan();
+	/*!
+	 * @brief Ritorna una vista (senza copia né rimozione) sulla scansione meno recente.
+	 * @details La vista è valida fino alla prossima operazione che modifica il buffer
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::span<const double> oldest_scan() const;
+	/*!
+	 * @brief Ritorna una vista (senza copia né rimozione) sulla scansione più recente, quella usata da get_distance().
+	 * @details La vista è valida fino alla prossima operazione che modifica il buffer
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	std::span<const double> newest_scan() const;
+	/*!
+	 * @brief Ritorna una vista (senza copia né rimozione) sulla scansione index-esima del buffer: 0 è la meno recente, size() - 1 la più recente.
+	 * @details La vista è valida fino alla prossima operazione che modifica il buffer
+	 * @throws std::out_of_range se index non è nel range [0 , size())
+	*/
+	std::span<const double> scan(int index) const;
+	/*!
+	 * @brief Ritorna l'istante di acquisizione della scansione index-esima del buffer (0 è la meno recente)
+	 * @throws std::out_of_range se index non è nel range [0 , size())
+	*/
+	Clock::time_point timestamp(int index) const;
+	/*!
+	 * @brief Ritorna l'istante di acquisizione di una scansione ottenuta dal driver (oldest_scan(), newest_scan(), scan(), ScanLease) o passata
+	 * ad un ScanObserver. Non esegue controlli: la vista deve essere ancora valida
+	*/
+	static inline Clock::time_point timestamp(std::span<const double> scan) { return header(scan.data())->timestamp; }
+	/*!
+	 * @brief Elimina tutte le scansioni. Un'eventuale guardia ScanLease ancora in vita non rimuoverà più nulla alla sua distruzione
+	*/
+	void clear_buffer();
+	/*!
+	 * @brief Registra un osservatore, che verrà avvisato ad ogni scansione inserita o rimossa. Non ne acquisisce la proprietà:
+	 * l'osservatore deve restare in vita finchè è registrato
+	*/
+	void add_observer(ScanObserver* observer);
+	/*!
+	 * @brief Rimuove un osservatore registrato con add_observer(). Non fa nulla se l'osservatore non è registrato
+	*/
+	void remove_observer(ScanObserver* observer);
+	/*!
+	 * @brief Ritorna la distanza della scansione più recente presente all'angolo fornito. Si approssima al valore più vicino se tale angolo
+	 * non è presente
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	*/
+	double get_distance(double angle) const;
+	/*!
+	 * @brief Ritorna la distanza all'angolo fornito stimata all'istante time, interpolando linearmente le due scansioni acquisite subito prima e subito dopo.
+	 * @details La coppia di scansioni viene cercata con una ricerca binaria sugli istanti di acquisizione, in O(log size()).
+	 * Prima della scansione meno recente (dopo la più recente) ritorna la distanza di quest'ultima, senza estrapolare. Se una delle due misurazioni
+	 * è NaN (politica kMarkInvalid) ritorna quella della scansione più vicina a time
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se l'angolo è NaN
+	*/
+	double get_distance(double angle, Clock::time_point time) const;
+	/*!
+	 * @brief Versione "a lotti" di get_distance(): scrive in distances[i] la distanza della scansione più recente all'angolo angles[i].
+	 * @details I controlli (buffer vuoto, angoli NaN) e il calcolo della scansione più recente vengono eseguiti una sola volta per tutto il lotto,
+	 * mentre la conversione angolo -> indice è vettorizzata. Il risultato coincide con quello di get_distance() chiamato per ogni angolo
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se distances è più piccolo di angles o se almeno un angolo è NaN (in tal caso distances non è significativo)
+	*/
+	void get_distances(std::span<const double> angles, std::span<double> distances) const;
+	/*!
+	 * @brief Converte la scansione più recente in coordinate cartesiane: (x[i], y[i]) è il punto misurato all'angolo i * angular_resolution().
+	 * @details Seno e coseno degli angoli non vengono calcolati ad ogni chiamata ma letti da una TrigTable condivisa da tutti i driver con la stessa
+	 * risoluzione. Non esegue allocazioni: i punti vengono scritti nei buffer forniti dal chiamante
+	 * @param mounting se fornito, i punti vengono espressi nel sistema di riferimento del robot invece che in quello del LIDAR
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se x o y hanno meno di measurements() elementi
+	*/
+	void get_points(std::span<double> x, std::span<double> y) const;
+	void get_points(std::span<double> x, std::span<double> y, const MountingTransform& mounting) const;
+	/*!
+	 * @brief Ritorna la distanza minima (massima) della scansione più recente tra gli angoli first_angle e last_angle compresi.
+	 * @details Gli estremi vengono approssimati alla misurazione più vicina come in get_distance(), per cui min_distance(a, a) == get_distance(a).
+	 * La prima interrogazione dopo l'inserimento di una scansione costruisce un indice in O(measurements() log measurements()); le successive,
+	 * sulla stessa scansione, costano O(1) indipendentemente dall'ampiezza dell'intervallo. Le misurazioni NaN vengono ignorate
+	 * (il risultato è NaN solo se tutte le misurazioni dell'intervallo sono NaN).
+	 * L'indice è una cache interna al driver: a differenza degli altri metodi const, questi metodi non possono essere chiamati contemporaneamente
+	 * da più thread sullo stesso driver
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se un angolo è NaN o se first_angle > last_angle
+	*/
+	double min_distance(double first_angle, double last_angle) const;
+	double max_distance(double first_angle, double last_angle) const;
+	/*!
+	 * @brief Come min_distance(), ma ritorna l'angolo della misurazione minima (a parità di distanza il minore) invece della distanza
+	*/
+	double argmin_distance(double first_angle, double last_angle) const;
+	/*!
+	 * @brief Ritorna una vista sulla scansione più recente ridotta alla risoluzione fornita (multipla di angular_resolution()), vedi downsample().
+	 * @details Ogni riduzione viene calcolata alla prima richiesta e mantenuta finchè non cambia la scansione più recente: più consumatori che
+	 * chiedono la stessa risoluzione condividono un solo calcolo. Vengono mantenute al più kMaxDownsampledViews riduzioni (risoluzione e modalità)
+	 * diverse: oltre, la richiesta di una nuova riduzione riutilizza la memoria di quella aggiornata meno di recente.
+	 * La vista è valida fino alla prossima operazione che modifica il buffer o alla richiesta di una riduzione non presente.
+	 * Come min_distance(), questi metodi non possono essere chiamati contemporaneamente da più thread sullo stesso driver
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se resolution non è un multiplo positivo di angular_resolution()
+	*/
+	std::span<const double> downsampled_scan(double resolution, Downsampling mode = Downsampling::kMin) const;
+	/*!
+	 * @brief Come get_distance(), ma legge la distanza dalla scansione più recente ridotta alla risoluzione fornita (vedi downsampled_scan())
+	 * @throws std::invalid_argument anche se l'angolo è NaN
+	*/
+	double get_distance(double angle, double resolution, Downsampling mode) const;
+	/*!
+	 * @brief Scrive in ranges gli intervalli di misurazioni della scansione più recente che differiscono di più di threshold dalla scansione precedente
+	 * (vedi find_changed_ranges()). Se il buffer contiene una sola scansione l'intera scansione è considerata cambiata
+	 * @return il numero di misurazioni cambiate
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se threshold è NaN o negativo
+	*/
+	int changed_ranges(double threshold, std::vector<ScanRange>& ranges) const;
+	/*!
+	 * @brief Come changed_ranges(), ma scrive in delta anche i nuovi valori: applicata alla scansione precedente la trasforma in quella più recente
+	*/
+	void newest_delta(double threshold, ScanDelta& delta) const;
+	/*!
+	 * @brief Accessor che ritorna la risoluzione angolare di questo oggetto
+	 * @details Stesso nome della variabile di esemplare per l'accessor
+	*/
+	double angular_resolution() const;
+	/*!
+	 * @brief Accessor che ritorna il numero massimo di scansioni che il buffer può contenere
+	*/
+	inline int capacity() const { return capacity_; }
+	/*!
+	 * @brief Ritorna la risorsa da cui il driver alloca la propria memoria
+	*/
+	inline std::pmr::memory_resource* memory_resource() const { return slots_.get_allocator().resource(); }
+	/*!
+	 * @brief Byte richiesti alla memory_resource dal costruttore con questi parametri, utile per dimensionare un'arena all'avvio.
+	 * Gli slot sostituiti dal copy-on-write e l'indice di min_distance() vanno aggiunti a parte
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1] o se capacity < 1
+	*/
+	static std::size_t storage_bytes(double resolution, int capacity);
+	/*!
+	 * @brief Accessor che ritorna il numero di misurazioni di ogni scansione
+	*/
+	inline int measurements() const { return measurements_; }
+	/*!
+	 * @brief Ritorna il numero di scansioni attualmente presenti nel buffer
+	*/
+	inline int size() const { return size_; }
+	/*!
+	 * @brief Ritorna il comportamento adottato da new_scan() e commit() in presenza di misurazioni non valide
+	*/
+	inline InvalidValuePolicy invalid_value_policy() const { return invalid_policy_; }
+	/*!
+	 * @brief Imposta il comportamento adottato da new_scan() e commit() in presenza di misurazioni non valide (di default kThrow)
+	*/
+	inline void set_invalid_value_policy(InvalidValuePolicy policy) { invalid_policy_ = policy; }
+	/*!
+	 * @brief Istantanea delle statistiche del driver (scansioni sovrascritte e rifiutate, occupazione massima, latenze).
+	 * @details Può essere chiamato da un altro thread mentre il proprietario continua ad usare il driver, senza rallentarlo: i contatori vengono
+	 * letti uno alla volta, per cui l'istantanea può mescolare valori di istanti leggermente diversi. Se la strumentazione è stata
+	 * disabilitata in compilazione (LSDRIVER_DISABLE_STATS) ritorna sempre un'istantanea vuota
+	*/
+	inline DriverStats stats() const { return stats_.snapshot(); }
+	/*!
+	 * @brief Azzera le statistiche. Va chiamato dal thread che usa il driver
+	*/
+	inline void reset_stats() { stats_.reset(); }
+
+	//Nota di progettazione:
+	//I seguenti metodi son stati resi pubblici per far sapere all'esterno se il buffer è pieno o vuoto. Usando tali metodi  l'utente può sapere se un'invocazione futura 
+	//di new_scan() sovrascriverà una lettura (buffer pieno) o se una futura invocazione di get_scan() / get_distance() può lanciare eccezione (buffer vuoto) e gestire tale caso
+	inline bool is_empty() const { return size_ == 0; }
+	inline bool is_full() const { return size_ == capacity_; }
+
+private:
+	/*!
+	*  @brief Dimensione (in byte) di una linea di cache, usata per allineare lo slab e i singoli slot
+	*/
+	static constexpr int kCacheLineSize = 64;
+	static constexpr int kDoublesPerCacheLine = kCacheLineSize / sizeof(double);
+	/*!
+	 * @brief Numero di double di uno slot con measurements misurazioni, arrotondato per eccesso ad un multiplo di kDoublesPerCacheLine
+	*/
+	static constexpr int slot_stride(int measurements) { return (measurements + kDoublesPerCacheLine - 1) / kDoublesPerCacheLine * kDoublesPerCacheLine; }
+
+	/*!
+	 * @brief Intestazione che precede le misurazioni di ogni slot (e l'intero slab). Occupa una linea di cache, così le misurazioni restano allineate
+	*/
+	struct alignas(kCacheLineSize) SlotHeader
+	{
+		std::atomic<int> references;	//Driver che condividono lo slot (per l'intestazione dello slab: slot dello slab ancora in uso)
+		SlotHeader* slab;				//Intestazione dello slab che contiene lo slot, nullptr se lo slot è stato allocato singolarmente
+		Clock::time_point timestamp;	//Istante di acquisizione della scansione contenuta nello slot
+		std::pmr::memory_resource* resource;	//Risorsa che ha allocato il blocco (lo slab o lo slot singolo) e dimensione del blocco, per deallocarlo
+		std::size_t bytes;						//anche se il driver che lo rilascia usa un'altra risorsa
+	};
+
+	//NOTA DI PROGETTAZIONE:
+	//Il buffer è allocato nel free store come un unico blocco contiguo (slab) di capacity_ slot, ciascuno di stride_ double, una sola volta nel costruttore.
+	//Rimuovere una scansione significa semplicemente spostare l'indice front_: lo slot verrà riutilizzato dalla prossima new_scan(). In questo modo
+	//a regime non si eseguono allocazioni/deallocazioni per ogni scansione.
+	//Lo slab contiene uno slot in più, lo slot di scrittura: new_scan() valida e copia la scansione lì e, solo se la validazione riesce, lo scambia
+	//(un puntatore) con lo slot back_. A buffer pieno una scansione rifiutata non fa così scartare la meno recente, senza una seconda copia delle misurazioni.
+	//Ogni slot inizia su una linea di cache (stride_ è arrotondato per eccesso a kDoublesPerCacheLine) così che le scansioni non condividano linee di cache.
+	//Gli slot hanno un contatore dei riferimenti: copiare il driver significa copiare i puntatori agli slot e incrementarne i contatori. Una scansione
+	//inserita non viene più modificata, per cui le copie possono condividerla finchè uno dei driver non deve riutilizzare lo slot: solo allora, se lo slot
+	//è ancora condiviso, il driver lo sostituisce con uno slot nuovo allocato singolarmente (copy-on-write). I contatori sono atomici, quindi una copia può
+	//essere letta o distrutta da un altro thread mentre l'originale continua a ricevere scansioni
+	//La memoria viene chiesta ad una std::pmr::memory_resource (di default il free store): chi non può usare l'heap dopo l'avvio (sistemi real-time)
+	//può fornire un'arena preallocata. Anche il vector degli slot e quello degli osservatori usano la stessa risorsa, che è quindi quella del loro allocatore
+	std::pmr::vector<double*> slots_;
+
+	//Default initializer
+	static constexpr double kDefaultResolution = 1;
+	static constexpr int kDefaultCapacity = 2;
+
+	//NOTA DI PROGETTAZIONE:
+	//Il numero di misurazioni per scansione potrebbe essere ricavato in tempo costante con evalute_measurement_index(), ma serve ad ogni accesso
+	//allo slab per calcolare l'inizio dello slot: viene quindi calcolato una sola volta nel costruttore e memorizzato in measurements_.
+
+	/*!
+	 * @brief La risoluzione angolare dell'oggetto
+	 * @details E' stata dichiarata privata e non costante per permettere di eseguire l'assegnamento di copia e di move (vedi spiegazione a riguardo nella **definizione** dei
+	 * relativi metodi). Essendo privata e nessun metodo vi può accedere (se non in lettura) rispetta la specifica secondo cui la risoluzione angolare del LIDAR
+	 * non può cambiare durante tutta la sua vita
+	*/
+	double angular_resolution_;
+
+	int capacity_;		//Numero di slot del buffer
+	int measurements_;	//Numero di misurazioni per scansione
+	int stride_;		//Distanza (in double) tra l'inizio di due slot consecutivi
+	int front_;			//Punta alla scansione meno recente
+	int back_;			//Punta alla prossima locazione in cui inserire
+	int size_;			//Numero di scansioni valide nel buffer
+	bool leased_;		//Vero se la scansione in front_ è prestata ad una ScanLease ancora in vita
+	bool writing_;		//Vero se lo slot di scrittura è stato riservato con acquire_write_slot() e non ancora inserito
+	InvalidValuePolicy invalid_policy_;
+	std::pmr::vector<ScanObserver*> observers_;	//Allocato solo alla registrazione di un osservatore, mai durante new_scan()
+
+	//NOTA DI PROGETTAZIONE:
+	//L'indice per min_distance() e max_distance() viene costruito solo alla prima interrogazione su una scansione: chi non usa le interrogazioni
+	//su intervalli non paga nulla in new_scan(). generation_ viene incrementato ogni volta che cambia la scansione più recente e l'indice è valido
+	//solo se indexed_generation_ coincide
+	std::uint64_t generation_;
+	mutable std::uint64_t indexed_generation_;
+	mutable ScanRangeIndex range_index_;
+	mutable ScanStatsCounters stats_;	//mutable: anche get_distance() registra la propria latenza
+
+	/*!
+	 * @brief Riduzione della scansione più recente, valida se generation coincide con generation_
+	*/
+	struct DownsampledView
+	{
+		int factor;
+		Downsampling mode;
+		std::uint64_t generation;
+		std::pmr::vector<double> values;
+	};
+	//Come l'indice di min_distance(), le riduzioni sono calcolate solo su richiesta: new_scan() si limita ad invalidarle incrementando generation_
+	mutable std::pmr::vector<DownsampledView> downsampled_;
+
+	/*!
+	 * @brief Ritorna l'indice successivo nel buffer circolare dell'indice passato (eventualmente ricominciando dalla posizione 0)
+	 * @param index L'indice di cui calcolare il successivo
+	 * @return L'indice succesivo di index
+	*/
+	inline int next_circular_index(int index) const { return (index + 1) % capacity_; }
+	/*!
+	 * @brief Ritorna l'indice precedente nel buffer circolare dell'indice passato (eventualmente ricominciando dalla posizione (capacity_ - 1))
+	 * @param index L'indice di cui calcolare il precedente
+	 * @return L'indice precedente di index
+	*/
+	inline int previous_circular_index(int index) const { return (index - 1 + capacity_) % capacity_; }
+	/*!
+	 * @brief Ritorna il puntatore al primo elemento dello slot index
+	*/
+	inline double* slot(int index) { return slots_[index]; }
+	inline const double* slot(int index) const { return slots_[index]; }
+	/*!
+	 * @brief Implementazione comune dei due overload di get_points()
+	*/
+	void convert_last_scan(std::span<double> x, std::span<double> y, const MountingTransform* mounting) const;
+	/*!
+	 * @brief Ritorna l'indice della scansione più recente, ricostruendolo se la scansione è cambiata, e gli indici delle misurazioni agli estremi
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se un angolo è NaN o se first_angle > last_angle
+	*/
+	const ScanRangeIndex& range_index(double first_angle, double last_angle, int& first, int& last) const;
+	/*!
+	 * @brief Ritorna la riduzione della scansione più recente, calcolandola se non è presente o non è aggiornata
+	 * @throws EmptyBufferException qualora il buffer sia vuoto
+	 * @throws std::invalid_argument se resolution non è un multiplo positivo di angular_resolution_
+	*/
+	const DownsampledView& downsampled_view(double resolution, Downsampling mode) const;
+	/*!
+	 * @brief copy_validated() con la politica del driver, contando le scansioni rifiutate
+	*/
+	ValidationResult validate(const double* src, double* dest, int count);
+	/*!
+	 * @brief Rimuove la scansione prestata, invocato da ScanLease al rilascio
+	*/
+	void release_lease();
+	/*!
+	 * @brief Avvisa gli osservatori che la scansione nello slot index sta per uscire dal buffer
+	*/
+	void notify_evicted(int index) const;
+	/*!
+	 * @brief Avvisa gli osservatori dell'uscita di tutte le scansioni, dalla meno recente
+	*/
+	void notify_all_evicted() const;
+	/*!
+	 * @brief Avvisa gli osservatori che il contenuto del buffer è stato sostituito da un assegnamento
+	*/
+	void notify_replaced() const;
+	/*!
+	 * @brief Prepara lo slot di scrittura per una nuova scansione, sostituendolo se è condiviso con una copia. Il buffer non viene modificato
+	 * @return Il puntatore al primo elemento dello slot
+	 * @throws std::bad_alloc se lo slot è condiviso e non è possibile allocarne uno nuovo
+	*/
+	double* prepare_write_slot();
+	/*!
+	 * @brief Verifica che una nuova scansione possa essere inserita, cioè che a buffer pieno la scansione meno recente non sia in prestito
+	 * @throws std::logic_error se lo è
+	*/
+	void check_overwrite() const;
+	/*!
+	 * @brief Verifica che timestamp non sia precedente a quello della scansione più recente
+	 * @throws std::invalid_argument se lo è
+	*/
+	void check_timestamp(Clock::time_point timestamp) const;
+	/*!
+	 * @brief Inserisce la scansione (già validata) scritta nello slot di scrittura, acquisita all'istante timestamp: se il buffer è pieno scarta
+	 * la meno recente, poi scambia lo slot di scrittura con lo slot back_
+	*/
+	void publish_write_slot(Clock::time_point timestamp);
+	/*!
+	 * @brief Alloca da resource uno slab di count slot di stride double, inizializzati a 0, e ne inserisce i puntatori in slots
+	*/
+	static void allocate_slab(std::pmr::vector<double*>& slots, int count, int stride, std::pmr::memory_resource* resource);
+	/*!
+	 * @brief Alloca da resource un singolo slot di stride double inizializzato a 0, usato per sostituire uno slot condiviso
+	*/
+	static double* allocate_slot(int stride, std::pmr::memory_resource* resource);
+	static inline std::size_t slab_bytes(int count, int stride) { return sizeof(SlotHeader) + count * slot_bytes(stride); }
+	static inline std::size_t slot_bytes(int stride) { return sizeof(SlotHeader) + static_cast<std::size_t>(stride) * sizeof(double); }
+	static inline SlotHeader* header(const double* slot) { return reinterpret_cast<SlotHeader*>(const_cast<double*>(slot)) - 1; }
+	/*!
+	 * @brief Aggiunge un riferimento a tutti gli slot di slots
+	*/
+	static void share_slots(const std::pmr::vector<double*>& slots);
+	/*!
+	 * @brief Rimuove un riferimento dallo slot, deallocandolo (o deallocando lo slab, se era il suo ultimo slot in uso) quando non è più usato da nessun driver
+	*/
+	static void release_slot(double* slot);
+	/*!
+	 * @brief Rimuove un riferimento da tutti gli slot di questo oggetto e svuota slots_
+	*/
+	void release_slots();
+};
+
+/*!
+ * @brief Stampa i valori del LaserScannerDriver su os.
+ * @param os stream di output di origine
+ * @param lsd oggetto di origine
+ * @return os con i valori di lsd formattati opportunamente
+*/
+std::ostream& operator<< (std::ostream& os, const LaserScannerDriver& lsd);
+/*!
+ * @brief Calcola l'indice della misurazione corrente data la risoluzione angolare.
+ *
+ * @param angle un angolo
+ * @param resolution una risoluzione angolare
+ * @return L'indice della misurazione. Se l'angolo è troppo grande, ritorna il numero dell'ultima misurazione eseguita (più piccola di kMaxAngle). Se l'angolo è minore di 0 ritorna 0.
+ *		   Se resolution < 0 ritorna -1
+*/
+int evalute_measurement_index(double angle, double resolution);
+/*!
+ * @brief Verifica la risoluzione angolare e calcola il numero di misurazioni di una scansione, senza costruire un driver
+ * @return evalute_measurement_index(kMaxAngle, resolution) + 1
+ * @throws std::out_of_range se resolution non è nel range [0.1 , 1]
+*/
+int measurement_count(double resolution);
\ No newline at end of file
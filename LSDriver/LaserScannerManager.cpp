@@ -0,0 +1,233 @@
+#include "LaserScannerManager.h"
+#include "ScanLookup.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+LaserScannerManager::LaserScannerManager(const vector<SensorConfig>& sensors, double output_resolution, int workers, chrono::nanoseconds max_skew)
+	: output_resolution_{ output_resolution }, output_measurements_{ 0 }, max_skew_{ max_skew }, stopping_{ false }
+{
+	if (sensors.empty())
+		throw out_of_range("At least one sensor is required");
+	if (isnan(output_resolution) || output_resolution < 0.1 || output_resolution > 1)
+		throw out_of_range("Output resolution " + to_string(output_resolution) + " invalid: must be in the range [ 0.1 , 1 ]");
+	if (workers < 1)
+		throw out_of_range("At least one worker is required");
+
+	output_measurements_ = static_cast<int>(round(360 / output_resolution_));
+	const double nan = numeric_limits<double>::quiet_NaN();
+
+	for (const SensorConfig& config : sensors)
+	{
+		//Il costruttore di ConcurrentLaserScannerDriver controlla risoluzione e capacità
+		unique_ptr<Sensor> sensor = make_unique<Sensor>(config);
+		int last_index = sensor->queue.measurements() - 1;
+		double resolution = sensor->queue.angular_resolution();
+
+		//Tabella angolo della scansione unita -> misurazione del LIDAR, calcolata una sola volta: la proiezione diventa una semplice lettura per indice.
+		//Un angolo è coperto se dista al più mezza risoluzione da una misurazione del LIDAR
+		sensor->source_index.resize(output_measurements_);
+		for (int i = 0; i < output_measurements_; i++)
+		{
+			double local = fmod(i * output_resolution_ - config.mounting_offset, 360);
+			if (local < 0)
+				local += 360;
+			if (local > 360 - resolution / 2)
+				local -= 360;
+			bool covered = local >= -resolution / 2 && local <= last_index * resolution + resolution / 2;
+			sensor->source_index[i] = covered ? nearest_measurement_index(local, 1 / resolution, last_index) : -1;
+		}
+
+		sensor->staging.assign(output_measurements_, nan);
+		sensor->latest.assign(output_measurements_, nan);
+		sensors_.push_back(std::move(sensor));
+	}
+	merged_.distances.assign(output_measurements_, nan);
+
+	int worker_count = min(workers, static_cast<int>(sensors_.size()));
+	for (int i = 0; i < worker_count; i++)
+		workers_.push_back(make_unique<Worker>());
+	for (size_t i = 0; i < sensors_.size(); i++)
+		workers_[i % worker_count]->sensors.push_back(sensors_[i].get());
+
+	//I thread vengono avviati solo a strutture complete. Se l'avvio di un thread fallisce vanno fermati quelli già partiti prima di propagare l'eccezione
+	try
+	{
+		for (unique_ptr<Worker>& worker : workers_)
+			worker->thread = thread(&LaserScannerManager::run, this, ref(*worker));
+	}
+	catch (...)
+	{
+		stop_workers();
+		throw;
+	}
+}
+
+LaserScannerManager::~LaserScannerManager()
+{
+	stop_workers();
+}
+
+void LaserScannerManager::stop_workers()
+{
+	stopping_.store(true, memory_order_release);
+	for (unique_ptr<Worker>& worker : workers_)
+	{
+		worker->pending.fetch_add(1, memory_order_release);
+		worker->pending.notify_one();
+	}
+	for (unique_ptr<Worker>& worker : workers_)
+		if (worker->thread.joinable())
+			worker->thread.join();
+}
+
+void LaserScannerManager::new_scan(int sensor, const vector<double>& scan, Clock::time_point timestamp)
+{
+	if (sensor < 0 || sensor >= sensor_count())
+		throw out_of_range("Sensor index " + to_string(sensor) + " out of range");
+
+	Sensor& s = *sensors_[sensor];
+	if (s.queue.new_scan(scan, timestamp))
+		s.dropped.fetch_add(1, memory_order_relaxed);
+	s.received.fetch_add(1, memory_order_relaxed);
+
+	//Il worker viene svegliato solo se sta attendendo: notify_one() non esegue chiamate di sistema se nessuno è in attesa
+	Worker& worker = *workers_[sensor % workers_.size()];
+	worker.pending.fetch_add(1, memory_order_release);
+	worker.pending.notify_one();
+}
+
+void LaserScannerManager::run(Worker& worker)
+{
+	while (true)
+	{
+		//pending viene letto prima di svuotare le code e prima di controllare stopping_: una scansione inserita (o stop_workers() chiamato)
+		//dopo la lettura lo modifica e wait() ritorna subito. Controllando stopping_ prima, l'incremento di stop_workers() potrebbe essere
+		//già compreso in seen e il worker attenderebbe per sempre
+		uint64_t seen = worker.pending.load(memory_order_acquire);
+		if (stopping_.load(memory_order_acquire))
+			break;
+
+		bool processed = false;
+		for (Sensor* sensor : worker.sensors)
+		{
+			Clock::time_point timestamp;
+			while (sensor->queue.try_get_scan(sensor->scan, timestamp))
+			{
+				process(*sensor, timestamp);
+				processed = true;
+			}
+		}
+
+		if (!processed)
+			worker.pending.wait(seen, memory_order_acquire);
+	}
+}
+
+void LaserScannerManager::process(Sensor& sensor, Clock::time_point timestamp)
+{
+	//La proiezione (la parte costosa) avviene senza lock, in parallelo con gli altri worker
+	const double nan = numeric_limits<double>::quiet_NaN();
+	for (int i = 0; i < output_measurements_; i++)
+	{
+		int index = sensor.source_index[i];
+		sensor.staging[i] = index >= 0 ? sensor.scan[index] : nan;
+	}
+
+	int64_t lag = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - timestamp).count();
+	sensor.lag_ns.store(lag, memory_order_relaxed);
+	if (lag > sensor.max_lag_ns.load(memory_order_relaxed))		//max_lag_ns è scritto solo da questo worker
+		sensor.max_lag_ns.store(lag, memory_order_relaxed);
+
+	{
+		lock_guard<mutex> lock(merge_mutex_);
+		sensor.latest.swap(sensor.staging);		//Scambio dei buffer: nessuna copia sotto lock
+		sensor.latest_timestamp = timestamp;
+		sensor.fresh = true;
+		try_merge();
+	}
+}
+
+void LaserScannerManager::try_merge()
+{
+	Clock::time_point newest = Clock::time_point::min();
+	for (const unique_ptr<Sensor>& sensor : sensors_)
+	{
+		if (!sensor->fresh)
+			return;
+		newest = max(newest, sensor->latest_timestamp);
+	}
+
+	//Le scansioni troppo vecchie rispetto alla più recente vengono scartate: si attende una nuova scansione da quei LIDAR
+	bool aligned = true;
+	for (const unique_ptr<Sensor>& sensor : sensors_)
+		if (newest - sensor->latest_timestamp > max_skew_)
+		{
+			sensor->fresh = false;
+			sensor->stale.fetch_add(1, memory_order_relaxed);
+			aligned = false;
+		}
+	if (!aligned)
+		return;
+
+	//Per ogni angolo coperto da più LIDAR viene mantenuta la distanza minore (l'ostacolo più vicino). NaN indica un angolo non coperto
+	Clock::time_point oldest = newest;
+	vector<double>& distances = merged_.distances;
+	fill(distances.begin(), distances.end(), numeric_limits<double>::quiet_NaN());
+	for (const unique_ptr<Sensor>& sensor : sensors_)
+	{
+		const vector<double>& latest = sensor->latest;
+		for (int i = 0; i < output_measurements_; i++)
+			if (isnan(distances[i]) || latest[i] < distances[i])
+				distances[i] = latest[i];
+
+		oldest = min(oldest, sensor->latest_timestamp);
+		sensor->fresh = false;
+		sensor->merged.fetch_add(1, memory_order_relaxed);
+	}
+	merged_.timestamp = oldest;
+	merged_.sequence++;
+	merged_ready_.notify_all();
+}
+
+MergedScan LaserScannerManager::merged_scan() const
+{
+	lock_guard<mutex> lock(merge_mutex_);
+	if (merged_.sequence == 0)
+		throw EmptyBufferException();
+	return merged_;
+}
+
+bool LaserScannerManager::wait_merged_scan(MergedScan& scan, chrono::nanoseconds timeout) const
+{
+	unique_lock<mutex> lock(merge_mutex_);
+	uint64_t known = scan.sequence;
+	if (!merged_ready_.wait_for(lock, timeout, [&] { return merged_.sequence > known; }))
+		return false;
+
+	//assign riutilizza la memoria di scan.distances: nessuna allocazione dopo la prima chiamata
+	scan.distances.assign(merged_.distances.begin(), merged_.distances.end());
+	scan.timestamp = merged_.timestamp;
+	scan.sequence = merged_.sequence;
+	return true;
+}
+
+SensorStats LaserScannerManager::stats(int sensor) const
+{
+	if (sensor < 0 || sensor >= sensor_count())
+		throw out_of_range("Sensor index " + to_string(sensor) + " out of range");
+
+	const Sensor& s = *sensors_[sensor];
+	SensorStats result;
+	result.received = s.received.load(memory_order_relaxed);
+	result.dropped = s.dropped.load(memory_order_relaxed);
+	result.stale = s.stale.load(memory_order_relaxed);
+	result.merged = s.merged.load(memory_order_relaxed);
+	result.lag = chrono::nanoseconds(s.lag_ns.load(memory_order_relaxed));
+	result.max_lag = chrono::nanoseconds(s.max_lag_ns.load(memory_order_relaxed));
+	return result;
+}
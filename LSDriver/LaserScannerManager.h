@@ -0,0 +1,170 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ConcurrentLaserScannerDriver.h"
+
+/*!
+ * @brief Configurazione di un LIDAR gestito da LaserScannerManager
+*/
+struct SensorConfig
+{
+	double resolution = 1;			//Risoluzione angolare del LIDAR
+	double mounting_offset = 0;		//Direzione (in gradi, in senso antiorario) dell'angolo 0 del LIDAR nel sistema di riferimento del robot
+	int capacity = 4;				//Scansioni che possono restare in attesa di essere elaborate prima di scartare la meno recente
+};
+
+/*!
+ * @brief Statistiche di un LIDAR gestito da LaserScannerManager. I valori sono un'istantanea: i worker continuano ad aggiornarli
+*/
+struct SensorStats
+{
+	std::uint64_t received = 0;		//Scansioni ricevute con new_scan()
+	std::uint64_t dropped = 0;		//Scansioni scartate perchè la coda era piena (i worker non hanno fatto in tempo ad elaborarle)
+	std::uint64_t stale = 0;		//Scansioni elaborate ma scartate perchè troppo vecchie rispetto a quelle degli altri LIDAR
+	std::uint64_t merged = 0;		//Scansioni usate in una scansione unita
+	std::chrono::nanoseconds lag{ 0 };		//Ritardo tra l'acquisizione e la fine dell'elaborazione dell'ultima scansione
+	std::chrono::nanoseconds max_lag{ 0 };	//Ritardo massimo osservato
+};
+
+/*!
+ * @brief Scansione a 360 gradi ottenuta unendo le scansioni di tutti i LIDAR
+*/
+struct MergedScan
+{
+	std::vector<double> distances;	//distances[i] è la distanza all'angolo i * output_resolution(), NaN se nessun LIDAR copre l'angolo
+	ConcurrentLaserScannerDriver::Clock::time_point timestamp{};	//Timestamp della scansione meno recente tra quelle unite
+	std::uint64_t sequence = 0;		//Numero progressivo della scansione unita, 0 se non è ancora stata prodotta alcuna scansione
+};
+
+// Gestore di più LIDAR montati sullo stesso robot, ciascuno con la propria risoluzione e il proprio orientamento.
+// Ogni LIDAR ha un proprio thread produttore che chiama new_scan(): la scansione viene inserita senza lock in un ConcurrentLaserScannerDriver
+// dedicato e un pool di worker la elabora, proiettandola sugli angoli della scansione a 360 gradi. Quando tutti i LIDAR hanno fornito una nuova
+// scansione, e i loro timestamp distano al più max_skew, le proiezioni vengono unite (per ogni angolo la distanza minore) in una MergedScan.
+//
+// Invarianti:
+// - sensors_.size() >= 1 && workers_.size() >= 1 && workers_.size() <= sensors_.size()
+// - il LIDAR i-esimo è elaborato solo dal worker i % workers_.size()
+// - output_measurements_ == round(360 / output_resolution_)
+// - latest, latest_timestamp e fresh di ogni LIDAR e merged_ sono protetti da merge_mutex_
+class LaserScannerManager
+{
+public:
+	using Clock = ConcurrentLaserScannerDriver::Clock;
+	using EmptyBufferException = LaserScannerDriver::EmptyBufferException;
+
+	/*!
+	 * @brief Crea il gestore e avvia i worker
+	 * @param sensors configurazione dei LIDAR
+	 * @param output_resolution risoluzione angolare della scansione unita
+	 * @param workers numero di thread che elaborano le scansioni (al massimo uno per LIDAR)
+	 * @param max_skew differenza massima tra i timestamp delle scansioni unite
+	 * @throws std::out_of_range se sensors è vuoto, se una risoluzione o una capacità non è valida o se workers < 1
+	*/
+	LaserScannerManager(const std::vector<SensorConfig>& sensors, double output_resolution = 1, int workers = 2,
+		std::chrono::nanoseconds max_skew = std::chrono::milliseconds(50));
+	/*!
+	 * @brief Ferma e attende i worker. Nessun thread deve chiamare new_scan() durante la distruzione
+	*/
+	~LaserScannerManager();
+	LaserScannerManager(const LaserScannerManager&) = delete;
+	LaserScannerManager& operator=(const LaserScannerManager&) = delete;
+
+	/*!
+	 * @brief Inserisce una scansione del LIDAR sensor. Ogni LIDAR deve avere un solo thread che chiama new_scan()
+	 * @param timestamp istante di acquisizione, usato per allineare le scansioni dei diversi LIDAR
+	 * @throws std::out_of_range se sensor non è un indice valido
+	 * @throws std::invalid_argument se la scansione contiene NaN o valori negativi (la scansione non viene inserita)
+	*/
+	void new_scan(int sensor, const std::vector<double>& scan, Clock::time_point timestamp = Clock::now());
+
+	/*!
+	 * @brief Ritorna l'ultima scansione unita
+	 * @throws EmptyBufferException se non è ancora stata prodotta alcuna scansione unita
+	*/
+	MergedScan merged_scan() const;
+	/*!
+	 * @brief Attende una scansione unita più recente di scan (cioè con sequence maggiore di scan.sequence) e la scrive in scan, riutilizzandone la memoria
+	 * @return false se non è stata prodotta alcuna nuova scansione entro timeout
+	*/
+	bool wait_merged_scan(MergedScan& scan, std::chrono::nanoseconds timeout) const;
+
+	/*!
+	 * @brief Statistiche del LIDAR sensor
+	 * @throws std::out_of_range se sensor non è un indice valido
+	*/
+	SensorStats stats(int sensor) const;
+
+	inline int sensor_count() const { return static_cast<int>(sensors_.size()); }
+	inline int worker_count() const { return static_cast<int>(workers_.size()); }
+	inline double output_resolution() const { return output_resolution_; }
+	inline int output_measurements() const { return output_measurements_; }
+
+private:
+	struct Sensor
+	{
+		SensorConfig config;
+		ConcurrentLaserScannerDriver queue;		//Produttore: il thread del LIDAR, consumatore: il worker
+		std::vector<int> source_index;			//Per ogni angolo della scansione unita l'indice della misurazione del LIDAR, -1 se non coperto
+
+		//Usati solo dal worker
+		std::vector<double> scan;
+		std::vector<double> staging;			//Proiezione in corso, scambiata con latest sotto merge_mutex_
+
+		//Protetti da merge_mutex_
+		std::vector<double> latest;				//Ultima proiezione completa
+		Clock::time_point latest_timestamp{};
+		bool fresh = false;						//Vero se latest non è ancora stata usata in una scansione unita
+
+		std::atomic<std::uint64_t> received{ 0 }, dropped{ 0 }, stale{ 0 }, merged{ 0 };
+		std::atomic<std::int64_t> lag_ns{ 0 }, max_lag_ns{ 0 };
+
+		explicit Sensor(const SensorConfig& sensor_config) : config{ sensor_config }, queue(sensor_config.resolution, sensor_config.capacity) {}
+	};
+
+	struct Worker
+	{
+		std::thread thread;
+		std::vector<Sensor*> sensors;
+		std::atomic<std::uint64_t> pending{ 0 };	//Incrementato ad ogni nuova scansione: il worker attende che cambi con wait()
+	};
+
+	double output_resolution_;
+	int output_measurements_;
+	std::chrono::nanoseconds max_skew_;
+	std::vector<std::unique_ptr<Sensor>> sensors_;
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::atomic<bool> stopping_;
+
+	mutable std::mutex merge_mutex_;
+	mutable std::condition_variable merged_ready_;
+	MergedScan merged_;
+
+	/*!
+	 * @brief Ciclo di un worker: elabora le scansioni dei propri LIDAR finchè il gestore non viene distrutto
+	*/
+	void run(Worker& worker);
+	/*!
+	 * @brief Proietta la scansione appena estratta dalla coda sugli angoli della scansione unita e la rende disponibile per l'unione
+	*/
+	void process(Sensor& sensor, Clock::time_point timestamp);
+	/*!
+	 * @brief Unisce le ultime proiezioni di tutti i LIDAR se sono tutte nuove e allineate nel tempo. Da chiamare con merge_mutex_ acquisito
+	*/
+	void try_merge();
+	/*!
+	 * @brief Ferma e attende tutti i worker avviati
+	*/
+	void stop_workers();
+};
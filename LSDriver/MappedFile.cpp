@@ -0,0 +1,61 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile(const string& file_name, bool sequential) : data_{ nullptr }, size_{ 0 }
+{
+#ifdef _WIN32
+	ifstream file(file_name, ios::binary);
+	if (file.fail())
+		throw runtime_error("File not found: " + file_name);
+	ostringstream content;
+	content << file.rdbuf();
+	storage_ = content.str();
+	data_ = storage_.data();
+	size_ = storage_.size();
+#else
+	int fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw runtime_error("File not found: " + file_name);
+
+	struct stat info;
+	if (fstat(fd, &info) < 0)
+	{
+		close(fd);
+		throw runtime_error("Cannot read the size of " + file_name);
+	}
+
+	size_ = static_cast<size_t>(info.st_size);
+	if (size_ > 0)		//mmap non accetta lunghezza 0: un file vuoto resta con data_ == nullptr
+	{
+		void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(fd);
+			throw runtime_error("Cannot map " + file_name + " in memory");
+		}
+		madvise(mapped, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+		data_ = static_cast<const char*>(mapped);
+	}
+	close(fd);		//La mappatura resta valida anche dopo la chiusura del file
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (data_)
+		munmap(const_cast<char*>(data_), size_);
+#endif
+}
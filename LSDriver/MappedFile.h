@@ -0,0 +1,43 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// File aperto in sola lettura e mappato in memoria (mmap), usato da ScanFileLoader e ScanReplayer.
+// Su Windows il file viene invece letto interamente in memoria.
+//
+// Invarianti:
+// - data_ punta a size_ byte con il contenuto del file (nullptr se il file è vuoto)
+class MappedFile
+{
+public:
+	/*!
+	 * @brief Apre e mappa in memoria il file fornito
+	 * @param sequential true se il file verrà letto una sola volta dall'inizio alla fine, false per accessi in posizioni arbitrarie
+	 * @throws std::runtime_error se il file non esiste o non può essere mappato
+	*/
+	explicit MappedFile(const std::string& file_name, bool sequential = true);
+	/*!
+	 * @brief Rilascia la mappatura del file
+	*/
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	inline const char* data() const { return data_; }
+	inline std::size_t size() const { return size_; }
+	inline std::string_view contents() const { return std::string_view(data_, size_); }
+
+private:
+	const char* data_;
+	std::size_t size_;
+#ifdef _WIN32
+	std::string storage_;	//Su Windows il file viene letto interamente in memoria invece di essere mappato
+#endif
+};
@@ -0,0 +1,184 @@
+#include "ScanDelta.h"
+#include "LaserScannerDriver.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	//Numero di misurazioni di una scansione alla risoluzione minima (0.1), il massimo per qualsiasi driver
+	constexpr uint32_t kMaxMeasurements = static_cast<uint32_t>(LaserScannerDriver::kMaxAngle / 0.1) + 1;
+
+	inline bool changed(double previous, double current, double threshold)
+	{
+		return abs(current - previous) > threshold || isnan(previous) != isnan(current);
+	}
+
+	//Aggiunge a ranges gli intervalli delle misurazioni cambiate del gruppo [base , base + width), descritto da mask (bit i = misurazione base + i).
+	//open indica se l'ultimo intervallo di ranges è ancora aperto, cioè se la misurazione base - 1 era cambiata
+	inline void append_group(unsigned mask, int base, int width, bool& open, vector<ScanRange>& ranges)
+	{
+		for (int bit = 0; bit < width; bit++)
+		{
+			bool is_changed = (mask >> bit) & 1;
+			if (is_changed && !open)
+				ranges.push_back(ScanRange{ base + bit, base + bit });
+			else if (!is_changed && open)
+				ranges.back().last = base + bit;
+			open = is_changed;
+		}
+	}
+}
+
+//NOTA DI PROGETTAZIONE:
+//In un ambiente statico quasi tutti i gruppi di misurazioni sono invariati: per ogni gruppo il confronto vettoriale produce una maschera di bit
+//(movemask) e solo i gruppi "di bordo", in cui la maschera non coincide con lo stato dell'intervallo corrente (tutti 0 fuori da un intervallo,
+//tutti 1 dentro), vengono esaminati bit per bit. Gli intervalli aperti vengono chiusi solo quando si incontra una misurazione invariata
+int find_changed_ranges(span<const double> previous, span<const double> current, double threshold, vector<ScanRange>& ranges)
+{
+	if (previous.size() != current.size())
+		throw invalid_argument("Cannot compare scans with a different number of measurements");
+	if (isnan(threshold) || threshold < 0)
+		throw invalid_argument("Change threshold must be a non-negative number");
+
+	ranges.clear();
+	const int count = static_cast<int>(current.size());
+	const double* p = previous.data();
+	const double* c = current.data();
+	bool open = false;
+	int i = 0;
+
+#if defined(__AVX__)
+	const __m256d limit = _mm256_set1_pd(threshold);
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d a = _mm256_loadu_pd(p + i);
+		__m256d b = _mm256_loadu_pd(c + i);
+		__m256d distance = _mm256_andnot_pd(sign, _mm256_sub_pd(b, a));
+		__m256d nan_mismatch = _mm256_xor_pd(_mm256_cmp_pd(a, a, _CMP_UNORD_Q), _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(distance, limit, _CMP_GT_OQ), nan_mismatch)));
+		if (mask != (open ? 0xFu : 0u))
+			append_group(mask, i, 4, open, ranges);
+	}
+#elif defined(__SSE2__)
+	//Con registri da 2 double vengono confrontati due registri per iterazione, così il controllo della maschera avviene ogni 4 misurazioni
+	const __m128d limit = _mm_set1_pd(threshold);
+	const __m128d sign = _mm_set1_pd(-0.0);
+	auto compare = [&](int index)
+	{
+		__m128d a = _mm_loadu_pd(p + index);
+		__m128d b = _mm_loadu_pd(c + index);
+		__m128d distance = _mm_andnot_pd(sign, _mm_sub_pd(b, a));
+		__m128d nan_mismatch = _mm_xor_pd(_mm_cmpunord_pd(a, a), _mm_cmpunord_pd(b, b));
+		return static_cast<unsigned>(_mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(distance, limit), nan_mismatch)));
+	};
+	for (; i + 4 <= count; i += 4)
+	{
+		unsigned mask = compare(i) | (compare(i + 2) << 2);
+		if (mask != (open ? 0xFu : 0u))
+			append_group(mask, i, 4, open, ranges);
+	}
+#endif
+
+	//Ciclo scalare per le misurazioni rimanenti (o per tutte, se non sono disponibili istruzioni SIMD)
+	for (; i < count; i++)
+		append_group(changed(p[i], c[i], threshold), i, 1, open, ranges);
+	if (open)
+		ranges.back().last = count;
+
+	int total = 0;
+	for (const ScanRange& range : ranges)
+		total += range.size();
+	return total;
+}
+
+void ScanDelta::encode(span<const double> previous, span<const double> current, double threshold)
+{
+	measurements_ = static_cast<int>(current.size());
+	if (previous.empty())
+	{
+		if (isnan(threshold) || threshold < 0)
+			throw invalid_argument("Change threshold must be a non-negative number");
+		ranges_.clear();
+		if (measurements_ > 0)
+			ranges_.push_back(ScanRange{ 0, measurements_ });
+	}
+	else
+		find_changed_ranges(previous, current, threshold, ranges_);
+
+	values_.clear();
+	for (const ScanRange& range : ranges_)
+		values_.insert(values_.end(), current.begin() + range.first, current.begin() + range.last);
+}
+
+void ScanDelta::apply(span<double> scan) const
+{
+	if (static_cast<int>(scan.size()) != measurements_)
+		throw invalid_argument("The scan has a different number of measurements than the delta");
+
+	const double* value = values_.data();
+	for (const ScanRange& range : ranges_)
+	{
+		copy(value, value + range.size(), scan.begin() + range.first);
+		value += range.size();
+	}
+}
+
+void ScanDelta::write(ostream& os) const
+{
+	buffer_.resize(encoded_size());
+	char* out = buffer_.data();
+	auto put = [&out](const void* data, size_t size) { memcpy(out, data, size); out += size; };
+
+	uint32_t header[2] = { static_cast<uint32_t>(measurements_), static_cast<uint32_t>(ranges_.size()) };
+	put(header, sizeof(header));
+	const double* value = values_.data();
+	for (const ScanRange& range : ranges_)
+	{
+		uint32_t bounds[2] = { static_cast<uint32_t>(range.first), static_cast<uint32_t>(range.size()) };
+		put(bounds, sizeof(bounds));
+		put(value, range.size() * sizeof(double));
+		value += range.size();
+	}
+	os.write(buffer_.data(), static_cast<streamsize>(buffer_.size()));
+}
+
+bool ScanDelta::read(istream& is)
+{
+	uint32_t header[2];
+	if (!is.read(reinterpret_cast<char*>(header), sizeof(header)))
+		return false;
+	//Le dimensioni vengono da un file non verificato: un valore corrotto non deve far allocare più di una scansione prima di accorgersene
+	if (header[0] > kMaxMeasurements)
+		return false;
+
+	measurements_ = static_cast<int>(header[0]);
+	ranges_.clear();
+	values_.clear();
+	//Gli intervalli devono essere crescenti e non adiacenti e restare dentro la scansione: un file corrotto non deve far scrivere fuori da scan in apply()
+	uint32_t end = 0;
+	for (uint32_t r = 0; r < header[1]; r++)
+	{
+		uint32_t bounds[2];
+		if (!is.read(reinterpret_cast<char*>(bounds), sizeof(bounds)))
+			return false;
+		if (bounds[1] == 0 || bounds[0] > header[0] || bounds[1] > header[0] - bounds[0] || (r > 0 && bounds[0] <= end))
+			return false;
+
+		size_t offset = values_.size();
+		values_.resize(offset + bounds[1]);
+		if (!is.read(reinterpret_cast<char*>(values_.data() + offset), bounds[1] * sizeof(double)))
+			return false;
+		ranges_.push_back(ScanRange{ static_cast<int>(bounds[0]), static_cast<int>(bounds[0] + bounds[1]) });
+		end = bounds[0] + bounds[1];
+	}
+	return true;
+}
@@ -0,0 +1,86 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+
+/*!
+ * @brief Intervallo [first , last) di indici di misurazione
+*/
+struct ScanRange
+{
+	int first = 0;
+	int last = 0;
+
+	inline int size() const { return last - first; }
+	friend bool operator==(const ScanRange&, const ScanRange&) = default;
+};
+
+/*!
+ * @brief Trova gli intervalli di misurazioni cambiate tra due scansioni e li scrive in ranges (in ordine crescente, disgiunti e non adiacenti).
+ * @details Una misurazione è cambiata se |current[i] - previous[i]| > threshold, oppure se è NaN in una sola delle due scansioni
+ * (due NaN sono considerati uguali). Il confronto usa istruzioni AVX o SSE2 se il compilatore le abilita; gruppi interi di misurazioni uguali
+ * (o tutte cambiate) vengono saltati senza esaminare i singoli indici. ranges viene svuotato ma non deallocato: riutilizzandolo tra una
+ * chiamata e l'altra non vengono eseguite allocazioni
+ * @return il numero totale di misurazioni cambiate
+ * @throws std::invalid_argument se le scansioni hanno dimensioni diverse o se threshold è NaN o negativo
+*/
+int find_changed_ranges(std::span<const double> previous, std::span<const double> current, double threshold, std::vector<ScanRange>& ranges);
+
+// Differenza tra due scansioni consecutive: solo gli intervalli cambiati e i nuovi valori delle relative misurazioni. Applicata alla scansione
+// precedente la trasforma nella nuova (a meno delle variazioni entro la soglia, che vengono scartate).
+// Formato serializzato (interi e double nel formato della macchina, come ExportFormat::kBinary):
+//     uint32 measurements, uint32 numero di intervalli, per ogni intervallo uint32 first, uint32 size e size double
+//
+// Invarianti:
+// - ranges_ rispetta le condizioni di find_changed_ranges() ed è contenuto in [0 , measurements_)
+// - values_.size() è la somma delle dimensioni di ranges_: i valori degli intervalli sono memorizzati uno dopo l'altro
+class ScanDelta
+{
+public:
+	/*!
+	 * @brief Calcola la differenza tra previous e current. Con previous vuota l'intera scansione current è considerata cambiata
+	 * @throws std::invalid_argument come find_changed_ranges()
+	*/
+	void encode(std::span<const double> previous, std::span<const double> current, double threshold);
+	/*!
+	 * @brief Scrive i valori cambiati in scan, che deve contenere la scansione usata come previous in encode()
+	 * @throws std::invalid_argument se scan non ha measurements() misurazioni
+	*/
+	void apply(std::span<double> scan) const;
+
+	/*!
+	 * @brief Scrive la differenza su os con una sola chiamata a ostream::write()
+	*/
+	void write(std::ostream& os) const;
+	/*!
+	 * @brief Legge da is una differenza scritta con write()
+	 * @return false se lo stream termina prima della fine della differenza o se i dati non sono coerenti (ad esempio più misurazioni di una scansione
+	 * alla risoluzione minima). In tal caso la differenza non è significativa
+	*/
+	bool read(std::istream& is);
+
+	inline int measurements() const { return measurements_; }
+	inline const std::vector<ScanRange>& ranges() const { return ranges_; }
+	inline std::span<const double> values() const { return values_; }
+	/*!
+	 * @brief Numero di misurazioni cambiate
+	*/
+	inline int changed() const { return static_cast<int>(values_.size()); }
+	/*!
+	 * @brief Dimensione in byte della differenza serializzata
+	*/
+	inline std::size_t encoded_size() const { return 2 * sizeof(std::uint32_t) * (1 + ranges_.size()) + values_.size() * sizeof(double); }
+
+private:
+	int measurements_ = 0;
+	std::vector<ScanRange> ranges_;
+	std::vector<double> values_;
+	mutable std::vector<char> buffer_;		//Buffer di serializzazione riutilizzato da write()
+};
@@ -0,0 +1,51 @@
+#include "ScanDownsampling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+void downsample(span<const double> scan, int factor, Downsampling mode, span<double> dest)
+{
+	if (factor < 1)
+		throw invalid_argument("Downsampling factor must be at least 1");
+	const int measurements = static_cast<int>(scan.size());
+	const int size = downsampled_size(measurements, factor);
+	if (static_cast<int>(dest.size()) < size)
+		throw invalid_argument("Destination too small for the downsampled scan");
+
+	const double inf = numeric_limits<double>::infinity();
+	const double nan = numeric_limits<double>::quiet_NaN();
+	for (int j = 0; j < size; j++)
+	{
+		//Gruppo [j * factor - factor / 2 , j * factor + (factor + 1) / 2): con factor pari la misurazione a metà strada va al gruppo successivo,
+		//come l'arrotondamento di nearest_measurement_index()
+		int first = max(j * factor - factor / 2, 0);
+		int last = j + 1 < size ? j * factor + (factor + 1) / 2 : measurements;
+
+		if (mode == Downsampling::kMin)
+		{
+			double minimum = inf;
+			int valid = 0;
+			for (int i = first; i < last; i++)
+			{
+				minimum = scan[i] < minimum ? scan[i] : minimum;		//I confronti con NaN sono falsi: le misurazioni NaN vengono saltate
+				valid += !isnan(scan[i]);
+			}
+			dest[j] = valid > 0 ? minimum : nan;
+		}
+		else
+		{
+			double sum = 0;
+			int valid = 0;
+			for (int i = first; i < last; i++)
+			{
+				bool is_valid = !isnan(scan[i]);
+				sum += is_valid ? scan[i] : 0;
+				valid += is_valid;
+			}
+			dest[j] = valid > 0 ? sum / valid : nan;
+		}
+	}
+}
@@ -0,0 +1,32 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <span>
+
+/*!
+ * @brief Riduzione applicata alle misurazioni raggruppate in una misurazione a risoluzione più bassa
+*/
+enum class Downsampling
+{
+	kMin,		//Distanza minima del gruppo: l'ostacolo più vicino non viene mai perso (pianificazione conservativa)
+	kMean		//Media delle distanze del gruppo (visualizzazione)
+};
+
+/*!
+ * @brief Numero di misurazioni di una scansione di measurements misurazioni ridotta di factor (una ogni factor, a partire dalla prima)
+*/
+constexpr int downsampled_size(int measurements, int factor) { return measurements > 0 ? (measurements - 1) / factor + 1 : 0; }
+
+/*!
+ * @brief Riduce la risoluzione di scan di factor: dest[j] è la riduzione delle misurazioni i più vicine all'angolo di j che a quello di ogni altra
+ * misurazione ridotta, cioè quelle con round(i / factor) == j (le ultime misurazioni, oltre l'ultimo angolo ridotto, ricadono nell'ultimo gruppo).
+ * @details Così get_distance() sulla scansione ridotta legge la riduzione delle misurazioni attorno all'angolo richiesto.
+ * Le misurazioni NaN vengono ignorate; il risultato è NaN solo se tutto il gruppo è NaN
+ * @param dest destinazione (almeno downsampled_size(scan.size(), factor) elementi)
+ * @throws std::invalid_argument se factor < 1 o se dest è troppo piccolo
+*/
+void downsample(std::span<const double> scan, int factor, Downsampling mode, std::span<double> dest);
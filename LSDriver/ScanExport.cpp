@@ -0,0 +1,133 @@
+#include "ScanExport.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+	//Caratteri necessari per un double in notazione fissa: segno, 309 cifre intere, punto e decimali
+	constexpr size_t kMaxFixedChars = 1 + 309 + 1 + ScanExporter::kMaxPrecision;
+	//Gli angoli dell'intestazione vengono arrotondati a questo numero di decimali, più che sufficienti per qualsiasi risoluzione
+	constexpr double kAngleScale = 1e6;
+}
+
+ScanExporter::ScanExporter(ExportFormat format, int precision) : format_{ format }, precision_{ precision }, sequence_{ 0 }, length_{ 0 }
+{
+	if (precision < 0 || precision > kMaxPrecision)
+		throw out_of_range("Export precision " + to_string(precision) + " invalid: must be in the range [ 0 , " + to_string(kMaxPrecision) + " ]");
+}
+
+void ScanExporter::reserve(size_t count)
+{
+	if (buffer_.size() - length_ < count)
+		buffer_.resize(max(2 * buffer_.size(), length_ + count));
+}
+
+void ScanExporter::append(const char* text, size_t count)
+{
+	reserve(count);
+	memcpy(buffer_.data() + length_, text, count);
+	length_ += count;
+}
+
+void ScanExporter::append(char c)
+{
+	reserve(1);
+	buffer_[length_++] = c;
+}
+
+template <class T>
+void ScanExporter::append_number(T value)
+{
+	reserve(32);
+	length_ = to_chars(buffer_.data() + length_, buffer_.data() + buffer_.size(), value).ptr - buffer_.data();
+}
+
+void ScanExporter::append_fixed(double value)
+{
+	reserve(kMaxFixedChars);
+	length_ = to_chars(buffer_.data() + length_, buffer_.data() + buffer_.size(), value, chars_format::fixed, precision_).ptr - buffer_.data();
+}
+
+span<const char> ScanExporter::format(span<const double> scan, double resolution)
+{
+	uint64_t sequence = sequence_++;
+	if (format_ == ExportFormat::kBinary)
+		return span<const char>(reinterpret_cast<const char*>(scan.data()), scan.size_bytes());
+
+	//Alla prima scansione il buffer viene dimensionato per una riga tipica: le successive lo riutilizzano
+	length_ = 0;
+	reserve(scan.size() * (8 + precision_) + 64);
+	if (format_ == ExportFormat::kCsv)
+	{
+		append_number(sequence);
+		for (double distance : scan)
+		{
+			append(',');
+			if (isnan(distance))
+				append("nan", 3);
+			else
+				append_fixed(distance);
+		}
+		append('\n');
+	}
+	else
+	{
+		static constexpr char kSequence[] = "{\"sequence\":";
+		static constexpr char kResolution[] = ",\"resolution\":";
+		static constexpr char kDistances[] = ",\"distances\":[";
+		append(kSequence, sizeof(kSequence) - 1);
+		append_number(sequence);
+		append(kResolution, sizeof(kResolution) - 1);
+		append_number(resolution);		//Formato più corto che rilegge esattamente lo stesso valore
+		append(kDistances, sizeof(kDistances) - 1);
+		for (size_t i = 0; i < scan.size(); i++)
+		{
+			if (i > 0)
+				append(',');
+			if (isfinite(scan[i]))
+				append_fixed(scan[i]);
+			else
+				append("null", 4);	//JSON non ha NaN nè infinito
+		}
+		append("]}\n", 3);
+	}
+	return span<const char>(buffer_.data(), length_);
+}
+
+void ScanExporter::write_newest(ostream& os, const LaserScannerDriver& lsd)
+{
+	span<const char> text = format(lsd.newest_scan(), lsd.angular_resolution());
+	os.write(text.data(), text.size());
+}
+
+int ScanExporter::write_all(ostream& os, const LaserScannerDriver& lsd)
+{
+	for (int i = 0; i < lsd.size(); i++)
+	{
+		span<const char> text = format(lsd.scan(i), lsd.angular_resolution());
+		os.write(text.data(), text.size());
+	}
+	return lsd.size();
+}
+
+void ScanExporter::write_header(ostream& os, const LaserScannerDriver& lsd)
+{
+	if (format_ != ExportFormat::kCsv)
+		return;
+
+	length_ = 0;
+	append("sequence", 8);
+	for (int i = 0; i < lsd.measurements(); i++)
+	{
+		append(',');
+		//i * risoluzione porta con sè l'errore di rappresentazione (3 * 0.1 = 0.30000000000000004): arrotondato, il formato più corto è "0.3"
+		append_number(round(i * lsd.angular_resolution() * kAngleScale) / kAngleScale);
+	}
+	append('\n');
+	os.write(buffer_.data(), length_);
+}
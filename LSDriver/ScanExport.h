@@ -0,0 +1,84 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+#include "LaserScannerDriver.h"
+
+/*!
+ * @brief Formato di esportazione delle scansioni
+*/
+enum class ExportFormat
+{
+	kCsv,			//Una riga per scansione: numero progressivo seguito dalle distanze separate da virgole (NaN scritto come "nan")
+	kJsonLines,		//Un oggetto JSON per riga: {"sequence":N,"resolution":R,"distances":[...]} (NaN scritto come null)
+	kBinary			//Le measurements() distanze come double nel formato della macchina, senza separatori
+};
+
+// Esportatore di scansioni verso uno stream (file, pipe di telemetria...), pensato per volumi elevati.
+// Le distanze vengono lette direttamente dagli slot del driver (senza passare da get_distance()) e formattate con std::to_chars, che non usa
+// il locale nè lo stato dello stream, in un buffer interno riutilizzato tra una scansione e l'altra: dopo le prime scansioni non vengono eseguite
+// allocazioni. Ogni scansione viene scritta con una sola chiamata a ostream::write(); il formato binario scrive direttamente lo slot.
+//
+// Invarianti:
+// - precision_ >= 0 && precision_ <= kMaxPrecision
+// - sequence_ è il numero di scansioni esportate finora (il numero progressivo della prossima scansione)
+class ScanExporter
+{
+public:
+	static constexpr int kMaxPrecision = 17;
+
+	/*!
+	 * @param precision cifre decimali delle distanze nei formati testuali
+	 * @throws std::out_of_range se precision non è nel range [0 , kMaxPrecision]
+	*/
+	explicit ScanExporter(ExportFormat format, int precision = 3);
+
+	/*!
+	 * @brief Formatta scan nel buffer interno, assegnandole il prossimo numero progressivo
+	 * @return la scansione formattata, valida fino alla prossima chiamata su questo esportatore
+	*/
+	std::span<const char> format(std::span<const double> scan, double resolution);
+	/*!
+	 * @brief Scrive su os la scansione più recente del driver
+	 * @throws LaserScannerDriver::EmptyBufferException qualora il buffer sia vuoto
+	*/
+	void write_newest(std::ostream& os, const LaserScannerDriver& lsd);
+	/*!
+	 * @brief Scrive su os tutte le scansioni del driver, dalla meno recente alla più recente, senza rimuoverle
+	 * @return il numero di scansioni scritte
+	*/
+	int write_all(std::ostream& os, const LaserScannerDriver& lsd);
+	/*!
+	 * @brief Con kCsv scrive la riga di intestazione ("sequence" seguito dagli angoli delle misurazioni del driver, arrotondati al milionesimo di grado),
+	 * con gli altri formati non fa nulla
+	*/
+	void write_header(std::ostream& os, const LaserScannerDriver& lsd);
+
+	inline ExportFormat export_format() const { return format_; }
+	inline int precision() const { return precision_; }
+	inline std::uint64_t exported() const { return sequence_; }
+
+private:
+	ExportFormat format_;
+	int precision_;
+	std::uint64_t sequence_;
+	std::vector<char> buffer_;	//Buffer di formattazione, usato per intero come spazio di lavoro (la lunghezza del testo è in length_)
+	std::size_t length_;
+
+	/*!
+	 * @brief Garantisce almeno count caratteri liberi dopo length_
+	*/
+	void reserve(std::size_t count);
+	void append(const char* text, std::size_t count);
+	void append(char c);
+	template <class T>
+	void append_number(T value);
+	void append_fixed(double value);
+};
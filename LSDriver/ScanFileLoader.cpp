@@ -0,0 +1,127 @@
+#include "ScanFileLoader.h"
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+	inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+	void report(ScanLoadResult& result, size_t offset, string message)
+	{
+		if (result.errors.size() < ScanLoadResult::kMaxReportedErrors)
+			result.errors.push_back(ScanParseError{ offset, std::move(message) });
+		result.error_count++;
+	}
+
+	/*!
+	 * @brief Legge i numeri della riga [begin, end) chiamando on_value per ciascuno. I token non validi vengono riportati in result e saltati
+	*/
+	template <class OnValue>
+	void parse_line(const char* base, const char* begin, const char* end, ScanLoadResult& result, OnValue on_value)
+	{
+		const char* p = begin;
+		while (true)
+		{
+			while (p < end && is_blank(*p))
+				p++;
+			if (p == end)
+				return;
+
+			const char* token_end = p;
+			while (token_end < end && !is_blank(*token_end))
+				token_end++;
+
+			double value;
+			from_chars_result parsed = from_chars(p, token_end, value);
+			if (parsed.ec != errc() || parsed.ptr != token_end)
+				report(result, static_cast<size_t>(p - base), "Not a number: '" + string(p, token_end) + "'");
+			else
+				on_value(value);
+
+			p = token_end;
+		}
+	}
+
+	/*!
+	 * @brief Chiama on_line(inizio, fine) per ogni riga di [begin, end), senza il carattere di fine riga
+	*/
+	template <class OnLine>
+	void for_each_line(const char* begin, const char* end, OnLine on_line)
+	{
+		const char* p = begin;
+		while (p < end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+			if (!line_end)
+				line_end = end;
+			on_line(p, line_end);
+			p = line_end + 1;
+		}
+	}
+}
+
+ScanFileLoader::ScanFileLoader(const string& file_name) : file_{ file_name }
+{
+}
+
+ScanLoadResult ScanFileLoader::load_into(LaserScannerDriver& driver) const
+{
+	ScanLoadResult result;
+	const char* data = file_.data();
+	if (!data)
+		return result;
+
+	for_each_line(data, data + file_.size(), [&](const char* line, const char* line_end)
+		{
+			//Lo slot viene riservato solo al primo numero valido: una riga vuota (o di soli token non validi) non deve scartare la scansione meno recente
+			span<double> slot;
+			size_t count = 0;
+			parse_line(data, line, line_end, result, [&](double value)
+				{
+					if (slot.empty())
+						slot = driver.acquire_write_slot();
+					if (count < slot.size())
+						slot[count] = value;
+					count++;
+				});
+
+			if (slot.empty())
+				return;
+
+			if (count < slot.size())
+				fill(slot.begin() + count, slot.end(), 0.0);
+
+			try
+			{
+				driver.commit();
+				result.scans++;
+			}
+			catch (const logic_error& e)		//invalid_argument (scansione non valida) o buffer pieno con la scansione meno recente in prestito
+			{
+				report(result, static_cast<size_t>(line - data), e.what());
+				result.rejected_scans++;
+			}
+		});
+
+	return result;
+}
+
+ScanLoadResult ScanFileLoader::read_values(vector<double>& v) const
+{
+	ScanLoadResult result;
+	const char* data = file_.data();
+	if (!data)
+		return result;
+
+	for_each_line(data, data + file_.size(), [&](const char* line, const char* line_end)
+		{
+			parse_line(data, line, line_end, result, [&v](double value) { v.push_back(value); });
+			result.scans++;
+		});
+
+	return result;
+}
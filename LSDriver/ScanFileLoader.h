@@ -0,0 +1,68 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LaserScannerDriver.h"
+#include "MappedFile.h"
+
+/*!
+ * @brief Errore incontrato durante la lettura di un file di scansioni
+*/
+struct ScanParseError
+{
+	std::size_t offset;		//Posizione (in byte dall'inizio del file) del token o della riga che ha causato l'errore
+	std::string message;
+};
+
+/*!
+ * @brief Esito della lettura di un file di scansioni
+*/
+struct ScanLoadResult
+{
+	int scans = 0;							//Scansioni inserite nel driver (o righe lette, per read_values())
+	int rejected_scans = 0;					//Scansioni rifiutate dal driver (misurazioni non valide con la politica kThrow, o buffer pieno con la scansione meno recente in prestito)
+	std::size_t error_count = 0;			//Numero totale di errori
+	std::vector<ScanParseError> errors;		//I primi kMaxReportedErrors errori, in ordine di posizione
+
+	static constexpr std::size_t kMaxReportedErrors = 64;
+};
+
+// Lettore di file di testo contenenti scansioni (formato dei file inputN.txt): le misurazioni sono separate da spazi e ogni riga è una scansione.
+// Il file viene mappato in memoria (mmap) e letto con std::from_chars, senza stream nè stringhe intermedie. I token che non sono numeri vengono
+// ignorati (come faceva la vecchia fill() del main) ma riportati nel risultato insieme alla loro posizione nel file.
+class ScanFileLoader
+{
+public:
+	/*!
+	 * @brief Apre e mappa in memoria il file fornito
+	 * @throws std::runtime_error se il file non esiste o non può essere mappato
+	*/
+	explicit ScanFileLoader(const std::string& file_name);
+
+	/*!
+	 * @brief Inserisce nel driver ogni riga del file come una nuova scansione.
+	 * @details I valori vengono scritti direttamente nello slot del driver (acquire_write_slot() / commit()), senza vector intermedi.
+	 * Come in new_scan(), i valori oltre measurements() vengono ignorati e quelli mancanti valgono 0. Le righe senza alcun numero vengono saltate.
+	 * Le scansioni rifiutate da commit() vengono riportate tra gli errori, con la posizione della riga: se il rifiuto è dovuto alla scansione in prestito
+	 * lo slot resta riservato, e verrà riutilizzato dalla prossima acquire_write_slot() o annullato dalla prossima new_scan()
+	 * @return numero di scansioni inserite ed errori incontrati
+	*/
+	ScanLoadResult load_into(LaserScannerDriver& driver) const;
+	/*!
+	 * @brief Aggiunge in coda a v tutti i numeri presenti nel file, indipendentemente dalle righe
+	 * @return numero di righe lette ed errori incontrati
+	*/
+	ScanLoadResult read_values(std::vector<double>& v) const;
+
+	inline std::string_view contents() const { return file_.contents(); }
+
+private:
+	MappedFile file_;
+};
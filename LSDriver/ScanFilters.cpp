@@ -0,0 +1,287 @@
+#include "ScanFilters.h"
+#include "ScanLookup.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+	constexpr double kNaN = numeric_limits<double>::quiet_NaN();
+	constexpr double kInfinity = numeric_limits<double>::infinity();
+	constexpr double kLargest = numeric_limits<double>::max();
+
+	//Mediana e minimo ordinano le misurazioni: un NaN romperebbe i confronti, viene quindi trattato come +infinito e convertito di nuovo in NaN in lettura.
+	//Una misurazione +infinito (nessun ritorno) è valida e deve restare distinta da NaN: viene ordinata come il massimo double, appena prima dei NaN
+	inline double ordered(double value) { return isnan(value) ? kInfinity : (value == kInfinity ? kLargest : value); }
+	inline double restored(double value) { return value == kInfinity ? kNaN : (value == kLargest ? kInfinity : value); }
+
+	void check_window(int window)
+	{
+		if (window < 1)
+			throw out_of_range("Filter window " + to_string(window) + " invalid: must be at least 1");
+	}
+}
+
+ScanFilter::ScanFilter(double resolution) : angular_resolution_{ resolution }, measurements_{ 0 }, scans_{ 0 }
+{
+	measurements_ = measurement_count(resolution);
+}
+
+void ScanFilter::on_scan_committed(const LaserScannerDriver& driver, span<const double> scan)
+{
+	//Le callback non possono lanciare eccezioni: un driver incompatibile viene semplicemente ignorato
+	if (driver.angular_resolution() != angular_resolution_ || static_cast<int>(scan.size()) != measurements_)
+		return;
+
+	update(scan);
+	scans_++;
+}
+
+double ScanFilter::get_distance(double angle) const
+{
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+	if (scans_ == 0)
+		throw LaserScannerDriver::EmptyBufferException();
+
+	return value(nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1));
+}
+
+void ScanFilter::reset()
+{
+	clear();
+	scans_ = 0;
+}
+
+
+EmaFilter::EmaFilter(double resolution, double alpha) : ScanFilter(resolution), alpha_{ alpha }
+{
+	if (isnan(alpha) || alpha <= 0 || alpha > 1)
+		throw out_of_range("EMA weight " + to_string(alpha) + " invalid: must be in the range ( 0 , 1 ]");
+	state_.assign(measurements_, kNaN);
+}
+
+void EmaFilter::update(span<const double> scan)
+{
+	for (int i = 0; i < measurements_; i++)
+	{
+		double x = scan[i];
+		if (isnan(x))
+			continue;
+		double& s = state_[i];
+		s = isnan(s) ? x : s + alpha_ * (x - s);
+	}
+}
+
+double EmaFilter::value(int index) const
+{
+	return state_[index];
+}
+
+void EmaFilter::clear()
+{
+	fill(state_.begin(), state_.end(), kNaN);
+}
+
+
+MedianFilter::MedianFilter(double resolution, int window) : ScanFilter(resolution), window_{ window }, next_{ 0 }, count_{ 0 }
+{
+	check_window(window);
+	size_t size = static_cast<size_t>(measurements_) * window_;
+	values_.assign(size, 0.0);
+	positions_.assign(size, 0);
+	heaps_.assign(size, 0);
+	clear();
+}
+
+void MedianFilter::clear()
+{
+	next_ = count_ = 0;
+
+	//Disposizione iniziale degli indici nell'heap: mediana, max-heap, min-heap, max-heap, ... (posizioni 0, -1, 1, -2, 2, ...)
+	for (int index = 0; index < measurements_; index++)
+	{
+		Mediator m = mediator(index);
+		for (int i = 0; i < window_; i++)
+		{
+			m.positions[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+			m.heap[m.positions[i]] = i;
+		}
+	}
+}
+
+MedianFilter::Mediator MedianFilter::mediator(int index)
+{
+	size_t offset = static_cast<size_t>(index) * window_;
+	return Mediator{ values_.data() + offset, positions_.data() + offset, heaps_.data() + offset + window_ / 2 };
+}
+
+void MedianFilter::update(span<const double> scan)
+{
+	//La posizione e il numero di elementi sono comuni a tutti gli angoli: vengono aggiornati una sola volta, dopo aver inserito tutte le misurazioni
+	for (int index = 0; index < measurements_; index++)
+		insert(mediator(index), ordered(scan[index]));
+
+	next_ = (next_ + 1) % window_;
+	count_ = min(count_ + 1, window_);
+}
+
+//NOTA DI PROGETTAZIONE:
+//L'algoritmo è quello del "mediatore" a doppio heap: il nuovo valore prende il posto del più vecchio nella coda circolare e quindi anche il suo nodo
+//nell'heap, da cui viene fatto risalire o scendere. Se attraversa la radice (la mediana) passa nell'altro heap, che viene riordinato a partire dalla radice
+void MedianFilter::insert(const Mediator& m, double value)
+{
+	bool is_new = count_ < window_;
+	int p = m.positions[next_];
+	double old = m.values[next_];
+	m.values[next_] = value;
+	count_ += is_new;		//Temporaneo: min_count() e max_count() devono contare anche il nuovo valore
+
+	if (p > 0)				//Il nodo è nel min-heap
+	{
+		if (!is_new && old < value)
+			min_sort_down(m, p * 2);
+		else if (min_sort_up(m, p))
+			max_sort_down(m, -1);
+	}
+	else if (p < 0)			//Il nodo è nel max-heap
+	{
+		if (!is_new && value < old)
+			max_sort_down(m, p * 2);
+		else if (max_sort_up(m, p))
+			min_sort_down(m, 1);
+	}
+	else					//Il nodo è la mediana
+	{
+		if (max_count())
+			max_sort_down(m, -1);
+		if (min_count())
+			min_sort_down(m, 1);
+	}
+
+	count_ -= is_new;
+}
+
+bool MedianFilter::compare_exchange(const Mediator& m, int i, int j)
+{
+	if (!less(m, i, j))
+		return false;
+	swap(m.heap[i], m.heap[j]);
+	m.positions[m.heap[i]] = i;
+	m.positions[m.heap[j]] = j;
+	return true;
+}
+
+void MedianFilter::min_sort_down(const Mediator& m, int i)
+{
+	for (; i <= min_count(); i *= 2)
+	{
+		if (i > 1 && i < min_count() && less(m, i + 1, i))
+			i++;
+		if (!compare_exchange(m, i, i / 2))
+			break;
+	}
+}
+
+void MedianFilter::max_sort_down(const Mediator& m, int i)
+{
+	for (; i >= -max_count(); i *= 2)
+	{
+		if (i < -1 && i > -max_count() && less(m, i, i - 1))
+			i--;
+		if (!compare_exchange(m, i / 2, i))
+			break;
+	}
+}
+
+bool MedianFilter::min_sort_up(const Mediator& m, int i)
+{
+	while (i > 0 && compare_exchange(m, i, i / 2))
+		i /= 2;
+	return i == 0;
+}
+
+bool MedianFilter::max_sort_up(const Mediator& m, int i)
+{
+	while (i < 0 && compare_exchange(m, i / 2, i))
+		i /= 2;
+	return i == 0;
+}
+
+double MedianFilter::value(int index) const
+{
+	size_t offset = static_cast<size_t>(index) * window_;
+	const double* values = values_.data() + offset;
+	const int* heap = heaps_.data() + offset + window_ / 2;
+
+	//La media viene fatta sui valori già convertiti: NaN se uno dei due è NaN, +infinito se uno dei due è +infinito
+	double median = restored(values[heap[0]]);
+	if (count_ % 2 == 0)
+		median = (median + restored(values[heap[-1]])) / 2;
+	return median;
+}
+
+
+MinFilter::MinFilter(double resolution, int window) : ScanFilter(resolution), window_{ window }
+{
+	check_window(window);
+	values_.assign(static_cast<size_t>(measurements_) * window_, 0.0);
+	sequences_.assign(static_cast<size_t>(measurements_) * window_, 0);
+	heads_.assign(measurements_, 0);
+	sizes_.assign(measurements_, 0);
+}
+
+void MinFilter::update(span<const double> scan)
+{
+	const uint64_t sequence = scans_;		//Numero di questa scansione: scans_ viene incrementato dopo update()
+
+	for (int index = 0; index < measurements_; index++)
+	{
+		double* values = values_.data() + static_cast<size_t>(index) * window_;
+		uint64_t* sequences = sequences_.data() + static_cast<size_t>(index) * window_;
+		int head = heads_[index];
+		int size = sizes_[index];
+		double x = ordered(scan[index]);
+
+		//Esce dalla testa la misurazione più vecchia di window_ scansioni (al massimo una per scansione).
+		//Gli indici circolari vengono riportati nel range con una sottrazione invece che con %, che costerebbe una divisione per ogni angolo
+		if (size > 0 && sequences[head] + window_ <= sequence)
+		{
+			if (++head == window_)
+				head = 0;
+			size--;
+		}
+		//Le misurazioni maggiori o uguali alla nuova non potranno più essere il minimo
+		while (size > 0)
+		{
+			int back = head + size - 1;
+			if (back >= window_)
+				back -= window_;
+			if (values[back] < x)
+				break;
+			size--;
+		}
+
+		int tail = head + size;
+		if (tail >= window_)
+			tail -= window_;
+		values[tail] = x;
+		sequences[tail] = sequence;
+		heads_[index] = head;
+		sizes_[index] = size + 1;
+	}
+}
+
+double MinFilter::value(int index) const
+{
+	return restored(values_[static_cast<size_t>(index) * window_ + heads_[index]]);
+}
+
+void MinFilter::clear()
+{
+	fill(heads_.begin(), heads_.end(), 0);
+	fill(sizes_.begin(), sizes_.end(), 0);
+}
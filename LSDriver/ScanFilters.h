@@ -0,0 +1,182 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "LaserScannerDriver.h"
+
+// Filtri temporali aggiornati ad ogni scansione inserita nel driver a cui sono registrati (add_observer()). Per ogni angolo tengono conto delle
+// scansioni inserite dalla loro registrazione (o dall'ultimo reset()), indipendentemente da quelle rimosse dal buffer con get_scan().
+// Ogni aggiornamento costa O(measurements) (O(measurements * log window) per la mediana), senza ripercorrere le scansioni precedenti.
+// Le misurazioni NaN (politica kMarkInvalid) vengono ignorate dalla media esponenziale e considerate +infinito da mediana e minimo: non diventano mai
+// il minimo, e la mediana risulta NaN solo se almeno metà della finestra è NaN. Le misurazioni +infinito restano +infinito e precedono i NaN.
+//
+// Invarianti (comuni a tutti i filtri):
+// - angular_resolution_ >= 0.1 && angular_resolution_ <= 1
+// - measurements_ è il numero di misurazioni di una scansione con risoluzione angular_resolution_
+// - scans_ è il numero di scansioni usate dal filtro
+class ScanFilter : public LaserScannerDriver::ScanObserver
+{
+public:
+	/*!
+	 * @brief Aggiorna il filtro con la scansione inserita. Le scansioni di driver con risoluzione diversa da quella del filtro vengono ignorate
+	*/
+	void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) override;
+
+	/*!
+	 * @brief Ritorna il valore filtrato all'angolo fornito, approssimando alla misurazione più vicina come LaserScannerDriver::get_distance()
+	 * @return il valore filtrato, NaN se tutte le misurazioni usate per quell'angolo erano NaN
+	 * @throws LaserScannerDriver::EmptyBufferException se il filtro non ha ancora ricevuto scansioni
+	 * @throws std::invalid_argument se angle è NaN
+	*/
+	double get_distance(double angle) const;
+	/*!
+	 * @brief Dimentica tutte le scansioni ricevute
+	*/
+	void reset();
+
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int measurements() const { return measurements_; }
+	inline std::uint64_t scans() const { return scans_; }
+
+protected:
+	/*!
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1]
+	*/
+	explicit ScanFilter(double resolution);
+
+	/*!
+	 * @brief Aggiorna lo stato del filtro con una scansione di measurements_ misurazioni
+	*/
+	virtual void update(std::span<const double> scan) = 0;
+	/*!
+	 * @brief Valore filtrato della misurazione index. Chiamato solo con scans_ > 0
+	*/
+	virtual double value(int index) const = 0;
+	/*!
+	 * @brief Riporta lo stato del filtro a quello iniziale
+	*/
+	virtual void clear() = 0;
+
+	double angular_resolution_;
+	int measurements_;
+	std::uint64_t scans_;
+};
+
+/*!
+ * @brief Media mobile esponenziale per angolo: filtrato = filtrato + alpha * (misurazione - filtrato). La prima misurazione valida inizializza il filtro
+*/
+class EmaFilter : public ScanFilter
+{
+public:
+	/*!
+	 * @param alpha peso della misurazione più recente, nel range (0 , 1]
+	 * @throws std::out_of_range se resolution o alpha non sono validi
+	*/
+	EmaFilter(double resolution, double alpha);
+
+	inline double alpha() const { return alpha_; }
+
+protected:
+	void update(std::span<const double> scan) override;
+	double value(int index) const override;
+	void clear() override;
+
+private:
+	double alpha_;
+	std::vector<double> state_;		//Valore filtrato di ogni misurazione, NaN finchè non arriva una misurazione valida
+};
+
+/*!
+ * @brief Mediana per angolo delle ultime window scansioni (con un numero pari di scansioni, media dei due valori centrali)
+*/
+class MedianFilter : public ScanFilter
+{
+public:
+	/*!
+	 * @throws std::out_of_range se resolution non è valida o se window < 1
+	*/
+	MedianFilter(double resolution, int window);
+
+	inline int window() const { return window_; }
+
+protected:
+	void update(std::span<const double> scan) override;
+	double value(int index) const override;
+	void clear() override;
+
+private:
+	//NOTA DI PROGETTAZIONE:
+	//Per ogni angolo le ultime window misurazioni sono mantenute in un "mediatore": un max-heap e un min-heap (con la mediana alla radice comune)
+	//costruiti sugli indici di una coda circolare. Inserire una misurazione e scartare la più vecchia costa O(log window), mentre riordinare
+	//l'intera finestra costerebbe O(window). Tutte le misurazioni di una scansione occupano la stessa posizione nella coda circolare, per cui
+	//la posizione e il numero di elementi sono comuni a tutti gli angoli
+	int window_;
+	int next_;				//Posizione della coda circolare in cui inserire la prossima misurazione
+	int count_;				//Misurazioni presenti nella finestra (uguale per tutti gli angoli)
+	std::vector<double> values_;	//Coda circolare delle misurazioni, window_ per angolo
+	std::vector<int> positions_;	//Posizione nell'heap di ogni misurazione, window_ per angolo
+	std::vector<int> heaps_;		//Heap degli indici, window_ per angolo. La mediana è all'indice window_ / 2
+
+	/*!
+	 * @brief Vista sul mediatore di un angolo. heap punta alla mediana: gli indici negativi formano il max-heap, quelli positivi il min-heap
+	*/
+	struct Mediator
+	{
+		double* values;
+		int* positions;
+		int* heap;
+	};
+	Mediator mediator(int index);
+	/*!
+	 * @brief Inserisce value nel mediatore al posto della misurazione più vecchia (in posizione next_)
+	*/
+	void insert(const Mediator& m, double value);
+	static inline bool less(const Mediator& m, int i, int j) { return m.values[m.heap[i]] < m.values[m.heap[j]]; }
+	/*!
+	 * @brief Scambia i nodi i e j dell'heap se il valore in i è minore di quello in j
+	 * @return true se i nodi sono stati scambiati
+	*/
+	static bool compare_exchange(const Mediator& m, int i, int j);
+	void min_sort_down(const Mediator& m, int i);
+	void max_sort_down(const Mediator& m, int i);
+	static bool min_sort_up(const Mediator& m, int i);
+	static bool max_sort_up(const Mediator& m, int i);
+	inline int min_count() const { return (count_ - 1) / 2; }
+	inline int max_count() const { return count_ / 2; }
+};
+
+/*!
+ * @brief Minimo per angolo delle ultime window scansioni (l'ostacolo più vicino visto di recente)
+*/
+class MinFilter : public ScanFilter
+{
+public:
+	/*!
+	 * @throws std::out_of_range se resolution non è valida o se window < 1
+	*/
+	MinFilter(double resolution, int window);
+
+	inline int window() const { return window_; }
+
+protected:
+	void update(std::span<const double> scan) override;
+	double value(int index) const override;
+	void clear() override;
+
+private:
+	//NOTA DI PROGETTAZIONE:
+	//Per ogni angolo viene mantenuta una coda monotona (crescente) delle misurazioni che possono ancora diventare il minimo della finestra: una nuova
+	//misurazione elimina dal fondo quelle maggiori o uguali, e dalla testa escono quelle più vecchie di window scansioni. Ogni misurazione entra ed esce
+	//una sola volta, quindi l'aggiornamento costa O(1) ammortizzato per angolo e il minimo è sempre in testa
+	int window_;
+	std::vector<double> values_;			//Code circolari delle misurazioni, window_ per angolo
+	std::vector<std::uint64_t> sequences_;	//Numero della scansione di ogni misurazione in coda
+	std::vector<int> heads_;				//Testa della coda di ogni angolo
+	std::vector<int> sizes_;				//Elementi nella coda di ogni angolo
+};
@@ -0,0 +1,92 @@
+#include "ScanGeometry.h"
+#include "LaserScannerDriver.h"
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+
+using namespace std;
+
+TrigTable::TrigTable(double resolution) : resolution_{ resolution }, measurements_{ 0 }
+{
+	measurements_ = measurement_count(resolution);
+	cos_.resize(measurements_);
+	sin_.resize(measurements_);
+	for (int i = 0; i < measurements_; i++)
+	{
+		double angle = i * resolution_ * numbers::pi / 180;
+		cos_[i] = std::cos(angle);
+		sin_[i] = std::sin(angle);
+	}
+}
+
+const TrigTable& TrigTable::for_resolution(double resolution)
+{
+	//Ogni thread ricorda l'ultima tabella usata: nel caso comune (una sola risoluzione) non serve acquisire il mutex
+	thread_local const TrigTable* last = nullptr;
+	if (last && last->resolution_ == resolution)
+		return *last;
+
+	static mutex tables_mutex;
+	static map<double, unique_ptr<const TrigTable>> tables;
+
+	lock_guard<mutex> lock(tables_mutex);
+	unique_ptr<const TrigTable>& table = tables[resolution];
+	if (!table)
+	{
+		try
+		{
+			table.reset(new TrigTable(resolution));
+		}
+		catch (...)
+		{
+			tables.erase(resolution);	//Risoluzione non valida: non lascio elementi vuoti nella mappa
+			throw;
+		}
+	}
+	last = table.get();
+	return *table;
+}
+
+void polar_to_cartesian(const TrigTable& table, span<const double> scan, span<double> x, span<double> y, const MountingTransform* mounting)
+{
+	int count = static_cast<int>(scan.size());
+	if (count > table.measurements())
+		throw invalid_argument("The scan has more measurements than the trigonometric table");
+	if (x.size() < scan.size() || y.size() < scan.size())
+		throw invalid_argument("The output span is smaller than the number of measurements");
+
+	//Cicli senza salti e senza chiamate a funzione su array separati: il compilatore li vettorizza (moltiplicazioni e somme su più punti per istruzione)
+	const double* c = table.cos();
+	const double* s = table.sin();
+	const double* d = scan.data();
+	double* px = x.data();
+	double* py = y.data();
+
+	if (!mounting)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			px[i] = d[i] * c[i];
+			py[i] = d[i] * s[i];
+		}
+		return;
+	}
+
+	//Rotazione di yaw applicata alla tabella con le formule di addizione: cos(a + yaw) = cos(a)cos(yaw) - sin(a)sin(yaw), sin(a + yaw) = sin(a)cos(yaw) + cos(a)sin(yaw).
+	//Il seno e il coseno di yaw vengono calcolati una sola volta per scansione
+	double yaw = mounting->yaw * numbers::pi / 180;
+	double cos_yaw = std::cos(yaw);
+	double sin_yaw = std::sin(yaw);
+	double tx = mounting->x;
+	double ty = mounting->y;
+	for (int i = 0; i < count; i++)
+	{
+		double rotated_cos = c[i] * cos_yaw - s[i] * sin_yaw;
+		double rotated_sin = s[i] * cos_yaw + c[i] * sin_yaw;
+		px[i] = tx + d[i] * rotated_cos;
+		py[i] = ty + d[i] * rotated_sin;
+	}
+}
@@ -0,0 +1,63 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+/*!
+ * @brief Posizione e orientamento del LIDAR nel sistema di riferimento del robot
+*/
+struct MountingTransform
+{
+	double x = 0;		//Posizione del LIDAR (stessa unità di misura delle distanze)
+	double y = 0;
+	double yaw = 0;		//Rotazione (in gradi, in senso antiorario) dell'angolo 0 del LIDAR rispetto all'asse x del robot
+};
+
+// Tabella dei valori di coseno e seno degli angoli i * resolution (in gradi) di una scansione, memorizzati come due array separati (SoA) per
+// permettere al compilatore di vettorizzare la conversione in coordinate cartesiane. Viene calcolata una sola volta per ogni risoluzione
+// e condivisa da tutti i driver con quella risoluzione.
+//
+// Invarianti:
+// - cos_.size() == sin_.size() == measurements_
+// - cos_[i] == cos(i * resolution_) e sin_[i] == sin(i * resolution_), con l'angolo convertito in radianti
+class TrigTable
+{
+public:
+	/*!
+	 * @brief Ritorna la tabella della risoluzione fornita, calcolandola alla prima richiesta. Le tabelle non vengono mai deallocate:
+	 * il riferimento ritornato resta valido per tutta l'esecuzione del programma. Può essere chiamata da più thread contemporaneamente
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1]
+	*/
+	static const TrigTable& for_resolution(double resolution);
+
+	inline double resolution() const { return resolution_; }
+	inline int measurements() const { return measurements_; }
+	inline const double* cos() const { return cos_.data(); }
+	inline const double* sin() const { return sin_.data(); }
+
+private:
+	explicit TrigTable(double resolution);
+
+	double resolution_;
+	int measurements_;
+	std::vector<double> cos_;
+	std::vector<double> sin_;
+};
+
+/*!
+ * @brief Converte una scansione da coordinate polari (indice della misurazione, distanza) a coordinate cartesiane usando la tabella precalcolata.
+ * @details Senza trasformazione il punto i-esimo è (d * cos(a), d * sin(a)) con a = i * resolution; con la trasformazione il punto viene ruotato
+ * di mounting.yaw e traslato di (mounting.x, mounting.y). Le distanze NaN producono punti NaN
+ * @param scan distanze della scansione (al più table.measurements() elementi)
+ * @param x destinazione delle ascisse (almeno scan.size() elementi)
+ * @param y destinazione delle ordinate (almeno scan.size() elementi)
+ * @param mounting trasformazione da applicare, nullptr per ottenere i punti nel sistema di riferimento del LIDAR
+ * @throws std::invalid_argument se scan ha più misurazioni della tabella o se x o y sono più piccoli di scan
+*/
+void polar_to_cartesian(const TrigTable& table, std::span<const double> scan, std::span<double> x, std::span<double> y,
+	const MountingTransform* mounting = nullptr);
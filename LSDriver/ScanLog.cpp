@@ -0,0 +1,149 @@
+#include "ScanLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+	constexpr size_t record_size(int measurements) { return sizeof(int64_t) + measurements * sizeof(double); }
+}
+
+ScanRecorder::ScanRecorder(const string& file_name, double resolution)
+	: file_(file_name, ios::binary | ios::trunc), resolution_{ resolution }, recorded_{ 0 }
+{
+	if (!file_)
+		throw runtime_error("Cannot create " + file_name);
+
+	measurements_ = measurement_count(resolution);
+
+	ScanLogHeader header{};
+	memcpy(header.magic, ScanLogHeader::kMagic, sizeof(header.magic));
+	header.version = ScanLogHeader::kVersion;
+	header.measurements = static_cast<uint32_t>(measurements_);
+	header.resolution = resolution_;
+	header.record_size = record_size(measurements_);
+	file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void ScanRecorder::on_scan_committed(const LaserScannerDriver& driver, span<const double> scan)
+{
+	//Le callback non possono lanciare eccezioni: un driver incompatibile viene semplicemente ignorato
+	if (driver.angular_resolution() != resolution_ || static_cast<int>(scan.size()) != measurements_)
+		return;
+
+	//Nel log si registra l'istante di acquisizione memorizzato dal driver, convertito nel tempo di sistema così che resti significativo tra esecuzioni diverse
+	LaserScannerDriver::Clock::duration age = LaserScannerDriver::Clock::now() - LaserScannerDriver::timestamp(scan);
+	int64_t timestamp = chrono::duration_cast<chrono::nanoseconds>((chrono::system_clock::now() - age).time_since_epoch()).count();
+	file_.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
+	file_.write(reinterpret_cast<const char*>(scan.data()), scan.size_bytes());
+	recorded_++;
+}
+
+void ScanRecorder::flush()
+{
+	file_.flush();
+}
+
+ScanDeltaRecorder::ScanDeltaRecorder(ostream& os, double resolution, double threshold)
+	: os_{ os }, resolution_{ resolution }, threshold_{ threshold }, recorded_{ 0 }, written_{ 0 }
+{
+	measurement_count(resolution);		//Verifica la risoluzione
+	if (isnan(threshold) || threshold < 0)
+		throw invalid_argument("Change threshold must be a non-negative number");
+}
+
+void ScanDeltaRecorder::on_scan_committed(const LaserScannerDriver& driver, span<const double> scan)
+{
+	if (driver.angular_resolution() != resolution_)
+		return;
+
+	//Finchè non è stato scritto nulla reference_ è vuota e la scansione viene scritta per intero
+	delta_.encode(reference_, scan, threshold_);
+	if (reference_.empty())
+		reference_.assign(scan.begin(), scan.end());
+	else
+		delta_.apply(reference_);
+
+	LaserScannerDriver::Clock::duration age = LaserScannerDriver::Clock::now() - LaserScannerDriver::timestamp(scan);
+	int64_t timestamp = chrono::duration_cast<chrono::nanoseconds>((chrono::system_clock::now() - age).time_since_epoch()).count();
+	os_.write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp));
+	delta_.write(os_);
+	recorded_++;
+	written_ += delta_.changed();
+}
+
+ScanReplayer::ScanReplayer(const string& file_name) : file_(file_name, false), header_{}, size_{ 0 }
+{
+	if (file_.size() < sizeof(ScanLogHeader))
+		throw runtime_error(file_name + " is not a scan log: file too short");
+
+	memcpy(&header_, file_.data(), sizeof(header_));
+	if (memcmp(header_.magic, ScanLogHeader::kMagic, sizeof(header_.magic)) != 0)
+		throw runtime_error(file_name + " is not a scan log: wrong magic number");
+	if (header_.version != ScanLogHeader::kVersion)
+		throw runtime_error(file_name + " has an unsupported log version");
+	//Il numero di misurazioni deve essere quello della risoluzione: replay() lo copia negli slot di un driver con la stessa risoluzione
+	if (isnan(header_.resolution) || header_.resolution < 0.1 || header_.resolution > 1
+		|| header_.measurements != static_cast<uint32_t>(evalute_measurement_index(LaserScannerDriver::kMaxAngle, header_.resolution) + 1)
+		|| header_.record_size != record_size(static_cast<int>(header_.measurements)))
+		throw runtime_error(file_name + " has a corrupted header");
+
+	size_ = (file_.size() - sizeof(ScanLogHeader)) / header_.record_size;
+}
+
+const char* ScanReplayer::record(size_t n) const
+{
+	if (n >= size_)
+		throw out_of_range("Scan index out of range");
+	return file_.data() + sizeof(ScanLogHeader) + n * header_.record_size;
+}
+
+span<const double> ScanReplayer::scan(size_t n) const
+{
+	//Header e record_size sono multipli di 8 e mmap ritorna indirizzi allineati alla pagina: le distanze sono allineate per double
+	return span<const double>(reinterpret_cast<const double*>(record(n) + sizeof(int64_t)), header_.measurements);
+}
+
+int64_t ScanReplayer::timestamp(size_t n) const
+{
+	int64_t timestamp;
+	memcpy(&timestamp, record(n), sizeof(timestamp));
+	return timestamp;
+}
+
+size_t ScanReplayer::replay(LaserScannerDriver& driver, size_t first, size_t last, Speed speed) const
+{
+	if (first > last || last > size_)
+		throw out_of_range("Replay range out of range");
+	if (driver.angular_resolution() != header_.resolution)
+		throw invalid_argument("The driver resolution differs from the log resolution");
+
+	//Con kOriginal ogni scansione viene inserita all'istante start + (timestamp - timestamp iniziale), così i ritardi non si accumulano
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int64_t first_timestamp = first < last ? timestamp(first) : 0;
+	LaserScannerDriver::Clock::time_point previous = start;
+
+	for (size_t n = first; n < last; n++)
+	{
+		//Con kOriginal la scansione viene inserita con l'istante pianificato, che rispetta gli intervalli del log anche se il thread si sveglia in ritardo
+		LaserScannerDriver::Clock::time_point acquired = LaserScannerDriver::Clock::now();
+		if (speed == Speed::kOriginal)
+		{
+			//I timestamp del log vengono da system_clock, che può tornare indietro (correzioni NTP): il driver rifiuterebbe la scansione
+			acquired = max(start + chrono::duration_cast<LaserScannerDriver::Clock::duration>(chrono::nanoseconds(timestamp(n) - first_timestamp)), previous);
+			this_thread::sleep_until(acquired);
+			previous = acquired;
+		}
+
+		span<const double> source = scan(n);
+		span<double> slot = driver.acquire_write_slot();
+		copy_n(source.begin(), min(source.size(), slot.size()), slot.begin());
+		driver.commit(acquired);
+	}
+	return last - first;
+}
@@ -0,0 +1,163 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+#include "LaserScannerDriver.h"
+#include "MappedFile.h"
+
+// Formato binario dei log di scansioni (file .lsdlog). Tutti i campi sono nell'ordine dei byte della macchina (little endian su x86/ARM):
+//
+//   header (32 byte): magic "LSDRLOG\0" | version (uint32) | measurements (uint32) | resolution (double) | record_size (uint64)
+//   record (record_size byte, ripetuto): timestamp_ns (int64, nanosecondi dall'epoch di system_clock) | measurements distanze (double)
+//
+// I record hanno lunghezza fissa, quindi la scansione n-esima si trova all'offset sizeof(ScanLogHeader) + n * record_size
+struct ScanLogHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t measurements;
+	double resolution;
+	std::uint64_t record_size;
+
+	static constexpr char kMagic[8] = { 'L', 'S', 'D', 'R', 'L', 'O', 'G', '\0' };
+	static constexpr std::uint32_t kVersion = 1;
+};
+static_assert(sizeof(ScanLogHeader) == 32, "ScanLogHeader must have no padding");
+
+// Osservatore che scrive su file ogni scansione inserita nel driver a cui è registrato, con il relativo timestamp.
+// Il driver deve avere la stessa risoluzione con cui è stato creato il registratore
+//
+// Invarianti:
+// - file_ contiene l'header seguito da recorded_ record
+class ScanRecorder : public LaserScannerDriver::ScanObserver
+{
+public:
+	/*!
+	 * @brief Crea (o sovrascrive) il file di log e ne scrive l'header
+	 * @throws std::runtime_error se il file non può essere creato
+	*/
+	ScanRecorder(const std::string& file_name, double resolution);
+	ScanRecorder(const ScanRecorder&) = delete;
+	ScanRecorder& operator=(const ScanRecorder&) = delete;
+
+	/*!
+	 * @brief Aggiunge un record al log. Se il driver ha una risoluzione diversa da quella del log la scansione viene ignorata
+	*/
+	void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) override;
+	/*!
+	 * @brief Scrive su disco i record ancora nel buffer dello stream
+	*/
+	void flush();
+
+	inline std::size_t recorded() const { return recorded_; }
+	inline bool good() const { return file_.good(); }
+
+private:
+	std::ofstream file_;
+	double resolution_;
+	int measurements_;
+	std::size_t recorded_;
+};
+
+// Registratore "differenziale": per ogni scansione inserita nel driver scrive sullo stream fornito solo le misurazioni cambiate, come record
+//     int64 timestamp (nanosecondi dall'epoch di system_clock, come ScanRecorder), ScanDelta serializzata (vedi ScanDelta::write())
+// La prima scansione viene scritta per intero. Un lettore ricostruisce le scansioni applicando ogni ScanDelta alla scansione ricostruita precedente.
+//
+// Invarianti:
+// - reference_ è la scansione ricostruita da un lettore dopo i record scritti finora (vuota prima del primo record)
+class ScanDeltaRecorder : public LaserScannerDriver::ScanObserver
+{
+public:
+	/*!
+	 * @brief Lo stream non viene acquisito: deve restare in vita finchè il registratore è registrato su un driver
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1]
+	 * @throws std::invalid_argument se threshold è NaN o negativo
+	*/
+	ScanDeltaRecorder(std::ostream& os, double resolution, double threshold);
+	ScanDeltaRecorder(const ScanDeltaRecorder&) = delete;
+	ScanDeltaRecorder& operator=(const ScanDeltaRecorder&) = delete;
+
+	/*!
+	 * @brief Scrive le misurazioni cambiate. Se il driver ha una risoluzione diversa da quella del registratore la scansione viene ignorata
+	*/
+	void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) override;
+
+	inline std::size_t recorded() const { return recorded_; }
+	/*!
+	 * @brief Misurazioni scritte finora (measurements * recorded() se ogni scansione fosse scritta per intero)
+	*/
+	inline std::size_t written_measurements() const { return written_; }
+
+private:
+	//NOTA DI PROGETTAZIONE:
+	//Il confronto non avviene con la scansione inserita in precedenza ma con quella che il lettore avrà ricostruito: se una misurazione
+	//varia lentamente, sotto la soglia ad ogni scansione, il confronto con la precedente non la scriverebbe mai e l'errore del lettore crescerebbe
+	//senza limiti. Così invece l'errore di ogni misurazione ricostruita resta entro threshold_
+	std::ostream& os_;
+	double resolution_;
+	double threshold_;
+	std::vector<double> reference_;
+	ScanDelta delta_;
+	std::size_t recorded_;
+	std::size_t written_;
+};
+
+// Lettore di log creati con ScanRecorder. Il file viene mappato in memoria: ogni scansione è accessibile in O(1) e senza copie.
+//
+// Invarianti:
+// - file_ contiene un header valido seguito da size_ record completi (un eventuale record troncato a fine file viene ignorato)
+class ScanReplayer
+{
+public:
+	enum class Speed { kOriginal, kMaximum };
+
+	/*!
+	 * @brief Apre e mappa in memoria il log fornito
+	 * @throws std::runtime_error se il file non esiste o non è un log valido
+	*/
+	explicit ScanReplayer(const std::string& file_name);
+
+	/*!
+	 * @brief Vista sulla scansione n-esima del log, valida finchè esiste il ScanReplayer
+	 * @throws std::out_of_range se n >= size()
+	*/
+	std::span<const double> scan(std::size_t n) const;
+	/*!
+	 * @brief Timestamp della scansione n-esima, in nanosecondi dall'epoch di system_clock
+	 * @throws std::out_of_range se n >= size()
+	*/
+	std::int64_t timestamp(std::size_t n) const;
+
+	/*!
+	 * @brief Inserisce nel driver le scansioni [first, last) del log.
+	 * @details Con Speed::kOriginal tra due scansioni attende lo stesso intervallo registrato nel log, con Speed::kMaximum le inserisce senza attese.
+	 * Le scansioni vengono copiate direttamente negli slot del driver (acquire_write_slot() / commit()), con istante di acquisizione quello pianificato
+	 * (kOriginal) o quello di inserimento (kMaximum). Con kOriginal una scansione registrata con un timestamp precedente a quello della scansione
+	 * prima (system_clock corretto all'indietro durante la registrazione) viene inserita subito, con lo stesso istante della precedente
+	 * @return numero di scansioni inserite
+	 * @throws std::invalid_argument se il driver ha una risoluzione diversa da quella del log, o se una scansione è rifiutata dal driver
+	 * @throws std::out_of_range se first > last o last > size()
+	*/
+	std::size_t replay(LaserScannerDriver& driver, std::size_t first, std::size_t last, Speed speed = Speed::kMaximum) const;
+	std::size_t replay(LaserScannerDriver& driver, Speed speed = Speed::kMaximum) const { return replay(driver, 0, size_, speed); }
+
+	inline std::size_t size() const { return size_; }
+	inline double resolution() const { return header_.resolution; }
+	inline int measurements() const { return static_cast<int>(header_.measurements); }
+
+private:
+	MappedFile file_;
+	ScanLogHeader header_;
+	std::size_t size_;
+
+	const char* record(std::size_t n) const;
+};
@@ -0,0 +1,60 @@
+#include "ScanLookup.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+bool lookup_distances(const double* scan, int last_index, double inverse_resolution, const double* angles, double* distances, int count)
+{
+	bool valid = true;
+	int i = 0;
+
+#if defined(__AVX__)
+	//Stessi passi di nearest_measurement_index() su 4 angoli alla volta: i confronti con 0 e last_index diventano max/min, e floor(x + 0.5) il troncamento
+	//(sempre corretto perchè dopo il max l'indice non è negativo). Con NaN max/min ritornano il secondo operando: l'indice resta nel range e non si legge fuori dalla scansione
+	const __m256d inverse = _mm256_set1_pd(inverse_resolution);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d last = _mm256_set1_pd(last_index);
+	__m256d nan_found = _mm256_setzero_pd();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d angle = _mm256_loadu_pd(angles + i);
+		nan_found = _mm256_or_pd(nan_found, _mm256_cmp_pd(angle, angle, _CMP_UNORD_Q));
+		__m256d index = _mm256_add_pd(_mm256_mul_pd(angle, inverse), half);
+		index = _mm256_min_pd(_mm256_max_pd(index, zero), last);
+		__m128i indices = _mm256_cvttpd_epi32(index);
+#if defined(__AVX2__)
+		//Versione con maschera (tutte le corsie attive) per non dipendere da un registro sorgente non inizializzato
+		__m256d gathered = _mm256_mask_i32gather_pd(zero, scan, indices, _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ), sizeof(double));
+		_mm256_storeu_pd(distances + i, gathered);
+#else
+		alignas(16) int lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), indices);
+		distances[i] = scan[lanes[0]];
+		distances[i + 1] = scan[lanes[1]];
+		distances[i + 2] = scan[lanes[2]];
+		distances[i + 3] = scan[lanes[3]];
+#endif
+	}
+	valid = _mm256_movemask_pd(nan_found) == 0;
+#endif
+
+	//Ciclo scalare per gli angoli rimanenti (o per tutti, se non sono disponibili istruzioni SIMD)
+	for (; i < count; i++)
+	{
+		double angle = angles[i];
+		if (isnan(angle))
+		{
+			valid = false;
+			distances[i] = scan[0];
+			continue;
+		}
+		distances[i] = scan[nearest_measurement_index(angle, inverse_resolution, last_index)];
+	}
+
+	return valid;
+}
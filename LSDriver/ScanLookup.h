@@ -0,0 +1,39 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+/*!
+ * @brief Calcola l'indice della misurazione più vicina all'angolo fornito, usando il reciproco della risoluzione angolare al posto della divisione.
+ * @details Angoli <= 0 ritornano 0, angoli oltre l'ultima misurazione ritornano last_index. angle non deve essere NaN
+ * @param angle un angolo
+ * @param inverse_resolution 1 / risoluzione angolare
+ * @param last_index indice dell'ultima misurazione della scansione
+ * @return L'indice della misurazione più vicina ad angle
+*/
+inline int nearest_measurement_index(double angle, double inverse_resolution, int last_index)
+{
+	//Arrotondamento con floor(x + 0.5), lo stesso usato dalla versione vettoriale in lookup_distances()
+	double index = angle * inverse_resolution + 0.5;
+	if (!(index > 0))
+		return 0;
+	if (index >= last_index)
+		return last_index;
+	return static_cast<int>(index);
+}
+
+/*!
+ * @brief Legge da scan le distanze corrispondenti a count angoli in un solo passaggio.
+ * @details La conversione angolo -> indice viene eseguita con istruzioni AVX (e gather AVX2) se il compilatore le abilita, altrimenti con un ciclo scalare.
+ * Il risultato è identico a quello di nearest_measurement_index() applicato ad ogni angolo
+ * @param scan scansione da cui leggere le distanze (last_index + 1 elementi)
+ * @param last_index indice dell'ultima misurazione della scansione
+ * @param inverse_resolution 1 / risoluzione angolare
+ * @param angles angoli richiesti
+ * @param distances destinazione delle distanze (almeno count elementi)
+ * @param count numero di angoli
+ * @return true se nessun angolo è NaN. Le distanze relative ad angoli NaN non sono significative
+*/
+bool lookup_distances(const double* scan, int last_index, double inverse_resolution, const double* angles, double* distances, int count);
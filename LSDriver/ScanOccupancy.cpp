@@ -0,0 +1,212 @@
+#include "ScanOccupancy.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+	//Log-odds (in virgola fissa) di una probabilità
+	int32_t fixed_log_odds(double probability)
+	{
+		return static_cast<int32_t>(lround(log(probability / (1 - probability)) * OccupancyGrid::kLogOddsScale));
+	}
+}
+
+OccupancyGrid::OccupancyGrid(double resolution, const OccupancyGridConfig& config) : angular_resolution_{ resolution }, measurements_{ 0 },
+	config_{ config }, tiles_x_{ 0 }, hit_{ 0 }, miss_{ 0 }, scans_{ 0 }
+{
+	measurements_ = TrigTable::for_resolution(resolution).measurements();
+
+	if (config.width < 1 || config.height < 1)
+		throw out_of_range("Grid size " + to_string(config.width) + "x" + to_string(config.height) + " invalid: must be at least 1x1");
+	if (isnan(config.cell_size) || config.cell_size <= 0)
+		throw out_of_range("Cell size " + to_string(config.cell_size) + " invalid: must be positive");
+	if (isnan(config.max_range) || config.max_range <= 0)
+		throw out_of_range("Maximum range " + to_string(config.max_range) + " invalid: must be positive");
+	if (isnan(config.hit_probability) || config.hit_probability <= 0.5 || config.hit_probability >= 1)
+		throw out_of_range("Hit probability " + to_string(config.hit_probability) + " invalid: must be in the range ( 0.5 , 1 )");
+	if (isnan(config.miss_probability) || config.miss_probability <= 0 || config.miss_probability >= 0.5)
+		throw out_of_range("Miss probability " + to_string(config.miss_probability) + " invalid: must be in the range ( 0 , 0.5 )");
+
+	//Probabilità troppo vicine a 0.5 darebbero contributi nulli in virgola fissa: la cella non cambierebbe mai
+	hit_ = max(fixed_log_odds(config.hit_probability), int32_t{ 1 });
+	miss_ = min(fixed_log_odds(config.miss_probability), int32_t{ -1 });
+
+	tiles_x_ = (config.width + kTileMask) >> kTileShift;
+	int tiles_y = (config.height + kTileMask) >> kTileShift;
+	cells_.assign(static_cast<size_t>(tiles_x_) * tiles_y * kTileSide * kTileSide, 0);
+	build_rays();
+}
+
+void OccupancyGrid::build_rays()
+{
+	const TrigTable& table = TrigTable::for_resolution(angular_resolution_);
+	double yaw = config_.mounting.yaw * numbers::pi / 180;
+	double cos_yaw = cos(yaw), sin_yaw = sin(yaw);
+
+	//Le coordinate dell'attraversamento sono in celle: il LIDAR si trova in (px, py) e la distanza percorsa lungo il raggio è t * cell_size
+	double px = config_.width / 2.0 + config_.mounting.x / config_.cell_size;
+	double py = config_.height / 2.0 + config_.mounting.y / config_.cell_size;
+	double range = config_.max_range / config_.cell_size;
+	constexpr double kInfinity = numeric_limits<double>::infinity();
+
+	ray_offsets_.assign(measurements_ + 1, 0);
+	ray_cells_.clear();
+	ray_exits_.clear();
+	for (int i = 0; i < measurements_; i++)
+	{
+		ray_offsets_[i] = static_cast<uint32_t>(ray_cells_.size());
+		double dx = table.cos()[i] * cos_yaw - table.sin()[i] * sin_yaw;
+		double dy = table.cos()[i] * sin_yaw + table.sin()[i] * cos_yaw;
+
+		//DDA (Amanatides-Woo): next_x e next_y sono i valori di t a cui il raggio attraversa il prossimo bordo verticale e orizzontale
+		int cx = static_cast<int>(floor(px)), cy = static_cast<int>(floor(py));
+		int step_x = dx > 0 ? 1 : -1, step_y = dy > 0 ? 1 : -1;
+		double delta_x = dx != 0 ? 1 / abs(dx) : kInfinity;
+		double delta_y = dy != 0 ? 1 / abs(dy) : kInfinity;
+		double next_x = dx > 0 ? (cx + 1 - px) * delta_x : dx < 0 ? (px - cx) * delta_x : kInfinity;
+		double next_y = dy > 0 ? (cy + 1 - py) * delta_y : dy < 0 ? (py - cy) * delta_y : kInfinity;
+
+		double entry = 0;
+		while (entry < range && cx >= 0 && cx < config_.width && cy >= 0 && cy < config_.height)
+		{
+			double exit = min(next_x, next_y);
+			ray_cells_.push_back(static_cast<uint32_t>(offset(cx, cy)));
+			ray_exits_.push_back(static_cast<float>(exit * config_.cell_size));
+			entry = exit;
+			if (next_x < next_y)
+			{
+				cx += step_x;
+				next_x += delta_x;
+			}
+			else
+			{
+				cy += step_y;
+				next_y += delta_y;
+			}
+		}
+	}
+	ray_offsets_[measurements_] = static_cast<uint32_t>(ray_cells_.size());
+	ray_cells_.shrink_to_fit();
+	ray_exits_.shrink_to_fit();
+}
+
+bool OccupancyGrid::compatible(const LaserScannerDriver& driver, span<const double> scan) const
+{
+	return driver.angular_resolution() == angular_resolution_ && static_cast<int>(scan.size()) == measurements_;
+}
+
+void OccupancyGrid::on_scan_committed(const LaserScannerDriver& driver, span<const double> scan)
+{
+	//Le callback non possono lanciare eccezioni: un driver incompatibile viene semplicemente ignorato (anche all'uscita delle sue scansioni)
+	if (!compatible(driver, scan))
+		return;
+
+	apply(scan, 1);
+	scans_++;
+}
+
+void OccupancyGrid::on_scan_evicted(const LaserScannerDriver& driver, span<const double> scan)
+{
+	if (!compatible(driver, scan) || scans_ == 0)
+		return;
+
+	apply(scan, -1);
+	scans_--;
+}
+
+void OccupancyGrid::on_buffer_replaced(const LaserScannerDriver& driver)
+{
+	if (driver.angular_resolution() == angular_resolution_)
+		rebuild(driver);
+	else
+		reset();
+}
+
+void OccupancyGrid::apply(span<const double> scan, int32_t sign)
+{
+	int32_t hit = sign * hit_, miss = sign * miss_;
+	float range = static_cast<float>(config_.max_range);
+	int32_t* cells = cells_.data();
+
+	for (int i = 0; i < measurements_; i++)
+	{
+		double distance = scan[i];
+		if (!(distance > 0))		//Vero anche per NaN
+			continue;
+
+		//Le celle da cui il raggio esce prima della misurazione sono libere, quella in cui termina è occupata (se la misurazione è entro max_range)
+		const uint32_t* ray = ray_cells_.data() + ray_offsets_[i];
+		const float* first = ray_exits_.data() + ray_offsets_[i];
+		const float* last = ray_exits_.data() + ray_offsets_[i + 1];
+		float clamped = min(static_cast<float>(distance), range);
+		const float* end = upper_bound(first, last, clamped);
+		size_t free_cells = end - first;
+		for (size_t k = 0; k < free_cells; k++)
+			cells[ray[k]] += miss;
+		if (end != last && distance < config_.max_range)
+			cells[ray[free_cells]] += hit;
+	}
+}
+
+void OccupancyGrid::rebuild(const LaserScannerDriver& driver)
+{
+	if (driver.angular_resolution() != angular_resolution_)
+		throw invalid_argument("The driver resolution differs from the grid resolution");
+
+	reset();
+	for (int i = 0; i < driver.size(); i++)
+		on_scan_committed(driver, driver.scan(i));
+}
+
+void OccupancyGrid::reset()
+{
+	fill(cells_.begin(), cells_.end(), 0);
+	scans_ = 0;
+}
+
+void OccupancyGrid::check_cell(int cx, int cy) const
+{
+	if (cx < 0 || cx >= config_.width || cy < 0 || cy >= config_.height)
+		throw out_of_range("Cell (" + to_string(cx) + ", " + to_string(cy) + ") out of the grid");
+}
+
+double OccupancyGrid::log_odds(int cx, int cy) const
+{
+	check_cell(cx, cy);
+	return static_cast<double>(cells_[offset(cx, cy)]) / kLogOddsScale;
+}
+
+double OccupancyGrid::probability(int cx, int cy) const
+{
+	return 1 - 1 / (1 + exp(log_odds(cx, cy)));
+}
+
+bool OccupancyGrid::cell(double x, double y, int& cx, int& cy) const
+{
+	double gx = floor(x / config_.cell_size + config_.width / 2.0);
+	double gy = floor(y / config_.cell_size + config_.height / 2.0);
+	//Il confronto in double esclude anche NaN e valori troppo grandi per un int
+	if (!(gx >= 0 && gx < config_.width && gy >= 0 && gy < config_.height))
+		return false;
+
+	cx = static_cast<int>(gx);
+	cy = static_cast<int>(gy);
+	return true;
+}
+
+void OccupancyGrid::copy_log_odds(span<float> dest) const
+{
+	if (dest.size() < static_cast<size_t>(config_.width) * config_.height)
+		throw invalid_argument("Destination too small for the grid");
+
+	//Si percorre la griglia riga per riga: le celle di una riga di un blocco sono contigue
+	for (int cy = 0; cy < config_.height; cy++)
+		for (int cx = 0; cx < config_.width; cx++)
+			dest[static_cast<size_t>(cy) * config_.width + cx] = static_cast<float>(cells_[offset(cx, cy)]) / kLogOddsScale;
+}
@@ -0,0 +1,157 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "LaserScannerDriver.h"
+#include "ScanGeometry.h"
+
+/*!
+ * @brief Dimensioni e modello del sensore di una OccupancyGrid
+*/
+struct OccupancyGridConfig
+{
+	int width = 200;				//Numero di celle lungo l'asse x del robot
+	int height = 200;				//Numero di celle lungo l'asse y del robot
+	double cell_size = 0.05;		//Lato di una cella (stessa unità di misura delle distanze)
+	double max_range = 8;			//Distanza oltre la quale una misurazione non indica un ostacolo: le celle attraversate vengono solo liberate
+	double hit_probability = 0.7;	//Probabilità che la cella colpita da una misurazione sia occupata, nel range (0.5 , 1)
+	double miss_probability = 0.4;	//Probabilità che una cella attraversata da una misurazione sia occupata, nel range (0 , 0.5)
+	MountingTransform mounting;		//Posizione del LIDAR rispetto al robot, che si trova al centro della griglia
+};
+
+// Griglia di occupazione in log-odds nel sistema di riferimento del robot, aggiornata ad ogni scansione inserita nel driver a cui è registrata
+// (add_observer()) e aggiornata in senso inverso ad ogni scansione che esce dal buffer: la griglia corrisponde sempre alle scansioni presenti nel
+// buffer, senza doverle estrarre con get_scan() e ricostruirla da capo. Ogni aggiornamento costa O(celle attraversate dai raggi della scansione).
+// La cella (0, 0) è quella con x e y minori: la cella (cx, cy) copre x in [(cx - width / 2) * cell_size , (cx + 1 - width / 2) * cell_size)
+// e analogamente per y. Le misurazioni NaN o non positive vengono ignorate.
+//
+// Invarianti:
+// - measurements_ è il numero di misurazioni di una scansione con risoluzione angular_resolution_
+// - ray_offsets_.size() == measurements_ + 1: le celle attraversate dal raggio i sono ray_cells_[ray_offsets_[i] , ray_offsets_[i + 1]),
+//   in ordine di distanza dal LIDAR, e ray_exits_[k] è la distanza a cui il raggio esce dalla cella ray_cells_[k]
+// - cells_[offset(cx, cy)] è la somma in virgola fissa (kLogOddsScale unità per log-odds) dei contributi delle scans_ scansioni presenti
+// - hit_ > 0 && miss_ < 0
+class OccupancyGrid : public LaserScannerDriver::ScanObserver
+{
+public:
+	/*!
+	 * @brief Unità in cui vengono accumulati i log-odds. Con 256 unità per log-odds gli accumulatori a 32 bit non possono traboccare
+	 * per finestre fino a qualche migliaio di scansioni anche nelle celle vicine al LIDAR, attraversate da tutti i raggi
+	*/
+	static constexpr int kLogOddsScale = 256;
+
+	/*!
+	 * @brief Crea la griglia, con tutte le celle a log-odds 0 (probabilità 0.5), e precalcola le celle attraversate da ogni raggio
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1] o se un parametro di config non è valido
+	*/
+	OccupancyGrid(double resolution, const OccupancyGridConfig& config = {});
+
+	/*!
+	 * @brief Aggiunge la scansione alla griglia. Le scansioni di driver con risoluzione diversa da quella della griglia vengono ignorate
+	*/
+	void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) override;
+	/*!
+	 * @brief Sottrae dalla griglia la scansione che esce dal buffer
+	*/
+	void on_scan_evicted(const LaserScannerDriver& driver, std::span<const double> scan) override;
+	/*!
+	 * @brief Ricostruisce la griglia dalle scansioni presenti nel driver dopo un assegnamento. Se il driver ha ora una risoluzione diversa
+	 * da quella della griglia, la griglia viene svuotata
+	*/
+	void on_buffer_replaced(const LaserScannerDriver& driver) override;
+
+	/*!
+	 * @brief Ricostruisce la griglia dalle scansioni presenti nel driver, ad esempio dopo essersi registrati su un driver che contiene già delle scansioni
+	 * @throws std::invalid_argument se il driver ha una risoluzione diversa da quella della griglia
+	*/
+	void rebuild(const LaserScannerDriver& driver);
+	/*!
+	 * @brief Riporta tutte le celle a log-odds 0
+	*/
+	void reset();
+
+	/*!
+	 * @brief Log-odds della cella (cx, cy)
+	 * @throws std::out_of_range se la cella non è nella griglia
+	*/
+	double log_odds(int cx, int cy) const;
+	/*!
+	 * @brief Probabilità che la cella (cx, cy) sia occupata
+	 * @throws std::out_of_range se la cella non è nella griglia
+	*/
+	double probability(int cx, int cy) const;
+	/*!
+	 * @brief Ritorna in cx, cy la cella che contiene il punto (x, y) del sistema di riferimento del robot
+	 * @return false se il punto è fuori dalla griglia (cx e cy non vengono modificati)
+	*/
+	bool cell(double x, double y, int& cx, int& cy) const;
+	/*!
+	 * @brief Copia i log-odds di tutte le celle in dest, riga per riga: dest[cy * width() + cx]
+	 * @throws std::invalid_argument se dest ha meno di width() * height() elementi
+	*/
+	void copy_log_odds(std::span<float> dest) const;
+
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int width() const { return config_.width; }
+	inline int height() const { return config_.height; }
+	inline double cell_size() const { return config_.cell_size; }
+	/*!
+	 * @brief Numero di scansioni di cui la griglia tiene conto
+	*/
+	inline int scans() const { return scans_; }
+	/*!
+	 * @brief Numero totale di celle attraversate dai raggi precalcolati, cioè il costo massimo di un aggiornamento
+	*/
+	inline std::size_t ray_cells() const { return ray_cells_.size(); }
+
+private:
+	//NOTA DI PROGETTAZIONE:
+	//Le celle sono memorizzate a blocchi di kTileSide x kTileSide (256 byte, 4 linee di cache) invece che riga per riga: un raggio che attraversa
+	//la griglia in diagonale o lungo y resta per più celle nello stesso blocco, mentre con la disposizione per righe ogni cella sarebbe su una
+	//linea di cache diversa. La disposizione è nascosta: ray_cells_ contiene direttamente gli offset e gli accessor li calcolano con offset()
+	static constexpr int kTileShift = 3;
+	static constexpr int kTileSide = 1 << kTileShift;
+	static constexpr int kTileMask = kTileSide - 1;
+
+	double angular_resolution_;
+	int measurements_;
+	OccupancyGridConfig config_;
+	int tiles_x_;					//Blocchi per riga
+	std::int32_t hit_;				//Contributo (in virgola fissa) della cella colpita
+	std::int32_t miss_;				//Contributo (in virgola fissa) di una cella attraversata
+	int scans_;
+	std::vector<std::int32_t> cells_;
+
+	//NOTA DI PROGETTAZIONE:
+	//I "modelli" dei raggi (celle attraversate e distanze di uscita) dipendono solo da risoluzione e geometria e vengono calcolati una volta nel
+	//costruttore con un attraversamento DDA. Un aggiornamento non calcola seni, coseni nè intersezioni: cerca con upper_bound la cella che contiene
+	//la misurazione e somma i contributi alle celle precedenti. I contributi sono interi, così sottrarre una scansione riporta le celle
+	//esattamente al valore precedente, senza errori di arrotondamento che si accumulano
+	std::vector<std::uint32_t> ray_offsets_;
+	std::vector<std::uint32_t> ray_cells_;
+	std::vector<float> ray_exits_;
+
+	inline std::size_t offset(int cx, int cy) const
+	{
+		return ((static_cast<std::size_t>(cy >> kTileShift) * tiles_x_ + (cx >> kTileShift)) << (2 * kTileShift)) + ((cy & kTileMask) << kTileShift) + (cx & kTileMask);
+	}
+	/*!
+	 * @throws std::out_of_range se la cella non è nella griglia
+	*/
+	void check_cell(int cx, int cy) const;
+	/*!
+	 * @brief Calcola le celle attraversate da ogni raggio fino a max_range o al bordo della griglia
+	*/
+	void build_rays();
+	/*!
+	 * @brief Somma (sign == 1) o sottrae (sign == -1) i contributi della scansione
+	*/
+	void apply(std::span<const double> scan, std::int32_t sign);
+	bool compatible(const LaserScannerDriver& driver, std::span<const double> scan) const;
+};
@@ -0,0 +1,109 @@
+#include "ScanQuantization.h"
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+void quantize(const double* src, float* dest, int count)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	//Due conversioni da 2 double producono 4 float, scritti con una sola store
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 low = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+		__m128 high = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+		_mm_storeu_ps(dest + i, _mm_movelh_ps(low, high));
+	}
+#endif
+	for (; i < count; i++)
+		dest[i] = static_cast<float>(src[i]);
+}
+
+void dequantize(const float* src, double* dest, int count)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 values = _mm_loadu_ps(src + i);
+		_mm_storeu_pd(dest + i, _mm_cvtps_pd(values));
+		_mm_storeu_pd(dest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(values, values)));
+	}
+#endif
+	for (; i < count; i++)
+		dest[i] = src[i];
+}
+
+void quantize(const double* src, uint16_t* dest, int count, double inverse_scale)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	//Stessi passi del ciclo scalare su 8 distanze alla volta. max() con NaN ritorna il secondo operando (0): il NaN viene poi sostituito con
+	//kFixed16Invalid tramite and/andnot. SSE2 non ha un pack a 16 bit senza segno: i valori vengono traslati di 32768 per usare quello con segno
+	const __m128d inverse = _mm_set1_pd(inverse_scale);
+	const __m128d half = _mm_set1_pd(0.5);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d maximum = _mm_set1_pd(kFixed16Max);
+	const __m128d invalid = _mm_set1_pd(kFixed16Invalid);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i unbias = _mm_set1_epi16(static_cast<short>(0x8000));
+	auto convert = [&](const double* p)
+	{
+		__m128d values = _mm_loadu_pd(p);
+		__m128d nan = _mm_cmpunord_pd(values, values);
+		__m128d scaled = _mm_min_pd(_mm_max_pd(_mm_add_pd(_mm_mul_pd(values, inverse), half), zero), maximum);
+		scaled = _mm_or_pd(_mm_and_pd(nan, invalid), _mm_andnot_pd(nan, scaled));
+		return _mm_cvttpd_epi32(scaled);	//2 interi a 32 bit nella metà bassa del registro
+	};
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i low = _mm_unpacklo_epi64(convert(src + i), convert(src + i + 2));
+		__m128i high = _mm_unpacklo_epi64(convert(src + i + 4), convert(src + i + 6));
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(packed, unbias));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		double value = src[i];
+		if (isnan(value))
+			dest[i] = kFixed16Invalid;
+		else
+		{
+			double scaled = value * inverse_scale + 0.5;
+			dest[i] = scaled >= kFixed16Max ? kFixed16Max : scaled > 0 ? static_cast<uint16_t>(scaled) : 0;
+		}
+	}
+}
+
+void dequantize(const uint16_t* src, double* dest, int count, double scale)
+{
+	const double nan = numeric_limits<double>::quiet_NaN();
+	int i = 0;
+#if defined(__SSE2__)
+	//I valori a 16 bit vengono estesi a 32 bit e convertiti 2 alla volta. La maschera dei valori kFixed16Invalid (32 bit per valore) viene
+	//duplicata per ottenere una maschera a 64 bit per ogni double
+	const __m128d factor = _mm_set1_pd(scale);
+	const __m128d nan_values = _mm_set1_pd(nan);
+	const __m128i invalid = _mm_set1_epi32(kFixed16Invalid);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)), zero);
+		__m128i is_invalid = _mm_cmpeq_epi32(values, invalid);
+		__m128d low = _mm_mul_pd(_mm_cvtepi32_pd(values), factor);
+		__m128d high = _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(values, values)), factor);
+		__m128d low_mask = _mm_castsi128_pd(_mm_unpacklo_epi32(is_invalid, is_invalid));
+		__m128d high_mask = _mm_castsi128_pd(_mm_unpackhi_epi32(is_invalid, is_invalid));
+		_mm_storeu_pd(dest + i, _mm_or_pd(_mm_and_pd(low_mask, nan_values), _mm_andnot_pd(low_mask, low)));
+		_mm_storeu_pd(dest + i + 2, _mm_or_pd(_mm_and_pd(high_mask, nan_values), _mm_andnot_pd(high_mask, high)));
+	}
+#endif
+	for (; i < count; i++)
+		dest[i] = src[i] == kFixed16Invalid ? nan : src[i] * scale;
+}
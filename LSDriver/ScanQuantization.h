@@ -0,0 +1,50 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/*!
+ * @brief Precisione con cui vengono memorizzate le misurazioni
+*/
+enum class StoragePrecision
+{
+	kDouble,	//8 byte per misurazione, nessuna perdita di precisione
+	kFloat,		//4 byte per misurazione, circa 7 cifre significative
+	kFixed16	//2 byte per misurazione: intero senza segno in multipli di una scala (ad esempio millimetri)
+};
+
+/*!
+ * @brief Valore riservato che rappresenta NaN nel formato kFixed16. Le distanze vengono saturate a kFixed16Max
+*/
+constexpr std::uint16_t kFixed16Invalid = 0xFFFF;
+constexpr std::uint16_t kFixed16Max = 0xFFFE;
+
+/*!
+ * @brief Numero di byte occupati da una misurazione memorizzata con la precisione fornita
+*/
+inline int storage_size(StoragePrecision precision)
+{
+	return precision == StoragePrecision::kDouble ? 8 : precision == StoragePrecision::kFloat ? 4 : 2;
+}
+
+//Conversioni tra double e i formati compatti. Usano istruzioni SSE2 se il compilatore le abilita, altrimenti un ciclo scalare.
+//Le misurazioni NaN restano NaN in entrambe le direzioni; le distanze devono essere già state validate (nessun valore negativo)
+
+/*!
+ * @brief Converte count distanze in float. Le distanze oltre il massimo di float diventano +infinito
+*/
+void quantize(const double* src, float* dest, int count);
+/*!
+ * @brief Converte count distanze in multipli di scale, arrotondando al più vicino e saturando a kFixed16Max. NaN diventa kFixed16Invalid
+ * @param inverse_scale 1 / scala
+*/
+void quantize(const double* src, std::uint16_t* dest, int count, double inverse_scale);
+void dequantize(const float* src, double* dest, int count);
+/*!
+ * @brief Converte count valori in distanze (valore * scale). kFixed16Invalid diventa NaN
+*/
+void dequantize(const std::uint16_t* src, double* dest, int count, double scale);
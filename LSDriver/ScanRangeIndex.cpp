@@ -0,0 +1,110 @@
+#include "ScanRangeIndex.h"
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+using namespace std;
+
+int ScanRangeIndex::level(int length)
+{
+	return bit_width(static_cast<unsigned>(length)) - 1;
+}
+
+void ScanRangeIndex::build(span<const double> scan)
+{
+	size_ = static_cast<int>(scan.size());
+	blocks_ = (size_ + kBlockSize - 1) / kBlockSize;
+	const double inf = numeric_limits<double>::infinity();
+	keys_min_.resize(size_);
+	keys_max_.resize(size_);
+	for (int i = 0; i < size_; i++)
+	{
+		keys_min_[i] = isnan(scan[i]) ? inf : scan[i];
+		keys_max_[i] = isnan(scan[i]) ? -inf : scan[i];
+	}
+
+	int levels = blocks_ > 0 ? level(blocks_) + 1 : 0;
+	min_.resize(static_cast<size_t>(levels) * blocks_);
+	max_.resize(static_cast<size_t>(levels) * blocks_);
+
+	//Livello 0: estremi di ogni blocco, con una sola passata sulle misurazioni
+	for (int b = 0; b < blocks_; b++)
+	{
+		int begin = b * kBlockSize;
+		int end = min(begin + kBlockSize, size_);
+		int minimum = begin, maximum = begin;
+		for (int i = begin + 1; i < end; i++)
+		{
+			if (keys_min_[i] < keys_min_[minimum])
+				minimum = i;
+			if (keys_max_[i] > keys_max_[maximum])
+				maximum = i;
+		}
+		min_[b] = minimum;
+		max_[b] = maximum;
+	}
+
+	//Livello k: l'estremo dei blocchi [b, b + 2^k) è il migliore tra quelli di [b, b + 2^(k-1)) e [b + 2^(k-1), b + 2^k), entrambi calcolati al livello k - 1
+	for (int k = 1; k < levels; k++)
+	{
+		int half = 1 << (k - 1);
+		const int* previous_min = min_.data() + (k - 1) * blocks_;
+		const int* previous_max = max_.data() + (k - 1) * blocks_;
+		int* current_min = min_.data() + k * blocks_;
+		int* current_max = max_.data() + k * blocks_;
+		for (int b = 0; b + (1 << k) <= blocks_; b++)
+		{
+			int left = previous_min[b], right = previous_min[b + half];
+			current_min[b] = keys_min_[right] < keys_min_[left] ? right : left;
+			left = previous_max[b];
+			right = previous_max[b + half];
+			current_max[b] = keys_max_[right] > keys_max_[left] ? right : left;
+		}
+	}
+}
+
+template <class Better>
+int ScanRangeIndex::query(const pmr::vector<double>& keys, const pmr::vector<int>& table, int blocks, int first, int last, Better better)
+{
+	//Gli indici vengono visitati in ordine crescente e sostituiti solo da chiavi strettamente migliori: a parità vince l'indice minore
+	int best = first;
+	int first_block = first / kBlockSize;
+	int last_block = last / kBlockSize;
+	if (last_block - first_block < 2)
+	{
+		//Nessun blocco intero nel mezzo: al più 2 * kBlockSize misurazioni
+		for (int i = first + 1; i <= last; i++)
+			if (better(keys[i], keys[best]))
+				best = i;
+		return best;
+	}
+
+	int head_end = (first_block + 1) * kBlockSize;
+	for (int i = first + 1; i < head_end; i++)
+		if (better(keys[i], keys[best]))
+			best = i;
+
+	int k = level(last_block - first_block - 1);
+	int left = table[k * blocks + first_block + 1];
+	int right = table[k * blocks + last_block - (1 << k)];
+	if (better(keys[left], keys[best]))
+		best = left;
+	if (better(keys[right], keys[best]))
+		best = right;
+
+	for (int i = last_block * kBlockSize; i <= last; i++)
+		if (better(keys[i], keys[best]))
+			best = i;
+	return best;
+}
+
+int ScanRangeIndex::argmin(int first, int last) const
+{
+	return query(keys_min_, min_, blocks_, first, last, less<double>());
+}
+
+int ScanRangeIndex::argmax(int first, int last) const
+{
+	return query(keys_max_, max_, blocks_, first, last, greater<double>());
+}
@@ -0,0 +1,67 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+// Indice per le interrogazioni di minimo e massimo su un intervallo di misurazioni di una scansione.
+// Le misurazioni sono divise in blocchi di kBlockSize: per ogni blocco vengono memorizzati minimo e massimo, e sui blocchi viene costruita una sparse table
+// (per ogni blocco i e livello k l'estremo dei blocchi [i, i + 2^k)). Un intervallo viene coperto dalle misurazioni dei blocchi parziali agli estremi,
+// lette direttamente, e dai blocchi interi nel mezzo, coperti da due righe (eventualmente sovrapposte) della sparse table. La sovrapposizione non
+// è un problema perchè minimo e massimo sono idempotenti.
+// La costruzione costa O(n) (la sparse table ha solo n / kBlockSize colonne) e ogni interrogazione O(kBlockSize), indipendentemente dall'ampiezza dell'intervallo.
+// Le misurazioni NaN (politica kMarkInvalid) non vengono mai scelte se l'intervallo contiene almeno una misurazione valida.
+//
+// Invarianti:
+// - keys_min_[i] è la misurazione i, +infinito se NaN; keys_max_[i] è la misurazione i, -infinito se NaN
+// - blocks_ == (size_ + kBlockSize - 1) / kBlockSize
+// - min_[k * blocks_ + b] (max_[k * blocks_ + b]) è l'indice del minimo (massimo) delle misurazioni dei blocchi [b, b + 2^k), per ogni b + 2^k <= blocks_.
+//   A parità di valore viene scelto l'indice minore
+class ScanRangeIndex
+{
+public:
+	/*!
+	 * @param resource risorsa da cui allocare l'indice (vedi LaserScannerDriver)
+	*/
+	explicit ScanRangeIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		: size_{ 0 }, blocks_{ 0 }, keys_min_(resource), keys_max_(resource), min_(resource), max_(resource) {}
+
+	/*!
+	 * @brief Costruisce l'indice per la scansione fornita, riutilizzando la memoria di una costruzione precedente
+	*/
+	void build(std::span<const double> scan);
+
+	/*!
+	 * @brief Indice della misurazione minima (massima) nell'intervallo chiuso [first, last], a parità di valore il minore. Se tutte le misurazioni
+	 * dell'intervallo sono NaN ritorna l'indice di una di esse. Richiede 0 <= first <= last < size()
+	*/
+	int argmin(int first, int last) const;
+	int argmax(int first, int last) const;
+
+	inline int size() const { return size_; }
+
+private:
+	static constexpr int kBlockSize = 16;
+
+	int size_;
+	int blocks_;
+	std::pmr::vector<double> keys_min_;
+	std::pmr::vector<double> keys_max_;
+	std::pmr::vector<int> min_;
+	std::pmr::vector<int> max_;
+
+	/*!
+	 * @brief Esponente della potenza di 2 più grande non superiore a length (length >= 1)
+	*/
+	static int level(int length);
+	/*!
+	 * @brief Interrogazione generica: Better(a, b) è vero se la chiave a è strettamente migliore di b
+	*/
+	template <class Better>
+	static int query(const std::pmr::vector<double>& keys, const std::pmr::vector<int>& table, int blocks, int first, int last, Better better);
+};
@@ -0,0 +1,280 @@
+#include "ScanSharedMemory.h"
+#include "ScanLookup.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <new>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	constexpr uint32_t kSegmentMagic = 0x5344534C;		//"LSDS"
+	constexpr uint32_t kSegmentVersion = 1;
+	constexpr size_t kCacheLineSize = 64;
+	constexpr int kDoublesPerCacheLine = kCacheLineSize / sizeof(double);
+
+	/*!
+	 * @brief Intestazione di uno slot del segmento, seguita dalle misurazioni. Il timestamp (nanosecondi di steady_clock, che su Linux è
+	 * CLOCK_MONOTONIC ed è quindi confrontabile tra processi diversi) è protetto dal contatore di sequenza come le misurazioni
+	*/
+	struct alignas(kCacheLineSize) SlotHeader
+	{
+		atomic<uint64_t> sequence{ 0 };
+		int64_t timestamp = 0;
+	};
+}
+
+//NOTA DI PROGETTAZIONE:
+//Il magic viene scritto per ultimo (release) dal pubblicatore: un lettore che apre il segmento durante l'inizializzazione lo trova a 0 e rifiuta il segmento.
+//published è su una linea di cache separata dai campi costanti, letti dai lettori solo all'apertura
+struct alignas(kCacheLineSize) SharedScanSegment
+{
+	atomic<uint32_t> magic{ 0 };
+	uint32_t version = 0;
+	double resolution = 0;
+	int32_t capacity = 0;
+	int32_t measurements = 0;
+
+	alignas(kCacheLineSize) atomic<uint64_t> published{ 0 };		//Numero di scansioni pubblicate: la più recente è la published - 1
+};
+
+static_assert(atomic<uint64_t>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free,
+	"The shared memory segment requires lock-free atomics, the only ones usable across processes");
+
+namespace
+{
+	inline int stride(int measurements) { return (measurements + kDoublesPerCacheLine - 1) / kDoublesPerCacheLine * kDoublesPerCacheLine; }
+	inline size_t slot_bytes(int measurements) { return sizeof(SlotHeader) + stride(measurements) * sizeof(double); }
+	inline size_t segment_bytes(int capacity, int measurements) { return sizeof(SharedScanSegment) + capacity * slot_bytes(measurements); }
+
+	/*!
+	 * @brief Intestazione dello slot della scansione index-esima. capacity e measurements sono quelli letti all'apertura, non quelli del segmento
+	*/
+	inline const SlotHeader* slot_header(const SharedScanSegment* segment, uint64_t index, int capacity, int measurements)
+	{
+		const char* slots = reinterpret_cast<const char*>(segment + 1);
+		return reinterpret_cast<const SlotHeader*>(slots + index % capacity * slot_bytes(measurements));
+	}
+	inline SlotHeader* slot_header(SharedScanSegment* segment, uint64_t index, int capacity, int measurements)
+	{
+		return const_cast<SlotHeader*>(slot_header(static_cast<const SharedScanSegment*>(segment), index, capacity, measurements));
+	}
+	inline const double* slot_values(const SlotHeader* header) { return reinterpret_cast<const double*>(header + 1); }
+	inline double* slot_values(SlotHeader* header) { return reinterpret_cast<double*>(header + 1); }
+
+	/*!
+	 * @brief Valore del contatore di sequenza dello slot quando contiene la scansione index completamente scritta (come in ConcurrentLaserScannerDriver)
+	*/
+	inline uint64_t committed_sequence(uint64_t index) { return 2 * index + 2; }
+}
+
+SharedScanPublisher::SharedScanPublisher(const string& name, double resolution, int capacity) : name_{ name }, angular_resolution_{ resolution },
+	capacity_{ capacity }, measurements_{ 0 }, segment_{ nullptr }, bytes_{ 0 }, published_{ 0 }, writing_{ false }
+{
+	measurements_ = measurement_count(resolution);
+	if (capacity < 2)
+		throw out_of_range("Shared buffer capacity " + to_string(capacity) + " invalid: must be at least 2");
+
+	bytes_ = segment_bytes(capacity_, measurements_);
+
+#ifdef _WIN32
+	throw runtime_error("Shared memory transport is not available on this platform");
+#else
+	//Un segmento con lo stesso nome è stato lasciato da un pubblicatore terminato senza distruttore: lo si sostituisce invece di riutilizzarlo,
+	//così i lettori che lo hanno ancora mappato non vedono mai cambiare il formato sotto di loro
+	shm_unlink(name_.c_str());
+	int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+		throw runtime_error("Cannot create the shared memory segment " + name_);
+	if (ftruncate(fd, static_cast<off_t>(bytes_)) < 0)		//Il segmento viene riempito di zeri
+	{
+		close(fd);
+		shm_unlink(name_.c_str());
+		throw runtime_error("Cannot resize the shared memory segment " + name_);
+	}
+	void* mapped = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);		//La mappatura resta valida anche dopo la chiusura del descrittore
+	if (mapped == MAP_FAILED)
+	{
+		shm_unlink(name_.c_str());
+		throw runtime_error("Cannot map the shared memory segment " + name_);
+	}
+
+	segment_ = new (mapped) SharedScanSegment;
+	segment_->version = kSegmentVersion;
+	segment_->resolution = angular_resolution_;
+	segment_->capacity = capacity_;
+	segment_->measurements = measurements_;
+	for (int i = 0; i < capacity_; i++)
+		new (slot_header(segment_, i, capacity_, measurements_)) SlotHeader;
+	segment_->magic.store(kSegmentMagic, memory_order_release);
+#endif
+}
+
+SharedScanPublisher::~SharedScanPublisher()
+{
+#ifndef _WIN32
+	munmap(segment_, bytes_);
+	shm_unlink(name_.c_str());
+#endif
+}
+
+void SharedScanPublisher::publish(span<const double> scan, Clock::time_point timestamp)
+{
+	span<double> dest = begin_write();
+	size_t min_size = min(scan.size(), dest.size());
+	copy_n(scan.begin(), min_size, dest.begin());
+	fill(dest.begin() + min_size, dest.end(), 0.0);
+	commit(timestamp);
+}
+
+span<double> SharedScanPublisher::begin_write()
+{
+	SlotHeader* header = slot_header(segment_, published_, capacity_, measurements_);
+	if (!writing_)
+	{
+		//Dal valore dispari in poi nessun lettore considera valida la scansione che occupava lo slot (scan() e valid() ritornano false)
+		header->sequence.store(committed_sequence(published_) - 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);		//La scrittura dei valori non può essere anticipata prima del valore dispari
+		writing_ = true;
+	}
+	return span<double>(slot_values(header), measurements_);
+}
+
+void SharedScanPublisher::commit(Clock::time_point timestamp)
+{
+	if (!writing_)
+		throw logic_error("commit() called without a write slot reserved by begin_write()");
+
+	SlotHeader* header = slot_header(segment_, published_, capacity_, measurements_);
+	header->timestamp = chrono::duration_cast<chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+	header->sequence.store(committed_sequence(published_), memory_order_release);
+	published_++;
+	segment_->published.store(published_, memory_order_release);
+	writing_ = false;
+}
+
+void SharedScanPublisher::on_scan_committed(const LaserScannerDriver& driver, span<const double> scan)
+{
+	if (driver.angular_resolution() != angular_resolution_)		//Scansione di un LIDAR diverso da quello del segmento: verrebbe troncata o completata con 0
+		return;
+	publish(scan, LaserScannerDriver::timestamp(scan));
+}
+
+SharedScanReader::SharedScanReader(const string& name) : angular_resolution_{ 0 }, capacity_{ 0 }, measurements_{ 0 }, segment_{ nullptr }, bytes_{ 0 }
+{
+#ifdef _WIN32
+	throw runtime_error("Shared memory transport is not available on this platform");
+#else
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		throw runtime_error("Shared memory segment " + name + " does not exist");
+
+	struct stat info;
+	if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(SharedScanSegment))
+	{
+		close(fd);
+		throw runtime_error("Shared memory segment " + name + " has not been initialized yet");
+	}
+	bytes_ = static_cast<size_t>(info.st_size);
+	void* mapped = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+		throw runtime_error("Cannot map the shared memory segment " + name);
+	segment_ = static_cast<const SharedScanSegment*>(mapped);
+
+	auto fail = [&](const string& message) {
+		munmap(const_cast<SharedScanSegment*>(segment_), bytes_);
+		throw runtime_error("Shared memory segment " + name + " " + message);
+	};
+	if (segment_->magic.load(memory_order_acquire) != kSegmentMagic)
+		fail("has not been initialized yet");
+	if (segment_->version != kSegmentVersion)
+		fail("has an unsupported version");
+
+	//I campi costanti vengono copiati e controllati una volta sola: nessun accesso successivo dipende da valori del segmento non verificati
+	angular_resolution_ = segment_->resolution;
+	capacity_ = segment_->capacity;
+	measurements_ = segment_->measurements;
+	if (isnan(angular_resolution_) || angular_resolution_ < 0.1 || angular_resolution_ > 1 || capacity_ < 2
+		|| measurements_ != evalute_measurement_index(LaserScannerDriver::kMaxAngle, angular_resolution_) + 1
+		|| bytes_ < segment_bytes(capacity_, measurements_))
+		fail("is not consistent");
+#endif
+}
+
+SharedScanReader::~SharedScanReader()
+{
+#ifndef _WIN32
+	munmap(const_cast<SharedScanSegment*>(segment_), bytes_);
+#endif
+}
+
+SharedScanReader::ScanView SharedScanReader::newest() const
+{
+	while (true)
+	{
+		uint64_t published = segment_->published.load(memory_order_acquire);
+		if (published == 0)
+			throw EmptyBufferException();
+
+		//Fallisce solo se il pubblicatore ha già pubblicato altre capacity_ - 1 scansioni e sta sovrascrivendo questa: si riprova con la nuova più recente
+		ScanView view;
+		if (scan(published - 1, view))
+			return view;
+	}
+}
+
+bool SharedScanReader::scan(uint64_t index, ScanView& view) const
+{
+	const SlotHeader* header = slot_header(segment_, index, capacity_, measurements_);
+	uint64_t before = header->sequence.load(memory_order_acquire);
+	if (before != committed_sequence(index))		//Non ancora pubblicata, già sovrascritta o in scrittura
+		return false;
+
+	int64_t timestamp = header->timestamp;
+
+	atomic_thread_fence(memory_order_acquire);
+	if (header->sequence.load(memory_order_relaxed) != before)
+		return false;
+
+	view.scan = span<const double>(slot_values(header), measurements_);
+	view.index = index;
+	view.timestamp = Clock::time_point(chrono::duration_cast<Clock::duration>(chrono::nanoseconds(timestamp)));
+	return true;
+}
+
+bool SharedScanReader::valid(const ScanView& view) const
+{
+	atomic_thread_fence(memory_order_acquire);		//Le letture dei valori della vista non possono essere posticipate dopo il controllo
+	return slot_header(segment_, view.index, capacity_, measurements_)->sequence.load(memory_order_relaxed) == committed_sequence(view.index);
+}
+
+double SharedScanReader::get_distance(double angle) const
+{
+	if (isnan(angle))
+		throw invalid_argument("The given angle is Not A Number (NaN)");
+
+	int measurement_index = nearest_measurement_index(angle, 1 / angular_resolution_, measurements_ - 1);
+	while (true)
+	{
+		ScanView view = newest();
+		double distance = view.scan[measurement_index];
+		if (valid(view))
+			return distance;
+	}
+}
+
+uint64_t SharedScanReader::published() const
+{
+	return segment_->published.load(memory_order_acquire);
+}
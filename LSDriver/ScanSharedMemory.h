@@ -0,0 +1,169 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include "LaserScannerDriver.h"
+
+//NOTA DI PROGETTAZIONE:
+//Il trasporto verso altri processi della stessa macchina usa un segmento di memoria condivisa POSIX (shm_open + mmap) con nome, che contiene
+//un buffer circolare di scansioni con lo stesso protocollo seqlock di ConcurrentLaserScannerDriver: la scansione n-esima pubblicata risiede nello
+//slot n % capacity, il cui contatore di sequenza vale 2 * n + 2 quando è completamente scritta (dispari durante la scrittura).
+//Il buffer di LaserScannerDriver non può vivere direttamente nel segmento (gli slot sono puntatori condivisi copy-on-write allocati da una
+//std::pmr::memory_resource del processo): SharedScanPublisher è un osservatore che ne replica ogni scansione inserita nel segmento con una sola
+//copia, mentre i lettori leggono le misurazioni direttamente dal segmento, senza copie nè chiamate di sistema dopo l'apertura.
+//Il segmento contiene solo tipi a dimensione fissa e atomici lock-free, per cui può essere condiviso tra processi compilati separatamente
+//purchè con lo stesso formato dei double e la stessa endianness. Non disponibile su Windows
+struct SharedScanSegment;
+
+// Pubblicatore delle scansioni in un segmento di memoria condivisa. Le scansioni vengono pubblicate con publish(), scritte direttamente nel
+// segmento con begin_write() e commit(), oppure replicate da un LaserScannerDriver registrando il pubblicatore con add_observer().
+// Un solo thread alla volta può pubblicare; i lettori (SharedScanReader, anche in altri processi) non bloccano mai il pubblicatore.
+//
+// Invarianti:
+// - capacity_ >= 2: la scansione più recente non è mai lo slot in scrittura, per cui i lettori non attendono mai il pubblicatore
+// - measurements_ == evalute_measurement_index(kMaxAngle, angular_resolution_) + 1
+// - segment_ punta ad un segmento di bytes_ byte mappato in lettura e scrittura, con published_ scansioni pubblicate
+// - writing_ implica che lo slot published_ % capacity_ sia in scrittura (contatore di sequenza dispari)
+class SharedScanPublisher : public LaserScannerDriver::ScanObserver
+{
+public:
+	using Clock = LaserScannerDriver::Clock;
+
+	/*!
+	 * @brief Crea il segmento di memoria condivisa con nome name (ad esempio "/lsdriver"). Un segmento con lo stesso nome lasciato da un
+	 * pubblicatore precedente viene sostituito: i lettori che lo hanno già aperto continuano a vedere quello vecchio e vanno riaperti
+	 * @param resolution risoluzione angolare delle scansioni pubblicate
+	 * @param capacity numero di scansioni mantenute nel segmento: un lettore ha circa capacity - 1 pubblicazioni di tempo per leggere una scansione
+	 * @throws std::out_of_range se resolution non è nel range [0.1 , 1] o se capacity < 2
+	 * @throws std::runtime_error se il segmento non può essere creato o mappato
+	*/
+	SharedScanPublisher(const std::string& name, double resolution = 1, int capacity = 4);
+	/*!
+	 * @brief Rimuove il nome del segmento e rilascia la mappatura. I lettori già aperti possono continuare a leggere le scansioni pubblicate
+	*/
+	~SharedScanPublisher();
+	SharedScanPublisher(const SharedScanPublisher&) = delete;
+	SharedScanPublisher& operator=(const SharedScanPublisher&) = delete;
+
+	/*!
+	 * @brief Pubblica una copia della scansione fornita, come LaserScannerDriver::new_scan(): se contiene meno di measurements() misurazioni
+	 * le restanti valgono 0, quelle in eccesso vengono ignorate. Le misurazioni non vengono validate
+	 * @details Annulla un'eventuale scrittura iniziata con begin_write() e non ancora pubblicata
+	*/
+	void publish(std::span<const double> scan, Clock::time_point timestamp = Clock::now());
+	/*!
+	 * @brief Riserva lo slot della prossima scansione e ne ritorna le misurazioni, da scrivere direttamente nel segmento prima di commit().
+	 * Chiamato di nuovo prima di commit() ritorna lo stesso slot
+	*/
+	std::span<double> begin_write();
+	/*!
+	 * @brief Pubblica la scansione scritta nello slot ritornato da begin_write()
+	 * @throws std::logic_error se non c'è una scrittura in corso
+	*/
+	void commit(Clock::time_point timestamp = Clock::now());
+
+	/*!
+	 * @brief Pubblica la scansione appena inserita nel driver, con il suo istante di acquisizione. Le scansioni di driver con una risoluzione
+	 * diversa da quella del segmento vengono ignorate
+	*/
+	void on_scan_committed(const LaserScannerDriver& driver, std::span<const double> scan) override;
+
+	inline const std::string& name() const { return name_; }
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int capacity() const { return capacity_; }
+	inline int measurements() const { return measurements_; }
+	/*!
+	 * @brief Numero di scansioni pubblicate dalla creazione del segmento
+	*/
+	inline std::uint64_t published() const { return published_; }
+
+private:
+	std::string name_;
+	double angular_resolution_;
+	int capacity_;
+	int measurements_;
+	SharedScanSegment* segment_;
+	std::size_t bytes_;
+	std::uint64_t published_;		//Copia locale del contatore del segmento, modificato solo da questo oggetto
+	bool writing_;
+};
+
+// Lettore delle scansioni pubblicate da uno SharedScanPublisher, anche in un altro processo. Il segmento viene mappato in sola lettura:
+// le viste ritornate puntano direttamente nel segmento e non copiano nulla. Il pubblicatore può sovrascrivere una scansione in ogni momento
+// (dopo capacity() - 1 nuove pubblicazioni), per cui chi legge una vista deve controllare con valid(), dopo averla letta, che i valori letti
+// fossero ancora quelli della scansione (come il consumatore di ConcurrentLaserScannerDriver). Più thread possono usare lo stesso lettore.
+//
+// Invarianti:
+// - segment_ punta ad un segmento di bytes_ byte mappato in sola lettura e inizializzato completamente dal pubblicatore
+class SharedScanReader
+{
+public:
+	using Clock = LaserScannerDriver::Clock;
+	using EmptyBufferException = LaserScannerDriver::EmptyBufferException;
+
+	/*!
+	 * @brief Vista di una scansione pubblicata: le misurazioni restano nel segmento. Valida finchè il lettore è in vita e valid() ritorna true
+	*/
+	struct ScanView
+	{
+		std::span<const double> scan;
+		std::uint64_t index = 0;		//Numero progressivo della scansione (a partire da 0)
+		Clock::time_point timestamp{};
+	};
+
+	/*!
+	 * @brief Apre e mappa in sola lettura il segmento creato da uno SharedScanPublisher con lo stesso nome
+	 * @throws std::runtime_error se il segmento non esiste, non è ancora stato inizializzato o non ha il formato atteso
+	*/
+	explicit SharedScanReader(const std::string& name);
+	/*!
+	 * @brief Rilascia la mappatura del segmento. Le viste ritornate non sono più valide
+	*/
+	~SharedScanReader();
+	SharedScanReader(const SharedScanReader&) = delete;
+	SharedScanReader& operator=(const SharedScanReader&) = delete;
+
+	/*!
+	 * @brief Ritorna la vista della scansione pubblicata più di recente
+	 * @throws EmptyBufferException se non è ancora stata pubblicata alcuna scansione
+	*/
+	ScanView newest() const;
+	/*!
+	 * @brief Scrive in view la vista della scansione index-esima, per i lettori che non vogliono perdere scansioni (ad esempio un registratore)
+	 * @return false se la scansione non è ancora stata pubblicata o è già stata sovrascritta (view non viene modificata)
+	*/
+	bool scan(std::uint64_t index, ScanView& view) const;
+	/*!
+	 * @brief Vero se la scansione della vista non è stata sovrascritta: i valori letti dalla vista prima della chiamata sono consistenti.
+	 * Dopo un risultato false i valori letti vanno scartati
+	*/
+	bool valid(const ScanView& view) const;
+	/*!
+	 * @brief Ritorna la distanza della scansione più recente all'angolo fornito, approssimando al valore più vicino come LaserScannerDriver::get_distance()
+	 * @throws EmptyBufferException se non è ancora stata pubblicata alcuna scansione
+	 * @throws std::invalid_argument se angle è NaN
+	*/
+	double get_distance(double angle) const;
+
+	inline double angular_resolution() const { return angular_resolution_; }
+	inline int capacity() const { return capacity_; }
+	inline int measurements() const { return measurements_; }
+	/*!
+	 * @brief Numero di scansioni pubblicate finora. È solo un'istantanea: può cambiare subito dopo essere stato letto
+	*/
+	std::uint64_t published() const;
+
+private:
+	double angular_resolution_;
+	int capacity_;
+	int measurements_;
+	const SharedScanSegment* segment_;
+	std::size_t bytes_;
+};
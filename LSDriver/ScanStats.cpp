@@ -0,0 +1,87 @@
+#include "ScanStats.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+using namespace std;
+
+uint64_t LatencyHistogram::percentile(double percentile) const
+{
+	if (samples == 0)
+		return 0;
+
+	//Numero di misure che devono essere <= del valore ritornato
+	uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(clamp(percentile, 0.0, 100.0) / 100 * samples)));
+	uint64_t seen = 0;
+	for (int i = 0; i < kBuckets; i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return i == 0 ? 0 : (uint64_t{ 1 } << i) - 1;
+	}
+	return (uint64_t{ 1 } << (kBuckets - 1)) - 1;
+}
+
+#if defined(LSDRIVER_DISABLE_STATS)
+
+DriverStats ScanStatsCounters::snapshot() const
+{
+	return DriverStats();
+}
+
+void ScanStatsCounters::reset()
+{
+}
+
+#else
+
+void ScanStatsCounters::record(Operation operation, uint64_t ns)
+{
+	Histogram& histogram = histograms_[operation];
+	int bucket = min(static_cast<int>(bit_width(ns)), LatencyHistogram::kBuckets - 1);
+	add<uint64_t>(histogram.buckets[bucket], 1);
+	add<uint64_t>(histogram.samples, 1);
+	add<uint64_t>(histogram.total_ns, ns);
+}
+
+DriverStats ScanStatsCounters::snapshot() const
+{
+	DriverStats stats;
+	stats.scans_committed = committed_.load(memory_order_relaxed);
+	stats.scans_overwritten = overwritten_.load(memory_order_relaxed);
+	stats.scans_rejected = rejected_.load(memory_order_relaxed);
+	stats.invalid_measurements = invalid_.load(memory_order_relaxed);
+	stats.peak_occupancy = peak_occupancy_.load(memory_order_relaxed);
+
+	LatencyHistogram* destinations[kOperations] = { &stats.new_scan, &stats.get_scan, &stats.get_distance };
+	for (int op = 0; op < kOperations; op++)
+	{
+		const Histogram& source = histograms_[op];
+		LatencyHistogram& destination = *destinations[op];
+		for (int i = 0; i < LatencyHistogram::kBuckets; i++)
+			destination.buckets[i] = source.buckets[i].load(memory_order_relaxed);
+		destination.samples = source.samples.load(memory_order_relaxed);
+		destination.total_ns = source.total_ns.load(memory_order_relaxed);
+	}
+	return stats;
+}
+
+void ScanStatsCounters::reset()
+{
+	//Chiamato dal thread proprietario del driver, come tutti gli aggiornamenti
+	committed_.store(0, memory_order_relaxed);
+	overwritten_.store(0, memory_order_relaxed);
+	rejected_.store(0, memory_order_relaxed);
+	invalid_.store(0, memory_order_relaxed);
+	peak_occupancy_.store(0, memory_order_relaxed);
+	for (Histogram& histogram : histograms_)
+	{
+		histogram.calls.store(0, memory_order_relaxed);
+		for (atomic<uint64_t>& bucket : histogram.buckets)
+			bucket.store(0, memory_order_relaxed);
+		histogram.samples.store(0, memory_order_relaxed);
+		histogram.total_ns.store(0, memory_order_relaxed);
+	}
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//NOTA DI PROGETTAZIONE:
+//La strumentazione è attiva di default e viene eliminata del tutto definendo LSDRIVER_DISABLE_STATS (opzione CMake LSDRIVER_STATS=OFF):
+//in tal caso ScanStatsCounters è vuota, i suoi metodi non fanno nulla e stats() ritorna sempre un'istantanea vuota.
+//La macro va definita allo stesso modo per tutte le unità di compilazione, perchè cambia la dimensione di LaserScannerDriver
+#if defined(LSDRIVER_DISABLE_STATS)
+constexpr bool kStatsEnabled = false;
+#else
+constexpr bool kStatsEnabled = true;
+#endif
+
+/*!
+ * @brief Istogramma delle latenze di un'operazione. Il bucket i contiene le misure in [2^(i-1), 2^i) ns (il bucket 0 le misure di 0 ns,
+ * l'ultimo anche tutte quelle più lunghe)
+*/
+struct LatencyHistogram
+{
+	static constexpr int kBuckets = 32;
+
+	std::array<std::uint64_t, kBuckets> buckets{};
+	std::uint64_t samples = 0;		//Misure registrate (una ogni kLatencySampleInterval chiamate)
+	std::uint64_t total_ns = 0;		//Somma delle misure
+
+	/*!
+	 * @brief Limite superiore (in ns) del bucket che contiene il percentile fornito, 0 se non ci sono misure
+	 * @param percentile nel range [0 , 100]
+	*/
+	std::uint64_t percentile(double percentile) const;
+	inline double mean_ns() const { return samples > 0 ? static_cast<double>(total_ns) / samples : 0; }
+};
+
+/*!
+ * @brief Istantanea delle statistiche di un LaserScannerDriver. I contatori partono da 0 alla costruzione (anche di una copia) e a ogni reset_stats()
+*/
+struct DriverStats
+{
+	std::uint64_t scans_committed = 0;		//Scansioni inserite con new_scan() o commit()
+	std::uint64_t scans_overwritten = 0;	//Scansioni scartate senza essere lette perchè il buffer era pieno
+	std::uint64_t scans_rejected = 0;		//Scansioni rifiutate (politica kThrow) perchè contenevano misurazioni non valide
+	std::uint64_t invalid_measurements = 0;	//Misurazioni non valide sostituite (politiche kClampToZero e kMarkInvalid)
+	int peak_occupancy = 0;					//Numero massimo di scansioni presenti contemporaneamente nel buffer
+	LatencyHistogram new_scan;				//Latenze di new_scan() e commit()
+	LatencyHistogram get_scan;				//Latenze di get_scan()
+	LatencyHistogram get_distance;			//Latenze di get_distance()
+};
+
+// Contatori aggiornati dal driver nei percorsi critici.
+// Ogni contatore ha un solo thread che scrive (il proprietario del driver): gli aggiornamenti sono un load e uno store relaxed, senza istruzioni
+// atomiche read-modify-write, e il thread che chiama snapshot() legge i valori senza mai bloccare il produttore. L'istantanea non è atomica
+// nel suo insieme (i contatori vengono letti uno alla volta). get_distance() è const e può essere chiamato da più thread: in quel caso
+// alcuni conteggi delle sue latenze possono andare persi, senza altri effetti.
+// Le latenze vengono misurate solo una volta ogni kLatencySampleInterval chiamate: leggere l'orologio costa più di get_distance() stesso.
+//
+// Invarianti:
+// - per ogni istogramma samples è la somma dei bucket (a meno di aggiornamenti in corso)
+class ScanStatsCounters
+{
+public:
+	static constexpr std::uint32_t kLatencySampleInterval = 64;
+
+	enum Operation { kNewScan, kGetScan, kGetDistance, kOperations };
+
+	/*!
+	 * @brief Misura la durata di un'operazione dalla costruzione alla distruzione, se è la chiamata campionata
+	*/
+	class ScopedLatency
+	{
+	public:
+		ScopedLatency(ScanStatsCounters& counters, Operation operation);
+		~ScopedLatency();
+		ScopedLatency(const ScopedLatency&) = delete;
+		ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+	private:
+#if !defined(LSDRIVER_DISABLE_STATS)
+		ScanStatsCounters* counters_;	//nullptr se questa chiamata non viene misurata
+		Operation operation_;
+		std::chrono::steady_clock::time_point start_;
+#endif
+	};
+
+	ScanStatsCounters() = default;
+	//I contatori appartengono al singolo driver: copie e spostamenti partono da zero
+	ScanStatsCounters(const ScanStatsCounters&) {}
+	ScanStatsCounters& operator=(const ScanStatsCounters&) { return *this; }
+
+	inline void committed(int occupancy, int invalid_measurements);
+	inline void overwritten();
+	inline void rejected();
+
+	DriverStats snapshot() const;
+	void reset();
+
+private:
+#if !defined(LSDRIVER_DISABLE_STATS)
+	struct Histogram
+	{
+		std::atomic<std::uint32_t> calls{ 0 };
+		std::array<std::atomic<std::uint64_t>, LatencyHistogram::kBuckets> buckets{};
+		std::atomic<std::uint64_t> samples{ 0 }, total_ns{ 0 };
+	};
+
+	std::atomic<std::uint64_t> committed_{ 0 }, overwritten_{ 0 }, rejected_{ 0 }, invalid_{ 0 };
+	std::atomic<int> peak_occupancy_{ 0 };
+	std::array<Histogram, kOperations> histograms_;
+
+	/*!
+	 * @brief Incremento da parte dell'unico thread che scrive il contatore: load e store relaxed
+	*/
+	template <class T>
+	static inline void add(std::atomic<T>& counter, T value) { counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+	void record(Operation operation, std::uint64_t ns);
+#endif
+};
+
+#if defined(LSDRIVER_DISABLE_STATS)
+
+inline ScanStatsCounters::ScopedLatency::ScopedLatency(ScanStatsCounters&, Operation) {}
+inline ScanStatsCounters::ScopedLatency::~ScopedLatency() {}
+inline void ScanStatsCounters::committed(int, int) {}
+inline void ScanStatsCounters::overwritten() {}
+inline void ScanStatsCounters::rejected() {}
+
+#else
+
+inline ScanStatsCounters::ScopedLatency::ScopedLatency(ScanStatsCounters& counters, Operation operation) : counters_{ nullptr }, operation_{ operation }
+{
+	std::atomic<std::uint32_t>& calls = counters.histograms_[operation].calls;
+	std::uint32_t call = calls.load(std::memory_order_relaxed);
+	calls.store(call + 1, std::memory_order_relaxed);
+	if (call % kLatencySampleInterval == 0)
+	{
+		counters_ = &counters;
+		start_ = std::chrono::steady_clock::now();
+	}
+}
+
+inline ScanStatsCounters::ScopedLatency::~ScopedLatency()
+{
+	//Anche le operazioni terminate con un'eccezione vengono misurate
+	if (counters_)
+		counters_->record(operation_, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count()));
+}
+
+inline void ScanStatsCounters::committed(int occupancy, int invalid_measurements)
+{
+	add<std::uint64_t>(committed_, 1);
+	if (invalid_measurements > 0)
+		add<std::uint64_t>(invalid_, invalid_measurements);
+	if (occupancy > peak_occupancy_.load(std::memory_order_relaxed))
+		peak_occupancy_.store(occupancy, std::memory_order_relaxed);
+}
+
+inline void ScanStatsCounters::overwritten() { add<std::uint64_t>(overwritten_, 1); }
+inline void ScanStatsCounters::rejected() { add<std::uint64_t>(rejected_, 1); }
+
+#endif
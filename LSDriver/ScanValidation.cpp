@@ -0,0 +1,99 @@
+#include "ScanValidation.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//NOTA DI PROGETTAZIONE:
+//Una misurazione è non valida se NaN o negativa. I due casi vengono contati separatamente solo per poter mantenere i messaggi d'errore di new_scan().
+//Il ciclo non ha salti condizionali dipendenti dai dati: una scansione con molti valori non validi costa quanto una scansione corretta,
+//e con le politiche diverse da kThrow non viene mai lanciata un'eccezione.
+//Nei cicli vettoriali i contatori restano nei registri: ogni maschera di confronto (tutti 1 se vero) viene trasformata in 1.0 con un and e sommata.
+//Contare i bit della maschera con popcount() richiederebbe l'istruzione POPCNT, che senza -mpopcnt viene emulata via software ad ogni iterazione
+ValidationResult copy_validated(const double* src, double* dest, int count, InvalidValuePolicy policy)
+{
+	ValidationResult result;
+	const bool replace = policy != InvalidValuePolicy::kThrow;
+	const double replacement = policy == InvalidValuePolicy::kMarkInvalid ? numeric_limits<double>::quiet_NaN() : 0.0;
+	int i = 0;
+
+#if defined(__AVX__)
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d substitute = _mm256_set1_pd(replacement);
+	const __m256d one = _mm256_set1_pd(1);
+	__m256d nan_counts = _mm256_setzero_pd();
+	__m256d negative_counts = _mm256_setzero_pd();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256d values = _mm256_loadu_pd(src + i);
+		__m256d nan = _mm256_cmp_pd(values, values, _CMP_UNORD_Q);
+		__m256d negative = _mm256_cmp_pd(values, zero, _CMP_LT_OQ);
+		nan_counts = _mm256_add_pd(nan_counts, _mm256_and_pd(nan, one));
+		negative_counts = _mm256_add_pd(negative_counts, _mm256_and_pd(negative, one));
+		if (replace)
+			values = _mm256_blendv_pd(values, substitute, _mm256_or_pd(nan, negative));
+		_mm256_storeu_pd(dest + i, values);
+	}
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, nan_counts);
+	result.nan_count = static_cast<int>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	_mm256_store_pd(lanes, negative_counts);
+	result.negative_count = static_cast<int>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d substitute = _mm_set1_pd(replacement);
+	const __m128d one = _mm_set1_pd(1);
+	__m128d nan_counts = _mm_setzero_pd();
+	__m128d negative_counts = _mm_setzero_pd();
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128d values = _mm_loadu_pd(src + i);
+		__m128d nan = _mm_cmpunord_pd(values, values);
+		__m128d negative = _mm_cmplt_pd(values, zero);
+		nan_counts = _mm_add_pd(nan_counts, _mm_and_pd(nan, one));
+		negative_counts = _mm_add_pd(negative_counts, _mm_and_pd(negative, one));
+		if (replace)
+		{
+			__m128d invalid = _mm_or_pd(nan, negative);	//SSE2 non ha blendv: seleziono con and/andnot
+			values = _mm_or_pd(_mm_and_pd(invalid, substitute), _mm_andnot_pd(invalid, values));
+		}
+		_mm_storeu_pd(dest + i, values);
+	}
+	alignas(16) double lanes[2];
+	_mm_store_pd(lanes, nan_counts);
+	result.nan_count = static_cast<int>(lanes[0] + lanes[1]);
+	_mm_store_pd(lanes, negative_counts);
+	result.negative_count = static_cast<int>(lanes[0] + lanes[1]);
+#endif
+
+	//Ciclo scalare per le misurazioni rimanenti (o per tutte, se non sono disponibili istruzioni SIMD)
+	for (; i < count; i++)
+	{
+		double element = src[i];
+		bool nan = isnan(element);
+		bool negative = element < 0;
+		result.nan_count += nan;
+		result.negative_count += negative;
+		dest[i] = replace && (nan || negative) ? replacement : element;
+	}
+
+	check_validation(result, policy);
+	return result;
+}
+
+void check_validation(const ValidationResult& result, InvalidValuePolicy policy)
+{
+	//Se viene passato un NaN o un numero negativo con la politica kThrow avviso l'utente: il LIDAR ha dei problemi nell'effettuare delle misurazioni
+	if (policy == InvalidValuePolicy::kThrow)
+	{
+		if (result.nan_count > 0)
+			throw invalid_argument("Check your LIDAR! You are passing a value which is Not A Number (NaN)");
+		if (result.negative_count > 0)
+			throw invalid_argument("Check your LIDAR! You are passing a negative distance");
+	}
+}
@@ -0,0 +1,95 @@
+/*!
+*  @author Formaggio Alberto
+*  @date 3/12/2020
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/*!
+ * @brief Comportamento da adottare quando una scansione contiene misurazioni non valide (NaN o distanze negative)
+*/
+enum class InvalidValuePolicy
+{
+	kThrow,				//Viene lanciata std::invalid_argument e la scansione non viene inserita (comportamento storico di new_scan())
+	kClampToZero,		//Le misurazioni non valide vengono sostituite con 0
+	kMarkInvalid		//Le misurazioni non valide vengono sostituite con NaN, così che il consumatore le possa riconoscere
+};
+
+/*!
+ * @brief Esito della validazione di una scansione
+*/
+struct ValidationResult
+{
+	int nan_count = 0;			//Numero di misurazioni NaN trovate
+	int negative_count = 0;		//Numero di misurazioni negative trovate
+
+	inline int invalid_count() const { return nan_count + negative_count; }
+};
+
+/*!
+ * @brief Copia count misurazioni da src a dest validandole in un solo passaggio, applicando policy a quelle non valide.
+ * @details Usa istruzioni AVX o SSE2 se il compilatore le abilita, altrimenti un ciclo scalare. src e dest possono coincidere (validazione sul posto).
+ * Con kThrow i valori vengono copiati così come sono e l'eccezione viene lanciata solo al termine della copia: dest va quindi considerato non significativo
+ * @param src misurazioni da validare
+ * @param dest destinazione delle misurazioni (almeno count elementi)
+ * @param count numero di misurazioni
+ * @param policy comportamento in presenza di misurazioni non valide
+ * @return il numero di misurazioni NaN e negative trovate (e sostituite, se policy != kThrow)
+ * @throws std::invalid_argument se policy == kThrow e almeno una misurazione non è valida
+*/
+ValidationResult copy_validated(const double* src, double* dest, int count, InvalidValuePolicy policy);
+/*!
+ * @brief Lancia l'eccezione di copy_validated() se policy == kThrow e result contiene misurazioni non valide
+ * @throws std::invalid_argument in tal caso
+*/
+void check_validation(const ValidationResult& result, InvalidValuePolicy policy);
+
+/*!
+ * @brief Versione di copy_validated() per un numero di misurazioni noto in compilazione (BasicLaserScannerDriver). Stesso risultato e stesse eccezioni
+ * @details Con AVX il ciclo è inline e ha un numero di iterazioni costante, senza salti dipendenti dai dati: il compilatore lo srotola e lo vettorizza
+ * (con prestazioni pari o migliori della versione scritta a mano). Con il solo SSE2 il compilatore non vettorizza il conteggio dei confronti tra double, e viene usata
+ * la versione scritta a mano di copy_validated()
+*/
+template <int Count>
+inline ValidationResult copy_validated(const double* src, double* dest, InvalidValuePolicy policy)
+{
+#if defined(__AVX__)
+	//Contatori a 64 bit, larghi quanto un double: il vettorizzatore somma direttamente le maschere dei confronti
+	std::int64_t nan_count = 0;
+	std::int64_t negative_count = 0;
+	if (policy == InvalidValuePolicy::kThrow)
+	{
+		for (int i = 0; i < Count; i++)
+		{
+			double element = src[i];
+			nan_count += std::isnan(element);
+			negative_count += element < 0;
+			dest[i] = element;
+		}
+	}
+	else
+	{
+		const double replacement = policy == InvalidValuePolicy::kMarkInvalid ? std::numeric_limits<double>::quiet_NaN() : 0.0;
+		for (int i = 0; i < Count; i++)
+		{
+			double element = src[i];
+			bool nan = std::isnan(element);
+			bool negative = element < 0;
+			nan_count += nan;
+			negative_count += negative;
+			dest[i] = nan || negative ? replacement : element;
+		}
+	}
+	ValidationResult result;
+	result.nan_count = static_cast<int>(nan_count);
+	result.negative_count = static_cast<int>(negative_count);
+	check_validation(result, policy);
+	return result;
+#else
+	return copy_validated(src, dest, Count, policy);
+#endif
+}
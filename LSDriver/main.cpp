@@ -1,244 +1,1540 @@
-#include <fstream>
-#include <random>
-#include <ctime>
-#include <string>
-#include "LaserScannerDriver.h"
-#define _CRTDBG_MAP_ALLOC
-
-using namespace std;
-
-bool fill(string file_name, vector<double>& v);
-LaserScannerDriver test_copy(const LaserScannerDriver& lsd, bool copy_and_test);
-void test_contructor_assignment(const LaserScannerDriver& first, const LaserScannerDriver& other);
-
-int main()
-{
-	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
-
-	srand(static_cast<int>(time(nullptr)));	//Setto il seed del generatore random per dopo
-
-	LaserScannerDriver lsd1(1);
-	cout << "Creazione con risoluzione " << lsd1.angular_resolution() << " ok" << endl;
-	LaserScannerDriver lsd2(0.4);
-	cout << "Creazione con risoluzione " << lsd2.angular_resolution() << " ok" << endl;
-	LaserScannerDriver lsd3(0.1);
-	cout << "Creazione con risoluzione " << lsd3.angular_resolution() << " ok" << endl;
-	try
-	{
-		LaserScannerDriver lsd4(-0.2);
-		cout << "Creazione con risoluzione " << lsd4.angular_resolution() << "ok" << endl;
-	}
-	catch (out_of_range e)
-	{
-		cerr << e.what();
-	}
-
-	cout << endl << endl;
-
-	//Riempio il vector con i dati
-	vector<double> v1;
-	vector<double> v2;
-	vector<double> v3;
-	if (!fill("input1.txt", v1))
-		return -1;
-	if (!fill("input2.txt", v2))
-		return -1;
-	if (!fill("input3.txt", v3))
-		return -1;
-	cout << "File reading ok" << endl;
-	cout << endl;
-
-	//Nota per il debug successivo: il primo numero di ogni scansione  il numero del file e del vettore, per comodit (v1[0] = primo valore di input1.txt = 1)
-
-
-	/*************TESTING DI NEW_SCAN() E GET_DISTANCE()*************/
-
-	//Inserisco diversi vector
-	cout << "testing new_scan() and get_distance():" << endl;
-	LaserScannerDriver lsd(0.764);
-	//Temporarly store first values of each scan
-	constexpr int scans = 3;
-	double dist[scans];
-	lsd.new_scan(v1);
-	dist[0] = lsd.get_distance(0);
-	lsd.new_scan(v2);
-	dist[1] = lsd.get_distance(0);
-	lsd.new_scan(v3);
-	dist[2] = lsd.get_distance(0);
-
-	//Controllo se la scan i-esima ha come primo valore proprio i
-	for (int i = 0; i < scans; i++)
-	{
-		cout << "Scan " << i + 1 << " ";
-		if (dist[i] == static_cast<double>(i + 1))	//Cast non necessario in quanto eseguito implicitamente, scritto comunque esplicitamente solo per chiarezza
-			cout << "ok";
-		else
-			cout << "error";
-		cout << endl;
-	}
-	cout << endl;
-
-	/*************TESTING DI GET_SCAN()*************/
-
-	//Rimuovo v2 (test fatto con dimensione di buffer_dim = 2, quindi v1  stato sovrascritto da v3. Con altri test, sovrascrivere la variabile costante vector_number dopo aver fatto i calcoli)
-	constexpr int vector_number = 2;
-	cout << "Testing get_scan(): this should be vector" << vector_number << endl;
-
-	vector<double> removed = lsd.get_scan();
-	double first_value = removed[0];
-	cout << "This is vector" << first_value << endl;
-
-	if (vector_number == static_cast<int>(first_value))
-		cout << "get_scan() ok";
-	else
-		cout << "get_scan() error";
-
-	cout << endl << endl;
-
-	/*************TESTING DI COSTRUTTORE COPY E MOVE*************/
-
-	//Dentro metodo test_copy() si usa il copy constructor, al ritorno dal metodo verr invocato il move constructor per assegnare l'rvalue temporaneo ritornato
-	cout << "Testing copy constructor: " << endl;;
-	const LaserScannerDriver move_lsd = test_copy(lsd, true); //Sar possibile usare solo i metodi get_angular_resolution() e get_distance()
-
-	cout << endl;
-
-	cout << "Testing move constructor: " << endl;
-	test_contructor_assignment(lsd, move_lsd);
-	
-	cout << endl;
-
-
-	/*************TESTING DI ASSEGNAMENTO COPY E MOVE*************/
-
-	cout << "Testing copy assignment: " << endl;
-	LaserScannerDriver copy_lsd;
-	copy_lsd.new_scan(v1);
-	copy_lsd.new_scan(v2);
-	copy_lsd = lsd; //Copy assignment
-	test_contructor_assignment(lsd, copy_lsd);
-
-	cout << endl;
-
-	cout << "Testing move assigment: " << endl;
-	LaserScannerDriver move_lsd1;
-	move_lsd1.new_scan(v1);
-	move_lsd1.new_scan(v3);
-	move_lsd1.new_scan(v2);
-	move_lsd1 = test_copy(copy_lsd, false); //Move assignment
-	test_contructor_assignment(copy_lsd, move_lsd1);
-
-	cout << endl;
-
-
-	/*************TESTING DI CLEAR_BUFFER()*************/
-
-	cout << "clearing buffer..." << endl;
-	lsd.clear_buffer();
-	cout << lsd;
-
-	//ora invocare get_scan() dovrebbe dare problemi se lo scanner  vuoto
-	try
-	{
-		lsd.get_scan();
-		cout << "get_scan() successful. Test gone wrong";
-	}
-	catch (LaserScannerDriver::EmptyBufferException)
-	{
-		cout << "buffer is empty! Test is successful"; 
-	}
-
-	cout << endl << endl;
-
-
-	/*************TESTING COUT E MOVE E COPY ASSIGNMENT*************/
-
-	//Ora lsd  vuoto. Se move_lsd  stato fatto correttamente (cio con una deep copy), dentro dovrebbero ancora esserci dei valori. Cos come dentro copy_lsd, li stampo entrambi a schermo
-	cout << "Testing cout and deep copy effectiveness: " << endl;
-	cout << "move_lsd:" << endl << move_lsd << endl << endl;;
-	cout << "copy_lsd:" << endl << copy_lsd << endl;
-
-}
-
-
-/*!
- * @brief Fa una copia dell'oggetto passato e la ritorna cos da testare: copy, move constructor e move assignment
- * @param copy_and_test vero se deve fare anche il test, falso altrimenti
-*/
-LaserScannerDriver test_copy(const LaserScannerDriver& lsd, bool copy_and_test)
-{
-	cout << "calling copy constuctor..." << endl;
-	LaserScannerDriver copy_lsd = lsd;
-
-	if(copy_and_test)
-		test_contructor_assignment(lsd, copy_lsd);
-
-	return copy_lsd;
-}
-
-/*!
- * @brief Controlla se la copia dei dati ha avuto successo
- * @param first Oggetto originale
- * @param other Oggetto copiato
-*/
-void test_contructor_assignment(const LaserScannerDriver& first, const LaserScannerDriver& other)
-{
-	//Faccio un controllo solo su un valore (casuale) per evitare di inviare troppi valori in output che mi impediscono di vedere tutto l'output generato dal main (da VisualStudio almeno
-	//la finestra della console generata pu contenere un numero massimo di righe) 
-
-	const int angle = rand() % (static_cast<int>(LaserScannerDriver::kMaxAngle + 1)); //Genero un numero casuale tra 0 e 180 (estremi inclusi)
-	double d1 = first.get_distance(angle);											  //Ritorno la distanza relativa a quell'angolo
-	double d2 = other.get_distance(angle);
-
-	cout << "original data: resolution = " << first.angular_resolution() << "; get_distance(" << angle << ") = " << d1 << endl;
-	cout << "copied/moved data: resolution = " << other.angular_resolution() << "; get_distance(" << angle << ") = " << d2 << endl;
-
-	if (first.angular_resolution() == other.angular_resolution())
-		cout << "angular resolution ok";
-	else
-		cout << "error copying angular resolution";
-
-	cout << endl;
-
-	if (d1 == d2)
-		cout << "value ok";
-	else
-		cout << "error while copying values";
-
-	cout << endl;
-}
-
-/*!
- * @brief Riempie il vector v passato per reference con i valori inclusi nel file fornito
- * @return vero se la copia dei valori ha avuto successo, falso altrimenti
-*/
-bool fill(string file_name, vector<double>& v)
-{
-	ifstream my_file;
-
-	my_file.open(file_name);
-	if (my_file.fail())	//Se il file non  stato trovato ritorna falso
-	{
-		cout << "File not found";
-		return false;
-	}
-
-	string read_value;
-	while (!my_file.eof())	//Leggo finch non raggiungo l'end of file
-	{
-		my_file >> read_value;
-		try
-		{
-			v.push_back(stod(read_value));
-		}
-		catch (exception e)
-		{
-			//Eccezione non gestita volutamente: se trovo qualcosa che non sia un numero, lo ignoro
-		}
-	}
-
-	//Libero i file aperti
-	my_file.close();
-
-	return true;
-}
\ No newline at end of file
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <ctime>
+#include <string>
+#include <thread>
+#include "LaserScannerDriver.h"
+#include "ConcurrentLaserScannerDriver.h"
+#include "LaserScannerManager.h"
+#include "BasicLaserScannerDriver.h"
+#include "CompactLaserScannerDriver.h"
+#include "HeapGuard.h"
+#include "ScanFileLoader.h"
+#include "ScanLog.h"
+#include "ScanExport.h"
+#include "ScanFilters.h"
+#include "ScanGeometry.h"
+#include "ScanOccupancy.h"
+#include "ScanSharedMemory.h"
+#include <cmath>
+#include <numbers>
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+volatile double sink_distance;	//Evita che il compilatore elimini le chiamate usate solo per le statistiche
+
+bool fill(string file_name, vector<double>& v);
+LaserScannerDriver test_copy(const LaserScannerDriver& lsd, bool copy_and_test);
+void test_contructor_assignment(const LaserScannerDriver& first, const LaserScannerDriver& other);
+bool test_concurrent_stress(int scans);
+bool test_concurrent_policies(int scans);
+bool test_manager(int scans);
+bool test_filters(int scans, int window);
+bool test_shared_memory(int scans);
+
+int main()
+{
+#ifdef _MSC_VER
+	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);	//Controllo dei memory leak, disponibile solo con MSVC
+#endif
+
+	srand(static_cast<int>(time(nullptr)));	//Setto il seed del generatore random per dopo
+
+	LaserScannerDriver lsd1(1);
+	cout << "Creazione con risoluzione " << lsd1.angular_resolution() << " ok" << endl;
+	LaserScannerDriver lsd2(0.4);
+	cout << "Creazione con risoluzione " << lsd2.angular_resolution() << " ok" << endl;
+	LaserScannerDriver lsd3(0.1);
+	cout << "Creazione con risoluzione " << lsd3.angular_resolution() << " ok" << endl;
+	try
+	{
+		LaserScannerDriver lsd4(-0.2);
+		cout << "Creazione con risoluzione " << lsd4.angular_resolution() << "ok" << endl;
+	}
+	catch (out_of_range e)
+	{
+		cerr << e.what();
+	}
+
+	cout << endl << endl;
+
+	//Riempio il vector con i dati
+	vector<double> v1;
+	vector<double> v2;
+	vector<double> v3;
+	if (!fill("input1.txt", v1))
+		return -1;
+	if (!fill("input2.txt", v2))
+		return -1;
+	if (!fill("input3.txt", v3))
+		return -1;
+	cout << "File reading ok" << endl;
+	cout << endl;
+
+	//Nota per il debug successivo: il primo numero di ogni scansione è il numero del file e del vettore, per comodità (v1[0] = primo valore di input1.txt = 1)
+
+
+	/*************TESTING DI NEW_SCAN() E GET_DISTANCE()*************/
+
+	//Inserisco diversi vector
+	cout << "testing new_scan() and get_distance():" << endl;
+	LaserScannerDriver lsd(0.764);
+	//Temporarly store first values of each scan
+	constexpr int scans = 3;
+	double dist[scans];
+	lsd.new_scan(v1);
+	dist[0] = lsd.get_distance(0);
+	lsd.new_scan(v2);
+	dist[1] = lsd.get_distance(0);
+	lsd.new_scan(v3);
+	dist[2] = lsd.get_distance(0);
+
+	//Controllo se la scan i-esima ha come primo valore proprio i
+	for (int i = 0; i < scans; i++)
+	{
+		cout << "Scan " << i + 1 << " ";
+		if (dist[i] == static_cast<double>(i + 1))	//Cast non necessario in quanto eseguito implicitamente, scritto comunque esplicitamente solo per chiarezza
+			cout << "ok";
+		else
+			cout << "error";
+		cout << endl;
+	}
+	cout << endl;
+
+	/*************TESTING DI GET_SCAN()*************/
+
+	//Rimuovo v2 (test fatto con dimensione di buffer_dim = 2, quindi v1 è stato sovrascritto da v3. Con altri test, sovrascrivere la variabile costante vector_number dopo aver fatto i calcoli)
+	constexpr int vector_number = 2;
+	cout << "Testing get_scan(): this should be vector" << vector_number << endl;
+
+	vector<double> removed = lsd.get_scan();
+	double first_value = removed[0];
+	cout << "This is vector" << first_value << endl;
+
+	if (vector_number == static_cast<int>(first_value))
+		cout << "get_scan() ok";
+	else
+		cout << "get_scan() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLA CAPACITA' DEL BUFFER*************/
+
+	//Con un buffer di 3 scansioni nessuna delle tre scansioni viene sovrascritta: la meno recente deve essere v1
+	cout << "Testing buffer capacity: this should be vector1" << endl;
+	LaserScannerDriver big_lsd(0.764, 3);
+	big_lsd.new_scan(v1);
+	big_lsd.new_scan(v2);
+	big_lsd.new_scan(v3);
+
+	if (big_lsd.is_full() && big_lsd.size() == big_lsd.capacity() && big_lsd.get_scan()[0] == 1 && big_lsd.get_distance(0) == 3)
+		cout << "capacity ok";
+	else
+		cout << "capacity error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI TAKE_SCAN() E DELLE VISTE*************/
+
+	//big_lsd contiene ora v2 e v3: la vista sulla meno recente deve puntare a v2, quella sulla più recente a v3
+	cout << "Testing take_scan() and scan views: " << endl;
+	bool views_ok = big_lsd.oldest_scan()[0] == 2 && big_lsd.newest_scan()[0] == 3;
+	{
+		LaserScannerDriver::ScanLease lease = big_lsd.take_scan();
+		views_ok = views_ok && lease[0] == 2 && lease.size() == static_cast<size_t>(big_lsd.measurements()) && big_lsd.size() == 2;
+	}
+	//Distrutta la guardia, la scansione deve essere stata rimossa
+	views_ok = views_ok && big_lsd.size() == 1 && big_lsd.oldest_scan()[0] == 3;
+
+	if (views_ok)
+		cout << "take_scan() ok";
+	else
+		cout << "take_scan() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI ACQUIRE_WRITE_SLOT() E COMMIT()*************/
+
+	//Scrivo v1 direttamente nello slot riservato: dopo commit() deve essere la scansione più recente
+	cout << "Testing acquire_write_slot() and commit(): " << endl;
+	span<double> write_slot = big_lsd.acquire_write_slot();
+	fill(write_slot.begin(), write_slot.end(), 0.0);
+	copy(v1.begin(), v1.begin() + min(v1.size(), write_slot.size()), write_slot.begin());
+	bool committed = big_lsd.size() == 1;		//Prima di commit() la scansione non deve essere visibile
+	big_lsd.commit();
+
+	if (committed && big_lsd.size() == 2 && big_lsd.get_distance(0) == 1 && big_lsd.oldest_scan()[0] == 3)
+		cout << "commit() ok";
+	else
+		cout << "commit() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE POLITICHE SUI VALORI NON VALIDI*************/
+
+	cout << "Testing invalid value policies: " << endl;
+	vector<double> bad_scan(v1);
+	bad_scan[1] = -4;
+	bad_scan[2] = nan("");
+	LaserScannerDriver policy_lsd(1);
+	bool policy_ok = false;
+	try
+	{
+		policy_lsd.new_scan(bad_scan);
+	}
+	catch (const invalid_argument&)
+	{
+		policy_ok = policy_lsd.is_empty();	//Con kThrow la scansione non deve essere stata inserita
+	}
+	policy_lsd.set_invalid_value_policy(InvalidValuePolicy::kClampToZero);
+	policy_ok = policy_ok && policy_lsd.new_scan(bad_scan) == 2 && policy_lsd.get_distance(1) == 0 && policy_lsd.get_distance(2) == 0;
+	policy_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	policy_ok = policy_ok && policy_lsd.new_scan(bad_scan) == 2 && isnan(policy_lsd.get_distance(1)) && policy_lsd.get_distance(3) == v1[3];
+
+	if (policy_ok)
+		cout << "invalid value policies ok";
+	else
+		cout << "invalid value policies error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI GET_DISTANCES()*************/
+
+	//Il risultato del lotto deve coincidere con quello di get_distance() chiamato per ogni angolo (compresi angoli fuori dal range)
+	cout << "Testing get_distances(): " << endl;
+	vector<double> angles;
+	for (double angle = -10; angle <= LaserScannerDriver::kMaxAngle + 10; angle += 0.37)
+		angles.push_back(angle);
+	vector<double> distances(angles.size());
+	lsd.get_distances(angles, distances);
+	bool batch_ok = true;
+	for (size_t i = 0; i < angles.size(); i++)
+		batch_ok = batch_ok && distances[i] == lsd.get_distance(angles[i]);
+
+	if (batch_ok)
+		cout << "get_distances() ok";
+	else
+		cout << "get_distances() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI BASICLASERSCANNERDRIVER*************/
+
+	//La versione con risoluzione e capacità note in compilazione deve comportarsi come quella dinamica
+	cout << "Testing BasicLaserScannerDriver: " << endl;
+	BasicLaserScannerDriver<0.764, 2> static_lsd;
+	LaserScannerDriver dynamic_lsd(0.764, 2);
+	for (const vector<double>& v : { v1, v2, v3 })
+	{
+		static_lsd.new_scan(v);
+		dynamic_lsd.new_scan(v);
+	}
+	bool static_ok = static_lsd.measurements() == dynamic_lsd.measurements() && static_lsd.get_scan() == dynamic_lsd.get_scan();
+	for (double angle : angles)
+		static_ok = static_ok && static_lsd.get_distance(angle) == dynamic_lsd.get_distance(angle);
+
+	//A buffer pieno (v3 e v1, get_scan() ha prelevato v2) una scansione rifiutata dalla validazione non deve far scartare la meno recente
+	static_lsd.new_scan(v1);
+	vector<double> rejected_scan(static_lsd.measurements(), -1.0);
+	try
+	{
+		static_lsd.new_scan(rejected_scan);
+		static_ok = false;
+	}
+	catch (const invalid_argument&)
+	{
+	}
+	static_ok = static_ok && static_lsd.size() == 2 && static_lsd.oldest_scan()[0] == v3[0];
+	//Con le altre politiche le misurazioni non valide vengono sostituite e contate anche nel ciclo a numero di iterazioni costante
+	static_lsd.set_invalid_value_policy(InvalidValuePolicy::kClampToZero);
+	static_ok = static_ok && static_lsd.new_scan(rejected_scan) == static_lsd.measurements() && static_lsd.newest_scan().back() == 0;
+
+	if (static_ok)
+		cout << "BasicLaserScannerDriver ok";
+	else
+		cout << "BasicLaserScannerDriver error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI SCANFILELOADER*************/
+
+	//Ogni file contiene una sola scansione (una riga): caricandoli tutti in un buffer da 2, devono rimanere input2 e input3.
+	//input1.txt contiene due token che non sono numeri ("ciao" e "gf"), che devono essere ignorati e riportati come errori
+	cout << "Testing ScanFileLoader: " << endl;
+	LaserScannerDriver loaded_lsd(0.764, 2);
+	bool loader_ok = true;
+	size_t parse_errors = 0;
+	for (string file_name : { "input1.txt", "input2.txt", "input3.txt" })
+	{
+		ScanLoadResult result = ScanFileLoader(file_name).load_into(loaded_lsd);
+		for (const ScanParseError& error : result.errors)
+			cout << file_name << " offset " << error.offset << ": " << error.message << endl;
+		loader_ok = loader_ok && result.scans == 1;
+		parse_errors += result.error_count;
+	}
+	loader_ok = loader_ok && parse_errors == 2 && loaded_lsd.get_scan()[0] == 2 && loaded_lsd.get_distance(0) == 3;
+
+	//A buffer pieno con la scansione meno recente in prestito la riga viene rifiutata e riportata, senza perdere il risultato
+	loaded_lsd.new_scan(v1);
+	{
+		LaserScannerDriver::ScanLease lease = loaded_lsd.take_scan();
+		ScanLoadResult leased_result = ScanFileLoader("input2.txt").load_into(loaded_lsd);
+		loader_ok = loader_ok && leased_result.scans == 0 && leased_result.rejected_scans == 1 && leased_result.errors.size() == 1
+			&& leased_result.errors[0].offset == 0;
+	}
+	loader_ok = loader_ok && ScanFileLoader("input3.txt").load_into(loaded_lsd).scans == 1 && loaded_lsd.size() == 2 && loaded_lsd.get_scan()[0] == 1;
+
+	if (loader_ok)
+		cout << "ScanFileLoader ok";
+	else
+		cout << "ScanFileLoader error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI SCANRECORDER E SCANREPLAYER*************/
+
+	//Le tre scansioni registrate (anche quella scartata dal buffer pieno) devono essere rilette dal log identiche e nello stesso ordine.
+	//Assegnare al driver una sua copia non deve registrare di nuovo le scansioni che contiene
+	cout << "Testing ScanRecorder and ScanReplayer: " << endl;
+	const string log_name = "test_scans.lsdlog";
+	LaserScannerDriver recorded_lsd(0.764, 2);
+	{
+		ScanRecorder recorder(log_name, recorded_lsd.angular_resolution());
+		recorded_lsd.add_observer(&recorder);
+		for (const vector<double>& v : { v1, v2, v3 })
+			recorded_lsd.new_scan(v);
+		LaserScannerDriver recorded_copy(recorded_lsd);
+		recorded_lsd = recorded_copy;
+		recorded_lsd.remove_observer(&recorder);
+	}
+	bool log_ok;
+	{
+		ScanReplayer replayer(log_name);
+		LaserScannerDriver replayed_lsd(recorded_lsd.angular_resolution(), 3);
+		log_ok = replayer.size() == 3 && replayer.timestamp(0) <= replayer.timestamp(2)
+			&& replayer.replay(replayed_lsd, ScanReplayer::Speed::kOriginal) == 3;
+		for (size_t n = 0; log_ok && n < replayer.size(); n++)
+		{
+			vector<double> replayed = replayed_lsd.get_scan();
+			log_ok = equal(replayed.begin(), replayed.end(), replayer.scan(n).begin(), replayer.scan(n).end());
+		}
+		log_ok = log_ok && replayed_lsd.is_empty() && recorded_lsd.get_scan() == vector<double>(replayer.scan(1).begin(), replayer.scan(1).end());
+	}
+	remove(log_name.c_str());
+
+	//Un header con più misurazioni di quelle della sua risoluzione deve essere rifiutato: replay() le copierebbe oltre la fine degli slot
+	{
+		ScanLogHeader corrupted_header{};
+		memcpy(corrupted_header.magic, ScanLogHeader::kMagic, sizeof(corrupted_header.magic));
+		corrupted_header.version = ScanLogHeader::kVersion;
+		corrupted_header.measurements = 5000;
+		corrupted_header.resolution = 1;
+		corrupted_header.record_size = sizeof(int64_t) + corrupted_header.measurements * sizeof(double);
+		ofstream corrupted_log(log_name, ios::binary | ios::trunc);
+		corrupted_log.write(reinterpret_cast<const char*>(&corrupted_header), sizeof(corrupted_header));
+		vector<char> corrupted_record(corrupted_header.record_size);
+		corrupted_log.write(corrupted_record.data(), static_cast<streamsize>(corrupted_record.size()));
+	}
+	try
+	{
+		ScanReplayer corrupted_replayer(log_name);
+		log_ok = false;
+	}
+	catch (const runtime_error&)
+	{
+	}
+
+	//Un log i cui timestamp tornano indietro (system_clock corretto durante la registrazione) deve essere riprodotto per intero anche con kOriginal
+	{
+		ScanLogHeader stepped_header{};
+		memcpy(stepped_header.magic, ScanLogHeader::kMagic, sizeof(stepped_header.magic));
+		stepped_header.version = ScanLogHeader::kVersion;
+		stepped_header.measurements = static_cast<uint32_t>(measurement_count(1));
+		stepped_header.resolution = 1;
+		stepped_header.record_size = sizeof(int64_t) + stepped_header.measurements * sizeof(double);
+		ofstream stepped_log(log_name, ios::binary | ios::trunc);
+		stepped_log.write(reinterpret_cast<const char*>(&stepped_header), sizeof(stepped_header));
+		vector<double> stepped_scan(stepped_header.measurements, 1.0);
+		for (int64_t stepped_timestamp : { 5000000, 7000000, 2000000 })
+		{
+			stepped_log.write(reinterpret_cast<const char*>(&stepped_timestamp), sizeof(stepped_timestamp));
+			stepped_log.write(reinterpret_cast<const char*>(stepped_scan.data()), static_cast<streamsize>(stepped_scan.size() * sizeof(double)));
+		}
+	}
+	{
+		ScanReplayer stepped_replayer(log_name);
+		LaserScannerDriver stepped_lsd(1, 3);
+		log_ok = log_ok && stepped_replayer.replay(stepped_lsd, ScanReplayer::Speed::kOriginal) == 3 && stepped_lsd.size() == 3
+			&& LaserScannerDriver::timestamp(stepped_lsd.scan(2)) == LaserScannerDriver::timestamp(stepped_lsd.scan(1));
+	}
+	remove(log_name.c_str());
+
+	if (log_ok)
+		cout << "ScanRecorder and ScanReplayer ok";
+	else
+		cout << "ScanRecorder and ScanReplayer error";
+
+	cout << endl << endl;
+
+	/*************TESTING DEL COPY-ON-WRITE*************/
+
+	//La copia condivide gli slot con l'originale: le scansioni inserite dopo la copia (che riutilizzano slot condivisi) non devono essere visibili nell'altro driver
+	cout << "Testing copy-on-write: " << endl;
+	LaserScannerDriver cow_lsd(0.764, 2);
+	cow_lsd.new_scan(v1);
+	cow_lsd.new_scan(v2);
+	bool cow_ok;
+	{
+		LaserScannerDriver snapshot(cow_lsd);
+		cow_ok = snapshot.oldest_scan().data() == cow_lsd.oldest_scan().data();	//Nessuna copia delle misurazioni
+		cow_lsd.new_scan(v3);
+		LaserScannerDriver second_snapshot = snapshot;
+		snapshot.new_scan(v3);
+		cow_ok = cow_ok && cow_lsd.get_scan() == snapshot.get_scan() && snapshot.get_distance(0) == v3[0];
+		cow_ok = cow_ok && second_snapshot.oldest_scan()[0] == v1[0] && second_snapshot.get_distance(0) == v2[0];
+	}
+	cow_ok = cow_ok && cow_lsd.get_distance(0) == v3[0];
+
+	if (cow_ok)
+		cout << "copy-on-write ok";
+	else
+		cout << "copy-on-write error";
+
+	cout << endl << endl;
+
+	/*************TESTING DEI FILTRI TEMPORALI*************/
+
+	//I filtri aggiornati incrementalmente devono coincidere con il calcolo diretto sulle ultime window scansioni
+	cout << "Testing temporal filters: " << endl;
+	if (test_filters(60, 5) && test_filters(40, 4) && test_filters(80, 16) && test_filters(10, 1))
+		cout << "temporal filters ok";
+	else
+		cout << "temporal filters error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLA CONVERSIONE IN COORDINATE CARTESIANE*************/
+
+	//I punti ottenuti con la tabella precalcolata devono coincidere con il calcolo diretto. Con il LIDAR in (1, 2) ruotato di 90 gradi l'angolo 0
+	//del LIDAR punta lungo l'asse y del robot: il punto a distanza d diventa (1, 2 + d)
+	cout << "Testing get_points(): " << endl;
+	vector<double> points_x(lsd.measurements());
+	vector<double> points_y(lsd.measurements());
+	lsd.get_points(points_x, points_y);
+	span<const double> newest = lsd.newest_scan();
+	bool points_ok = &TrigTable::for_resolution(lsd.angular_resolution()) == &TrigTable::for_resolution(0.764);
+	for (int i = 0; i < lsd.measurements(); i++)
+	{
+		double angle = i * lsd.angular_resolution() * numbers::pi / 180;
+		points_ok = points_ok && abs(points_x[i] - newest[i] * cos(angle)) < 1e-12 && abs(points_y[i] - newest[i] * sin(angle)) < 1e-12;
+	}
+	lsd.get_points(points_x, points_y, MountingTransform{ 1, 2, 90 });
+	points_ok = points_ok && abs(points_x[0] - 1) < 1e-12 && abs(points_y[0] - (2 + newest[0])) < 1e-12;
+	try
+	{
+		lsd.get_points(span<double>(points_x).first(1), points_y);
+		points_ok = false;
+	}
+	catch (const invalid_argument&) {}
+
+	if (points_ok)
+		cout << "get_points() ok";
+	else
+		cout << "get_points() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI MIN_DISTANCE() E MAX_DISTANCE()*************/
+
+	//Le interrogazioni sull'indice devono coincidere con la ricerca lineare su tutte le misurazioni dell'intervallo, anche con misurazioni NaN
+	//e dopo l'inserimento di una nuova scansione (che invalida l'indice)
+	cout << "Testing min_distance() and max_distance(): " << endl;
+	LaserScannerDriver range_lsd(0.5, 2);
+	range_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	bool range_ok = true;
+	for (const vector<double>& v : { v1, v2 })
+	{
+		vector<double> scan = v;
+		scan.resize(range_lsd.measurements());
+		for (size_t i = 3; i < scan.size(); i += 7)
+			scan[i] = -1;		//Misurazioni non valide, memorizzate come NaN
+		range_lsd.new_scan(scan);
+		span<const double> stored = range_lsd.newest_scan();
+		for (int first = 0; first < range_lsd.measurements(); first += 13)
+			for (int last = first; last < range_lsd.measurements(); last += 17)
+			{
+				int expected_min = -1, expected_max = -1;
+				for (int i = first; i <= last; i++)
+					if (!isnan(stored[i]))
+					{
+						if (expected_min < 0 || stored[i] < stored[expected_min])
+							expected_min = i;
+						if (expected_max < 0 || stored[i] > stored[expected_max])
+							expected_max = i;
+					}
+				double a0 = first * 0.5, a1 = last * 0.5;
+				if (expected_min < 0)
+					range_ok = range_ok && isnan(range_lsd.min_distance(a0, a1)) && isnan(range_lsd.max_distance(a0, a1));
+				else
+					range_ok = range_ok && range_lsd.min_distance(a0, a1) == stored[expected_min] && range_lsd.max_distance(a0, a1) == stored[expected_max]
+						&& range_lsd.argmin_distance(a0, a1) == expected_min * 0.5;
+			}
+	}
+	range_ok = range_ok && range_lsd.min_distance(60.2, 60.2) == range_lsd.get_distance(60.2);
+	try
+	{
+		range_lsd.min_distance(120, 60);
+		range_ok = false;
+	}
+	catch (const invalid_argument&) {}
+
+	if (range_ok)
+		cout << "min_distance() and max_distance() ok";
+	else
+		cout << "min_distance() and max_distance() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI COMPACTLASERSCANNERDRIVER*************/
+
+	//Le distanze lette devono coincidere con quelle inserite a meno dell'errore di conversione (nessuno con double, arrotondamento a float,
+	//mezza unità con kFixed16), le misurazioni non valide devono restare NaN e il buffer deve occupare 1/2 e 1/4 della versione double
+	cout << "Testing CompactLaserScannerDriver: " << endl;
+	bool compact_ok = true;
+	size_t double_bytes = 0;
+	for (StoragePrecision precision : { StoragePrecision::kDouble, StoragePrecision::kFloat, StoragePrecision::kFixed16 })
+	{
+		CompactLaserScannerDriver compact(0.5, 2, precision, 0.001);
+		compact.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+		vector<double> scan = v2;
+		scan.resize(compact.measurements(), 7.25);
+		scan[5] = -1;
+		scan[6] = 1e6;		//Oltre la distanza massima di kFixed16 (65.534 m): viene saturata
+		compact.new_scan(v1);
+		compact.new_scan(scan);
+		compact.new_scan(scan);		//Buffer pieno: v1 viene scartata
+		if (precision == StoragePrecision::kDouble)
+			double_bytes = compact.storage_bytes();
+		else
+			compact_ok = compact_ok && compact.storage_bytes() <= double_bytes / (precision == StoragePrecision::kFloat ? 2 : 4) + 32;
+
+		vector<double> angles_compact = { 0, 2.5, 3, 90.2, 180 };
+		vector<double> distances_compact(angles_compact.size());
+		compact.get_distances(angles_compact, distances_compact);
+		vector<double> read = compact.get_scan();
+		for (size_t i = 0; i < angles_compact.size(); i++)
+		{
+			double expected = read[nearest_measurement_index(angles_compact[i], 2, compact.measurements() - 1)];
+			double single = compact.get_distance(angles_compact[i]);
+			compact_ok = compact_ok && (distances_compact[i] == expected || (isnan(expected) && isnan(distances_compact[i])))
+				&& (single == expected || (isnan(expected) && isnan(single)));
+		}
+		for (int i = 0; i < compact.measurements(); i++)
+		{
+			if (i == 5)
+				compact_ok = compact_ok && isnan(read[i]);
+			else if (precision == StoragePrecision::kDouble)
+				compact_ok = compact_ok && read[i] == scan[i];
+			else if (precision == StoragePrecision::kFloat)
+				compact_ok = compact_ok && read[i] == static_cast<float>(scan[i]);
+			else if (i == 6)
+				compact_ok = compact_ok && abs(read[i] - kFixed16Max * 0.001) < 1e-9;
+			else
+				compact_ok = compact_ok && abs(read[i] - scan[i]) <= 0.0005 + 1e-9;
+		}
+		compact_ok = compact_ok && compact.size() == 1;
+	}
+
+	if (compact_ok)
+		cout << "CompactLaserScannerDriver ok";
+	else
+		cout << "CompactLaserScannerDriver error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE STATISTICHE*************/
+
+	//I contatori devono riflettere le operazioni eseguite e l'istantanea deve poter essere letta da un altro thread mentre il driver riceve scansioni
+	cout << "Testing stats(): " << endl;
+	LaserScannerDriver stats_lsd(0.764, 2);
+	stats_lsd.new_scan(v1);
+	stats_lsd.new_scan(v2);
+	stats_lsd.new_scan(v3);		//Buffer pieno: v1 viene sovrascritta
+	vector<double> invalid_scan = v1;
+	invalid_scan[2] = -1;
+	try
+	{
+		stats_lsd.new_scan(invalid_scan);
+	}
+	catch (const invalid_argument&) {}
+	bool rejected_kept = stats_lsd.size() == 2 && stats_lsd.oldest_scan()[0] == 2;		//La scansione rifiutata non deve far scartare v2
+	stats_lsd.set_invalid_value_policy(InvalidValuePolicy::kClampToZero);
+	stats_lsd.new_scan(invalid_scan);		//Buffer pieno: v2 viene sovrascritta
+	for (unsigned i = 0; i < 2 * ScanStatsCounters::kLatencySampleInterval; i++)
+		sink_distance = stats_lsd.get_distance(i);
+	stats_lsd.get_scan();
+
+	DriverStats driver_stats = stats_lsd.stats();
+	bool stats_ok;
+	if constexpr (kStatsEnabled)
+	{
+		stats_ok = rejected_kept && driver_stats.scans_committed == 4 && driver_stats.scans_overwritten == 2 && driver_stats.scans_rejected == 1
+			&& driver_stats.invalid_measurements == 1 && driver_stats.peak_occupancy == 2 && driver_stats.get_distance.samples == 2
+			&& driver_stats.get_scan.samples == 1 && driver_stats.new_scan.samples == 1
+			&& driver_stats.new_scan.percentile(100) >= driver_stats.new_scan.percentile(50);
+
+		//Lettura concorrente: i contatori letti non devono mai diminuire
+		atomic<bool> producing{ true };
+		bool monotonic = true;
+		thread reader([&] {
+			uint64_t last = 0;
+			while (producing.load())
+			{
+				uint64_t committed = stats_lsd.stats().scans_committed;
+				monotonic = monotonic && committed >= last;
+				last = committed;
+			}
+			});
+		for (int i = 0; i < 2000; i++)
+			stats_lsd.new_scan(v2);
+		producing.store(false);
+		reader.join();
+		stats_ok = stats_ok && monotonic && stats_lsd.stats().scans_committed == 2004;
+		stats_lsd.reset_stats();
+		stats_ok = stats_ok && stats_lsd.stats().scans_committed == 0 && LaserScannerDriver(stats_lsd).stats().peak_occupancy == 0;
+	}
+	else
+		stats_ok = rejected_kept && driver_stats.scans_committed == 0;
+
+	if (stats_ok)
+		cout << "stats() ok";
+	else
+		cout << "stats() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DEGLI ESPORTATORI*************/
+
+	//Ogni formato deve poter essere riletto: CSV con le distanze arrotondate alla precisione richiesta (NaN come "nan"), JSON con null al posto
+	//di NaN e binario identico alle misurazioni memorizzate
+	cout << "Testing ScanExporter: " << endl;
+	LaserScannerDriver export_lsd(0.764, 3);
+	export_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	export_lsd.new_scan(v1);
+	export_lsd.new_scan(invalid_scan);
+	bool export_ok = true;
+
+	ScanExporter csv(ExportFormat::kCsv, 3);
+	ostringstream csv_stream;
+	csv.write_header(csv_stream, export_lsd);
+	export_ok = export_ok && csv.write_all(csv_stream, export_lsd) == 2 && csv.exported() == 2;
+	istringstream csv_lines(csv_stream.str());
+	string line;
+	getline(csv_lines, line);
+	export_ok = export_ok && line.rfind("sequence,0,0.764,1.528,", 0) == 0;
+	//Gli angoli dell'intestazione non devono riportare l'errore di rappresentazione di i * risoluzione (3 * 0.1 = 0.30000000000000004)
+	ostringstream fine_header;
+	csv.write_header(fine_header, LaserScannerDriver(0.1, 1));
+	export_ok = export_ok && fine_header.str().rfind("sequence,0,0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,1,1.1,", 0) == 0
+		&& fine_header.str().find("0000") == string::npos && fine_header.str().find(",180\n") != string::npos;
+	for (int scan_index = 0; getline(csv_lines, line); scan_index++)
+	{
+		span<const double> stored = export_lsd.scan(scan_index);
+		const char* field = line.c_str();
+		char* end;
+		export_ok = export_ok && strtoull(field, &end, 10) == static_cast<unsigned long long>(scan_index);
+		for (size_t i = 0; i < stored.size() && export_ok; i++)
+		{
+			export_ok = *end == ',';
+			double value = strtod(end + 1, &end);
+			export_ok = export_ok && (isnan(stored[i]) ? isnan(value) : abs(value - stored[i]) <= 0.0005 + 1e-12);
+		}
+		export_ok = export_ok && *end == '\0';
+	}
+
+	ScanExporter json(ExportFormat::kJsonLines, 2);
+	ostringstream json_stream;
+	json.write_newest(json_stream, export_lsd);
+	string json_text = json_stream.str();
+	export_ok = export_ok && json_text.rfind("{\"sequence\":0,\"resolution\":0.764,\"distances\":[", 0) == 0
+		&& json_text.find(",null,") != string::npos && json_text.find("nan") == string::npos && json_text.substr(json_text.size() - 3) == "]}\n";
+
+	ScanExporter binary(ExportFormat::kBinary);
+	ostringstream binary_stream;
+	binary.write_all(binary_stream, export_lsd);
+	string bytes = binary_stream.str();
+	size_t scan_bytes = export_lsd.measurements() * sizeof(double);
+	export_ok = export_ok && bytes.size() == 2 * scan_bytes && memcmp(bytes.data(), export_lsd.scan(0).data(), scan_bytes) == 0
+		&& memcmp(bytes.data() + scan_bytes, export_lsd.scan(1).data(), scan_bytes) == 0;
+
+	if (export_ok)
+		cout << "ScanExporter ok";
+	else
+		cout << "ScanExporter error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE SCANSIONI CON ISTANTE DI ACQUISIZIONE*************/
+
+	//Tre scansioni costanti (1, 2, 4) acquisite a 0, 10 e 30 ms: tra due scansioni la distanza deve essere interpolata linearmente, fuori dall'intervallo
+	//deve valere quella della scansione più vicina. Una scansione più vecchia della più recente deve essere rifiutata senza modificare il buffer
+	cout << "Testing timestamped scans: " << endl;
+	LaserScannerDriver timed_lsd(1, 3);
+	LaserScannerDriver::Clock::time_point t0 = LaserScannerDriver::Clock::now();
+	timed_lsd.new_scan(vector<double>(timed_lsd.measurements(), 1), t0);
+	timed_lsd.new_scan(vector<double>(timed_lsd.measurements(), 2), t0 + 10ms);
+	span<double> timed_slot = timed_lsd.acquire_write_slot();
+	fill(timed_slot.begin(), timed_slot.end(), 4.0);
+	timed_lsd.commit(t0 + 30ms);
+
+	bool timed_ok = timed_lsd.timestamp(0) == t0 && timed_lsd.timestamp(2) == t0 + 30ms
+		&& LaserScannerDriver::timestamp(timed_lsd.newest_scan()) == t0 + 30ms
+		&& timed_lsd.get_distance(90, t0 - 1s) == 1 && timed_lsd.get_distance(90, t0) == 1
+		&& abs(timed_lsd.get_distance(90, t0 + 5ms) - 1.5) < 1e-9 && timed_lsd.get_distance(90, t0 + 10ms) == 2
+		&& abs(timed_lsd.get_distance(45, t0 + 25ms) - 3.5) < 1e-9 && timed_lsd.get_distance(90, t0 + 1s) == 4;
+	try
+	{
+		timed_lsd.new_scan(vector<double>(timed_lsd.measurements(), 8), t0 + 20ms);
+		timed_ok = false;
+	}
+	catch (const invalid_argument&)
+	{
+		timed_ok = timed_ok && timed_lsd.size() == 3 && timed_lsd.timestamp(0) == t0;
+	}
+	//Buffer pieno: la scansione a t0 viene sovrascritta e l'interpolazione usa le scansioni rimaste
+	timed_lsd.new_scan(vector<double>(timed_lsd.measurements(), 8), t0 + 40ms);
+	timed_ok = timed_ok && timed_lsd.get_distance(90, t0) == 2 && abs(timed_lsd.get_distance(90, t0 + 35ms) - 6) < 1e-9;
+
+	if (timed_ok)
+		cout << "timestamped scans ok";
+	else
+		cout << "timestamped scans error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLA GRIGLIA DI OCCUPAZIONE*************/
+
+	//Una misurazione a 1.05 lungo l'asse x deve occupare la cella che contiene (1.05, 0) e liberare quelle attraversate. Dopo inserimenti e
+	//sovrascritture la griglia aggiornata incrementalmente deve coincidere esattamente con quella ricostruita dalle scansioni rimaste nel buffer,
+	//e svuotando il buffer tutte le celle devono tornare a 0
+	cout << "Testing OccupancyGrid: " << endl;
+	OccupancyGridConfig grid_config;
+	grid_config.width = grid_config.height = 40;
+	grid_config.cell_size = 0.1;
+	grid_config.max_range = 1.5;
+	LaserScannerDriver grid_lsd(1, 3);
+	grid_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	OccupancyGrid grid(1, grid_config);
+	grid_lsd.add_observer(&grid);
+
+	grid_lsd.new_scan(vector<double>(grid_lsd.measurements(), 1.05));
+	int hit_x, hit_y, free_x, free_y;
+	bool grid_ok = grid.cell(1.05, 0, hit_x, hit_y) && grid.cell(0.55, 0, free_x, free_y) && !grid.cell(2.5, 0, hit_x, hit_y)
+		&& grid.log_odds(hit_x, hit_y) > 0 && grid.probability(hit_x, hit_y) > 0.5 && grid.log_odds(free_x, free_y) < 0;
+
+	mt19937 grid_generator(11);
+	uniform_real_distribution<double> grid_distances(0.2, 3);
+	for (int n = 0; n < 6; n++)
+	{
+		vector<double> grid_scan(grid_lsd.measurements());
+		for (double& d : grid_scan)
+			d = grid_distances(grid_generator);
+		grid_scan[n * 20] = -1;
+		grid_lsd.new_scan(grid_scan);
+	}
+	OccupancyGrid rebuilt(1, grid_config);
+	rebuilt.rebuild(grid_lsd);
+	vector<float> incremental_cells(grid.width() * grid.height()), rebuilt_cells(rebuilt.width() * rebuilt.height());
+	grid.copy_log_odds(incremental_cells);
+	rebuilt.copy_log_odds(rebuilt_cells);
+	grid_ok = grid_ok && grid.scans() == 3 && rebuilt.scans() == 3 && incremental_cells == rebuilt_cells
+		&& any_of(rebuilt_cells.begin(), rebuilt_cells.end(), [](float l) { return l != 0; });
+
+	//Dopo un assegnamento la griglia deve rispecchiare le scansioni del nuovo contenuto del buffer
+	LaserScannerDriver grid_copy(grid_lsd);
+	grid_copy.get_scan();
+	grid_lsd = grid_copy;
+	rebuilt.rebuild(grid_lsd);
+	grid.copy_log_odds(incremental_cells);
+	rebuilt.copy_log_odds(rebuilt_cells);
+	grid_ok = grid_ok && grid.scans() == 2 && incremental_cells == rebuilt_cells;
+
+	grid_lsd.clear_buffer();
+	grid.copy_log_odds(incremental_cells);
+	grid_ok = grid_ok && grid.scans() == 0 && all_of(incremental_cells.begin(), incremental_cells.end(), [](float l) { return l == 0; });
+
+	if (grid_ok)
+		cout << "OccupancyGrid ok";
+	else
+		cout << "OccupancyGrid error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE MISURAZIONI CAMBIATE*************/
+
+	//Gli intervalli trovati con le istruzioni vettoriali devono coincidere con il confronto scalare per ogni lunghezza (anche quelle non multiple
+	//della larghezza dei registri). La differenza della scansione più recente applicata alla precedente deve riprodurla, e le scansioni ricostruite
+	//dal registratore differenziale devono restare entro la soglia da quelle inserite
+	cout << "Testing changed_ranges(): " << endl;
+	bool delta_ok = true;
+	mt19937 delta_generator(5);
+	uniform_real_distribution<double> delta_values(0, 1);
+	vector<ScanRange> ranges;
+	for (int count = 0; count < 40 && delta_ok; count++)
+	{
+		vector<double> before(count), after(count);
+		for (int i = 0; i < count; i++)
+		{
+			before[i] = delta_values(delta_generator);
+			after[i] = delta_values(delta_generator) < 0.6 ? before[i] : before[i] + delta_values(delta_generator) - 0.5;
+		}
+		if (count > 5)
+			before[3] = after[3] = before[5] = numeric_limits<double>::quiet_NaN();
+
+		int changed_count = find_changed_ranges(before, after, 0.1, ranges);
+		vector<ScanRange> expected;
+		for (int i = 0; i < count; i++)
+		{
+			bool changed = abs(after[i] - before[i]) > 0.1 || isnan(after[i]) != isnan(before[i]);
+			if (changed && (expected.empty() || expected.back().last != i))
+				expected.push_back(ScanRange{ i, i + 1 });
+			else if (changed)
+				expected.back().last++;
+		}
+		int expected_count = 0;
+		for (const ScanRange& range : expected)
+			expected_count += range.size();
+		delta_ok = ranges == expected && changed_count == expected_count;
+	}
+
+	LaserScannerDriver delta_lsd(1, 3);
+	delta_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	vector<double> delta_scan(delta_lsd.measurements(), 2);
+	delta_lsd.new_scan(delta_scan);
+	delta_ok = delta_ok && delta_lsd.changed_ranges(0.01, ranges) == delta_lsd.measurements() && ranges.size() == 1;
+	delta_scan[10] = delta_scan[11] = delta_scan[12] = 3;
+	delta_scan[50] = 2.005;
+	delta_scan[100] = -1;
+	delta_scan.back() = 1;
+	delta_lsd.new_scan(delta_scan);
+	delta_ok = delta_ok && delta_lsd.changed_ranges(0.01, ranges) == 5
+		&& ranges == vector<ScanRange>{ { 10, 13 }, { 100, 101 }, { delta_lsd.measurements() - 1, delta_lsd.measurements() } };
+
+	ScanDelta delta;
+	delta_lsd.newest_delta(0, delta);
+	vector<double> patched(delta_lsd.scan(0).begin(), delta_lsd.scan(0).end());
+	delta.apply(patched);
+	delta_ok = delta_ok && delta.changed() == 6 && memcmp(patched.data(), delta_lsd.newest_scan().data(), patched.size() * sizeof(double)) == 0;
+
+	//Una misurazione che cresce di 0.004 per scansione (sotto la soglia di 0.01) deve comunque venire scritta prima di allontanarsi troppo
+	stringstream delta_stream;
+	ScanDeltaRecorder delta_recorder(delta_stream, 1, 0.01);
+	delta_lsd.add_observer(&delta_recorder);
+	vector<vector<double>> delta_inserted;
+	for (int n = 0; n < 20; n++)
+	{
+		delta_scan[20] += 0.004;
+		delta_scan[n + 30] = 5;
+		delta_lsd.new_scan(delta_scan);
+		delta_inserted.push_back(vector<double>(delta_lsd.newest_scan().begin(), delta_lsd.newest_scan().end()));
+	}
+	delta_lsd.remove_observer(&delta_recorder);
+	vector<double> reconstructed;
+	for (size_t n = 0; n < delta_inserted.size() && delta_ok; n++)
+	{
+		int64_t record_timestamp;
+		delta_ok = delta_stream.read(reinterpret_cast<char*>(&record_timestamp), sizeof(record_timestamp)) && delta.read(delta_stream);
+		reconstructed.resize(delta.measurements());
+		delta.apply(reconstructed);
+		for (size_t i = 0; i < reconstructed.size() && delta_ok; i++)
+			delta_ok = isnan(reconstructed[i]) ? isnan(delta_inserted[n][i]) : abs(reconstructed[i] - delta_inserted[n][i]) <= 0.01;
+	}
+	delta_ok = delta_ok && delta_stream.peek() == EOF && delta_recorder.recorded() == 20
+		&& delta_recorder.written_measurements() < static_cast<size_t>(2 * delta_lsd.measurements());
+
+	//Un header corrotto con più misurazioni di una scansione a risoluzione 0.1 deve essere rifiutato prima di allocare i valori
+	uint32_t corrupted[4] = { numeric_limits<uint32_t>::max(), 1, 0, numeric_limits<uint32_t>::max() };
+	stringstream corrupted_stream(string(reinterpret_cast<const char*>(corrupted), sizeof(corrupted)));
+	uint32_t largest[2] = { static_cast<uint32_t>(LaserScannerDriver(0.1, 1).measurements()), 0 };
+	stringstream largest_stream(string(reinterpret_cast<const char*>(largest), sizeof(largest)));
+	delta_ok = delta_ok && !delta.read(corrupted_stream) && delta.read(largest_stream) && delta.measurements() == 1801;
+
+	if (delta_ok)
+		cout << "changed_ranges() ok";
+	else
+		cout << "changed_ranges() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE SCANSIONI RIDOTTE*************/
+
+	//Le riduzioni a 1 grado di una scansione a 0.1 gradi devono coincidere con minimo e media calcolati direttamente sulle misurazioni attorno ad ogni
+	//angolo intero, ignorando i NaN; la stessa riduzione chiesta due volte deve essere la stessa vista, ricalcolata solo dopo una nuova scansione
+	cout << "Testing downsampled_scan(): " << endl;
+	LaserScannerDriver fine_lsd(0.1, 2);
+	fine_lsd.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	vector<double> fine_scan(fine_lsd.measurements());
+	for (int i = 0; i < fine_lsd.measurements(); i++)
+		fine_scan[i] = 1 + (i * 37 % 101) / 10.0;
+	fine_scan[0] = fine_scan[1] = fine_scan[2] = fine_scan[3] = fine_scan[4] = fine_scan[5] = -1;		//Primo gruppo (indici 0 - 4) tutto NaN
+	fine_scan[17] = -1;
+	fine_lsd.new_scan(fine_scan);
+
+	span<const double> coarse_min = fine_lsd.downsampled_scan(1, Downsampling::kMin);
+	span<const double> coarse_mean = fine_lsd.downsampled_scan(1.0, Downsampling::kMean);
+	bool downsampled_ok = coarse_min.size() == 181 && coarse_mean.size() == 181 && isnan(coarse_min[0]) && isnan(coarse_mean[0])
+		&& fine_lsd.downsampled_scan(1).data() == coarse_min.data();
+	for (int j = 1; j < 181 && downsampled_ok; j++)
+	{
+		double minimum = numeric_limits<double>::infinity(), sum = 0;
+		int valid = 0;
+		for (int i = max(j * 10 - 5, 0); i < min(j * 10 + 5, fine_lsd.measurements()); i++)
+			if (!isnan(fine_lsd.newest_scan()[i]))
+			{
+				minimum = min(minimum, fine_lsd.newest_scan()[i]);
+				sum += fine_lsd.newest_scan()[i];
+				valid++;
+			}
+		downsampled_ok = coarse_min[j] == minimum && abs(coarse_mean[j] - sum / valid) < 1e-12
+			&& fine_lsd.get_distance(j + 0.3, 1, Downsampling::kMin) == minimum;
+	}
+	try
+	{
+		fine_lsd.downsampled_scan(0.25);
+		downsampled_ok = false;
+	}
+	catch (const invalid_argument&)
+	{
+	}
+	fine_lsd.new_scan(vector<double>(fine_lsd.measurements(), 3));
+	coarse_min = fine_lsd.downsampled_scan(2);
+	downsampled_ok = downsampled_ok && coarse_min.size() == 91 && all_of(coarse_min.begin(), coarse_min.end(), [](double d) { return d == 3; })
+		&& fine_lsd.get_distance(180, 0.5, Downsampling::kMean) == 3;
+
+	//Dopo un assegnamento da un driver con un'altra risoluzione le riduzioni in cache con lo stesso fattore devono avere la nuova dimensione:
+	//da 0.1 a 0.2 gradi (riduzione a 2 gradi: fattore 10, da 181 a 91 misurazioni) e di nuovo a 0.1 gradi (riduzione a 1 grado: fattore 10, 181)
+	LaserScannerDriver other_lsd(0.2, 2);
+	other_lsd.new_scan(vector<double>(other_lsd.measurements(), 4));
+	fine_lsd = other_lsd;
+	coarse_min = fine_lsd.downsampled_scan(2);
+	downsampled_ok = downsampled_ok && coarse_min.size() == 91 && all_of(coarse_min.begin(), coarse_min.end(), [](double d) { return d == 4; });
+	LaserScannerDriver finer_lsd(0.1, 2);
+	finer_lsd.new_scan(vector<double>(finer_lsd.measurements(), 5));
+	fine_lsd = std::move(finer_lsd);
+	coarse_min = fine_lsd.downsampled_scan(1);
+	downsampled_ok = downsampled_ok && coarse_min.size() == 181 && all_of(coarse_min.begin(), coarse_min.end(), [](double d) { return d == 5; });
+
+	if (downsampled_ok)
+		cout << "downsampled_scan() ok";
+	else
+		cout << "downsampled_scan() error";
+
+	cout << endl << endl;
+
+	/*************TESTING DELLE MEMORY_RESOURCE*************/
+
+	//Un driver deve poter essere creato in un'arena grande esattamente storage_bytes() (più l'allineamento dell'inizio) che non può chiedere altra
+	//memoria. Con la guardia attiva le operazioni su un driver e sulle scansioni allocate da un'arena non devono raggiungere il free store,
+	//mentre get_scan() con l'allocatore predefinito deve essere rilevata come violazione
+	cout << "Testing memory resources: " << endl;
+	bool memory_ok = true;
+	{
+		vector<byte> exact_buffer(LaserScannerDriver::storage_bytes(0.5, 4) + 64);
+		pmr::monotonic_buffer_resource exact_arena(exact_buffer.data(), exact_buffer.size(), pmr::null_memory_resource());
+		LaserScannerDriver exact_lsd(0.5, 4, &exact_arena);
+		memory_ok = exact_lsd.memory_resource() == &exact_arena && exact_lsd.storage_bytes(0.5, 4) > 4 * exact_lsd.measurements() * sizeof(double);
+	}
+	{
+		vector<byte> arena_buffer(1 << 20);
+		pmr::monotonic_buffer_resource arena(arena_buffer.data(), arena_buffer.size(), pmr::null_memory_resource());
+		pmr::unsynchronized_pool_resource scan_pool(&arena);
+		LaserScannerDriver arena_lsd(1, 3, &arena);
+		MinFilter arena_filter(1, 2);
+
+		static uint64_t handled_violations;
+		handled_violations = 0;
+		HeapGuard::ViolationHandler previous_handler = HeapGuard::set_violation_handler([](size_t) { handled_violations++; });
+		uint64_t violations_before = HeapGuard::violations();
+		{
+			HeapGuard guard;
+			memory_ok = memory_ok && LaserScannerDriver::storage_bytes(1, 3) > 0;		//Dimensionare un'arena non deve allocare
+			arena_lsd.add_observer(&arena_filter);
+			for (int n = 0; n < 10; n++)
+			{
+				arena_lsd.new_scan(v1);
+				LaserScannerDriver snapshot(arena_lsd);	//Lo slot condiviso viene sostituito da uno slot allocato dall'arena
+				arena_lsd.new_scan(v2);
+				memory_ok = memory_ok && arena_lsd.min_distance(0, 180) <= arena_lsd.get_distance(90) && snapshot.size() == 1;
+				pmr::vector<double> oldest = arena_lsd.get_scan(&scan_pool);
+				pmr::vector<double> newest = arena_lsd.get_scan(&scan_pool);
+				memory_ok = memory_ok && oldest.size() == static_cast<size_t>(arena_lsd.measurements()) && oldest[0] == v1[0] && newest[0] == v2[0];
+			}
+			memory_ok = memory_ok && HeapGuard::armed() && HeapGuard::violations() == violations_before;
+
+			arena_lsd.new_scan(v2);
+			vector<double> heap_scan = arena_lsd.get_scan();
+			memory_ok = memory_ok && heap_scan[0] == v2[0] && HeapGuard::violations() == violations_before + kHeapGuardEnabled;
+		}
+		HeapGuard::set_violation_handler(previous_handler);
+		memory_ok = memory_ok && !HeapGuard::armed() && handled_violations == (kHeapGuardEnabled ? 1u : 0u);
+		arena_lsd.remove_observer(&arena_filter);
+	}
+
+	if (memory_ok)
+		cout << "memory resources ok";
+	else
+		cout << "memory resources error";
+
+	cout << endl << endl;
+
+	/*************TESTING DI COSTRUTTORE COPY E MOVE*************/
+
+	//Dentro metodo test_copy() si usa il copy constructor, al ritorno dal metodo verrà invocato il move constructor per assegnare l'rvalue temporaneo ritornato
+	cout << "Testing copy constructor: " << endl;;
+	const LaserScannerDriver move_lsd = test_copy(lsd, true); //Sarà possibile usare solo i metodi get_angular_resolution() e get_distance()
+
+	cout << endl;
+
+	cout << "Testing move constructor: " << endl;
+	test_contructor_assignment(lsd, move_lsd);
+	
+	cout << endl;
+
+
+	/*************TESTING DI ASSEGNAMENTO COPY E MOVE*************/
+
+	cout << "Testing copy assignment: " << endl;
+	LaserScannerDriver copy_lsd;
+	copy_lsd.new_scan(v1);
+	copy_lsd.new_scan(v2);
+	copy_lsd = lsd; //Copy assignment
+	test_contructor_assignment(lsd, copy_lsd);
+
+	cout << endl;
+
+	cout << "Testing move assigment: " << endl;
+	LaserScannerDriver move_lsd1;
+	move_lsd1.new_scan(v1);
+	move_lsd1.new_scan(v3);
+	move_lsd1.new_scan(v2);
+	move_lsd1 = test_copy(copy_lsd, false); //Move assignment
+	test_contructor_assignment(copy_lsd, move_lsd1);
+
+	cout << endl;
+
+
+	/*************TESTING DI CLEAR_BUFFER()*************/
+
+	cout << "clearing buffer..." << endl;
+	lsd.clear_buffer();
+	cout << lsd;
+
+	//ora invocare get_scan() dovrebbe dare problemi se lo scanner è vuoto
+	try
+	{
+		lsd.get_scan();
+		cout << "get_scan() successful. Test gone wrong";
+	}
+	catch (LaserScannerDriver::EmptyBufferException)
+	{
+		cout << "buffer is empty! Test is successful"; 
+	}
+
+	cout << endl << endl;
+
+
+	/*************TESTING COUT E MOVE E COPY ASSIGNMENT*************/
+
+	//Ora lsd è vuoto. Se move_lsd è stato fatto correttamente (cioè con una deep copy), dentro dovrebbero ancora esserci dei valori. Così come dentro copy_lsd, li stampo entrambi a schermo
+	cout << "Testing cout and deep copy effectiveness: " << endl;
+	cout << "move_lsd:" << endl << move_lsd << endl << endl;;
+	cout << "copy_lsd:" << endl << copy_lsd << endl;
+
+
+	/*************TESTING DI CONCURRENTLASERSCANNERDRIVER*************/
+
+	cout << "Testing concurrent producer/consumer (stress test): " << endl;
+	if (test_concurrent_stress(200000))
+		cout << "concurrent driver ok";
+	else
+		cout << "concurrent driver error";
+	cout << endl << endl;
+
+	cout << "Testing wait_scan(), subscribe() and full buffer policies: " << endl;
+	if (test_concurrent_policies(5000))
+		cout << "concurrent policies ok";
+	else
+		cout << "concurrent policies error";
+	cout << endl << endl;
+
+	/*************TESTING DI SCANSHAREDMEMORY*************/
+
+	cout << "Testing shared memory transport (reader in a child process): " << endl;
+	if (test_shared_memory(20000))
+		cout << "shared memory ok";
+	else
+		cout << "shared memory error";
+	cout << endl << endl;
+
+	/*************TESTING DI LASERSCANNERMANAGER*************/
+
+	cout << "Testing LaserScannerManager (two 180 degrees sensors): " << endl;
+	if (test_manager(2000))
+		cout << "manager ok";
+	else
+		cout << "manager error";
+	cout << endl;
+}
+
+
+/*!
+ * @brief Fa una copia dell'oggetto passato e la ritorna così da testare: copy, move constructor e move assignment
+ * @param copy_and_test vero se deve fare anche il test, falso altrimenti
+*/
+LaserScannerDriver test_copy(const LaserScannerDriver& lsd, bool copy_and_test)
+{
+	cout << "calling copy constuctor..." << endl;
+	LaserScannerDriver copy_lsd = lsd;
+
+	if(copy_and_test)
+		test_contructor_assignment(lsd, copy_lsd);
+
+	return copy_lsd;
+}
+
+/*!
+ * @brief Controlla se la copia dei dati ha avuto successo
+ * @param first Oggetto originale
+ * @param other Oggetto copiato
+*/
+void test_contructor_assignment(const LaserScannerDriver& first, const LaserScannerDriver& other)
+{
+	//Faccio un controllo solo su un valore (casuale) per evitare di inviare troppi valori in output che mi impediscono di vedere tutto l'output generato dal main (da VisualStudio almeno
+	//la finestra della console generata può contenere un numero massimo di righe) 
+
+	const int angle = rand() % (static_cast<int>(LaserScannerDriver::kMaxAngle + 1)); //Genero un numero casuale tra 0 e 180 (estremi inclusi)
+	double d1 = first.get_distance(angle);											  //Ritorno la distanza relativa a quell'angolo
+	double d2 = other.get_distance(angle);
+
+	cout << "original data: resolution = " << first.angular_resolution() << "; get_distance(" << angle << ") = " << d1 << endl;
+	cout << "copied/moved data: resolution = " << other.angular_resolution() << "; get_distance(" << angle << ") = " << d2 << endl;
+
+	if (first.angular_resolution() == other.angular_resolution())
+		cout << "angular resolution ok";
+	else
+		cout << "error copying angular resolution";
+
+	cout << endl;
+
+	if (d1 == d2)
+		cout << "value ok";
+	else
+		cout << "error while copying values";
+
+	cout << endl;
+}
+
+/*!
+ * @brief Stress test di ConcurrentLaserScannerDriver: un thread inserisce scans scansioni mentre un altro le preleva e legge l'ultima distanza.
+ * @details Ogni scansione k ha tutti i valori uguali a k: una scansione con valori diversi tra loro è stata letta mentre veniva sovrascritta.
+ * Le scansioni prelevate devono inoltre avere k strettamente crescente (le scansioni scartate a buffer pieno sono sempre le meno recenti)
+ * @return vero se non sono state lette scansioni "strappate" o fuori ordine, falso altrimenti
+*/
+bool test_concurrent_stress(int scans)
+{
+	ConcurrentLaserScannerDriver driver(0.1, 4);
+	bool ok = true;
+	long long received = 0;
+
+	thread producer([&driver, scans]()
+		{
+			vector<double> v(driver.measurements());
+			for (int k = 0; k < scans; k++)
+			{
+				fill(v.begin(), v.end(), static_cast<double>(k));
+				driver.new_scan(v);
+			}
+		});
+
+	thread consumer([&driver, &ok, &received, scans]()
+		{
+			double last = -1;
+			while (last < scans - 1)
+			{
+				try
+				{
+					vector<double> scan = driver.get_scan();
+					if (scan.front() <= last)
+						ok = false;
+					for (double value : scan)
+						if (value != scan.front())
+							ok = false;
+					last = scan.front();
+					received++;
+
+					//La scansione più recente letta dopo get_scan() non può essere meno recente di quella appena prelevata
+					double newest = driver.get_distance(90);
+					if (newest < last || newest != static_cast<int>(newest))
+						ok = false;
+				}
+				catch (ConcurrentLaserScannerDriver::EmptyBufferException)
+				{
+					//Il produttore non ha ancora inserito nulla di nuovo, riprovo
+				}
+			}
+		});
+
+	producer.join();
+	consumer.join();
+
+	cout << "received " << received << " of " << scans << " scans" << endl;
+	return ok && driver.is_empty();
+}
+
+bool test_concurrent_policies(int scans)
+{
+	bool ok = true;
+	vector<double> scan;
+	ConcurrentLaserScannerDriver::Clock::time_point timestamp;
+
+	//Buffer vuoto: wait_scan() deve attendere tutto il timeout e fallire
+	ConcurrentLaserScannerDriver empty(1, 2);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	ok = ok && !empty.wait_scan(scan, timestamp, chrono::milliseconds(20)) && chrono::steady_clock::now() - start >= chrono::milliseconds(20);
+
+	//kRejectNewest: a buffer pieno la nuova scansione viene scartata, le due più vecchie restano
+	ConcurrentLaserScannerDriver reject(1, 2, FullBufferPolicy::kRejectNewest);
+	vector<double> v(reject.measurements());
+	for (int k = 0; k < 3; k++)
+	{
+		fill(v.begin(), v.end(), k);
+		ok = ok && reject.new_scan(v) == (k == 2);
+	}
+	ok = ok && reject.get_scan().front() == 0 && reject.get_scan().front() == 1 && reject.is_empty();
+
+	//kOverwriteOldest: una scansione rifiutata dalla validazione a buffer pieno non deve scartare la meno recente
+	ConcurrentLaserScannerDriver overwrite(1, 2);
+	for (int k = 0; k < 2; k++)
+	{
+		fill(v.begin(), v.end(), k);
+		overwrite.new_scan(v);
+	}
+	fill(v.begin(), v.end(), -1);
+	try
+	{
+		overwrite.new_scan(v);
+		ok = false;
+	}
+	catch (const invalid_argument&)
+	{
+	}
+	ok = ok && overwrite.get_scan().front() == 0 && overwrite.get_scan().front() == 1 && overwrite.is_empty();
+
+	//Ultima misurazione con risoluzione 0.764: un angolo appena inferiore a 180 gradi non deve leggere il riempimento dello slot
+	ConcurrentLaserScannerDriver clamp(0.764, 1);
+	clamp.new_scan(vector<double>(clamp.measurements(), 1.0));
+	ok = ok && clamp.get_distance(179.99) == 1.0;
+
+	//kBlockProducer: il consumatore usa solo wait_scan() e deve ricevere tutte le scansioni, in ordine. Le funzioni registrate vengono chiamate
+	//una volta per scansione finchè non vengono rimosse
+	ConcurrentLaserScannerDriver blocking(0.5, 4, FullBufferPolicy::kBlockProducer);
+	atomic<int> notified{ 0 };
+	uint64_t subscription = blocking.subscribe([&notified](uint64_t sequence, ConcurrentLaserScannerDriver::Clock::time_point)
+		{
+			if (sequence == static_cast<uint64_t>(notified.load()))
+				notified++;
+		});
+	thread producer([&blocking, scans]()
+		{
+			vector<double> values(blocking.measurements());
+			for (int k = 0; k < scans; k++)
+			{
+				fill(values.begin(), values.end(), static_cast<double>(k));
+				if (blocking.new_scan(values))
+					return;		//Con kBlockProducer nessuna scansione può andare persa
+			}
+		});
+	int received = 0;
+	while (received < scans && blocking.wait_scan(scan, timestamp, chrono::seconds(5)))
+	{
+		ok = ok && scan.front() == received && scan.back() == received;
+		received++;
+	}
+	producer.join();
+	ok = ok && received == scans && notified == scans && blocking.unsubscribe(subscription) && !blocking.unsubscribe(subscription);
+	blocking.new_scan(scan);
+	ok = ok && notified == scans;
+
+	return ok;
+}
+
+/*!
+ * @brief Riempie il vector v passato per reference con i valori inclusi nel file fornito
+ * @return vero se la copia dei valori ha avuto successo, falso altrimenti
+*/
+bool fill(string file_name, vector<double>& v)
+{
+	try
+	{
+		//Il file viene mappato in memoria e letto con from_chars. I token che non sono numeri vengono ignorati volutamente,
+		//ScanFileLoader li riporta comunque nel risultato insieme alla loro posizione
+		ScanFileLoader loader(file_name);
+		loader.read_values(v);
+	}
+	catch (const runtime_error&)	//Se il file non è stato trovato ritorna falso
+	{
+		cout << "File not found";
+		return false;
+	}
+
+	return true;
+}
+
+/*!
+ * @brief Due LIDAR montati schiena contro schiena (orientamenti 0 e 180 gradi) inviano scansioni da due thread: ogni scansione del primo vale 1 ovunque,
+ * ogni scansione del secondo vale 2. Nella scansione unita gli angoli in (0, 180) devono valere 1, quelli in (180, 360) 2, e ai due angoli coperti
+ * da entrambi deve essere scelta la distanza minore
+ * @return true se il test ha avuto successo
+*/
+bool test_manager(int scans)
+{
+	LaserScannerManager manager({ SensorConfig{ 1, 0, 4 }, SensorConfig{ 0.5, 180, 4 } }, 1, 2);
+
+	//Timestamp espliciti, uguali per i due LIDAR e distanziati di 1 ms: le ultime scansioni hanno lo stesso timestamp e vengono unite
+	//qualunque sia l'ordine di esecuzione dei due thread (con Clock::now() un thread lento farebbe scartare l'altro LIDAR come troppo vecchio)
+	const LaserScannerManager::Clock::time_point start = LaserScannerManager::Clock::now() - chrono::milliseconds(scans);
+	auto producer = [&manager, scans, start](int sensor, double distance, double resolution)
+	{
+		vector<double> v(static_cast<int>(180 / resolution) + 1, distance);
+		for (int k = 0; k < scans; k++)
+			manager.new_scan(sensor, v, start + chrono::milliseconds(k));
+	};
+	thread first(producer, 0, 1.0, 1.0);
+	thread second(producer, 1, 2.0, 0.5);
+	first.join();
+	second.join();
+
+	MergedScan merged;
+	if (!manager.wait_merged_scan(merged, chrono::seconds(5)))
+		return false;
+
+	bool ok = static_cast<int>(merged.distances.size()) == manager.output_measurements() && merged.distances[0] == 1 && merged.distances[180] == 1;
+	for (int i = 1; i < 180; i++)
+		ok = ok && merged.distances[i] == 1 && merged.distances[180 + i] == 2;
+
+	for (int sensor = 0; sensor < manager.sensor_count(); sensor++)
+	{
+		SensorStats stats = manager.stats(sensor);
+		cout << "sensor " << sensor << ": received " << stats.received << ", dropped " << stats.dropped << ", stale " << stats.stale
+			<< ", merged " << stats.merged << ", max lag " << chrono::duration_cast<chrono::microseconds>(stats.max_lag).count() << " us" << endl;
+		ok = ok && stats.received == static_cast<uint64_t>(scans) && stats.merged <= stats.received - stats.dropped;
+	}
+	return ok;
+}
+
+/*!
+ * @brief Inserisce scans scansioni casuali (con qualche NaN) in un driver con i tre filtri registrati e confronta, ad ogni scansione e per ogni angolo,
+ * i valori filtrati con media esponenziale, mediana e minimo calcolati direttamente sulle scansioni inserite
+ * @return true se il test ha avuto successo
+*/
+bool test_filters(int scans, int window)
+{
+	constexpr double alpha = 0.25;
+	LaserScannerDriver driver(1, 2);
+	driver.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	EmaFilter ema(1, alpha);
+	MedianFilter median(1, window);
+	MinFilter minimum(1, window);
+	driver.add_observer(&ema);
+	driver.add_observer(&median);
+	driver.add_observer(&minimum);
+
+	mt19937 generator(7);
+	uniform_int_distribution<int> distance(-1, 9);		//Valori interi: molti duplicati. -1 viene sostituito da NaN (kMarkInvalid)
+	vector<vector<double>> history;
+	vector<double> expected_ema(driver.measurements(), nan(""));
+	auto same = [](double a, double b) { return (isnan(a) && (isnan(b) || isinf(b))) || a == b; };
+	bool ok = true;
+
+	for (int k = 0; k < scans && ok; k++)
+	{
+		vector<double> v(driver.measurements());
+		for (double& d : v)
+			d = distance(generator);
+		driver.new_scan(v);
+		history.emplace_back(driver.newest_scan().begin(), driver.newest_scan().end());
+
+		for (int i = 0; i < driver.measurements() && ok; i++)
+		{
+			double x = history.back()[i];
+			if (!isnan(x))
+				expected_ema[i] = isnan(expected_ema[i]) ? x : expected_ema[i] + alpha * (x - expected_ema[i]);
+
+			//Finestra delle ultime window misurazioni, con NaN considerato +infinito
+			vector<double> last;
+			for (size_t j = history.size() > static_cast<size_t>(window) ? history.size() - window : 0; j < history.size(); j++)
+				last.push_back(isnan(history[j][i]) ? INFINITY : history[j][i]);
+			sort(last.begin(), last.end());
+			size_t n = last.size();
+			double expected_median = n % 2 ? last[n / 2] : (last[n / 2 - 1] + last[n / 2]) / 2;
+
+			ok = same(ema.get_distance(i), expected_ema[i]) && same(median.get_distance(i), expected_median) && same(minimum.get_distance(i), last[0]);
+		}
+	}
+
+	//Dopo reset() il filtro non ha più scansioni
+	median.reset();
+	try
+	{
+		median.get_distance(0);
+		ok = false;
+	}
+	catch (const LaserScannerDriver::EmptyBufferException&)
+	{
+	}
+
+	//+infinito (nessun ritorno) è una misurazione valida: minimo e mediana di sole misurazioni +infinito sono +infinito, non NaN,
+	//e +infinito resta il minimo anche insieme ad un NaN
+	LaserScannerDriver inf_driver(1, 2);
+	inf_driver.set_invalid_value_policy(InvalidValuePolicy::kMarkInvalid);
+	MedianFilter inf_median(1, 2);
+	MinFilter inf_minimum(1, 2);
+	inf_driver.add_observer(&inf_median);
+	inf_driver.add_observer(&inf_minimum);
+	inf_driver.new_scan(vector<double>(inf_driver.measurements(), INFINITY));
+	inf_driver.new_scan(vector<double>(inf_driver.measurements(), INFINITY));
+	ok = ok && inf_median.get_distance(0) == INFINITY && inf_minimum.get_distance(0) == INFINITY;
+	inf_driver.new_scan(vector<double>(inf_driver.measurements(), -1));
+	ok = ok && isnan(inf_median.get_distance(0)) && inf_minimum.get_distance(0) == INFINITY;
+	return ok && ema.scans() == static_cast<uint64_t>(scans);
+}
+
+/*!
+ * @brief Pubblica scans scansioni da un driver con uno SharedScanPublisher registrato, mentre un processo figlio creato con fork() le legge dal segmento
+ * di memoria condivisa. Tutte le misurazioni della scansione k valgono k: il figlio controlla che ogni vista confermata da valid() sia uniforme e
+ * coerente con il proprio indice (nessuna scansione letta a metà di una sovrascrittura) e che arrivi anche l'ultima scansione
+ * @return true se il test ha avuto successo (sempre su Windows, dove il trasporto non è disponibile)
+*/
+bool test_shared_memory(int scans)
+{
+#ifdef _WIN32
+	return true;
+#else
+	const string name = "/lsdriver_test_" + to_string(getpid());
+	LaserScannerDriver driver(0.1, 2);
+	SharedScanPublisher publisher(name, 0.1, 4);
+	bool ok = true;
+
+	//Prima di qualsiasi pubblicazione il segmento è vuoto; un segmento inesistente non può essere aperto
+	{
+		SharedScanReader reader(name);
+		ok = reader.measurements() == driver.measurements() && reader.capacity() == 4 && reader.published() == 0;
+		try
+		{
+			reader.newest();
+			ok = false;
+		}
+		catch (const LaserScannerDriver::EmptyBufferException&)
+		{
+		}
+	}
+	try
+	{
+		SharedScanReader missing(name + "_missing");
+		ok = false;
+	}
+	catch (const runtime_error&)
+	{
+	}
+
+	cout.flush();		//Il figlio termina con _exit(): non deve ereditare output ancora nel buffer
+	pid_t child = fork();
+	if (child < 0)
+		return false;
+	if (child == 0)
+	{
+		//Processo lettore: legge la scansione più recente e, come un registratore, tutte le scansioni in ordine finchè non resta indietro
+		SharedScanReader reader(name);
+		auto consistent = [&reader](const SharedScanReader::ScanView& view, uint64_t& validated) {
+			bool uniform = all_of(view.scan.begin(), view.scan.end(), [&view](double d) { return d == static_cast<double>(view.index); });
+			if (!reader.valid(view))
+				return true;		//Sovrascritta durante la lettura: i valori vanno scartati, non è un errore
+			validated++;
+			return uniform;
+		};
+
+		bool child_ok = true;
+		uint64_t newest = 0, next = 0, validated = 0;
+		SharedScanReader::Clock::time_point last_timestamp{};
+		auto deadline = chrono::steady_clock::now() + chrono::seconds(60);
+		while (child_ok && newest + 1 < static_cast<uint64_t>(scans) && chrono::steady_clock::now() < deadline)
+		{
+			SharedScanReader::ScanView view;
+			try
+			{
+				view = reader.newest();
+			}
+			catch (const LaserScannerDriver::EmptyBufferException&)
+			{
+				this_thread::yield();
+				continue;
+			}
+			child_ok = consistent(view, validated) && view.index >= newest && view.timestamp >= last_timestamp;
+			newest = view.index;
+			last_timestamp = view.timestamp;
+
+			if (reader.scan(next, view))
+			{
+				child_ok = child_ok && consistent(view, validated);
+				next++;
+			}
+			else if (next < reader.published())
+				next = reader.published() - 1;		//Già sovrascritta: il registratore riparte dalla più recente
+		}
+		child_ok = child_ok && validated > 0 && newest + 1 == static_cast<uint64_t>(scans) && reader.get_distance(90) == scans - 1;
+		_exit(child_ok ? 0 : 1);
+	}
+
+	driver.add_observer(&publisher);
+	vector<double> v(driver.measurements());
+	for (int k = 0; k < scans; k++)
+	{
+		fill(v.begin(), v.end(), static_cast<double>(k));
+		driver.new_scan(v);
+	}
+	driver.remove_observer(&publisher);
+
+	//Le scansioni di un driver con un'altra risoluzione non vengono pubblicate
+	LaserScannerDriver other_driver(1, 2);
+	other_driver.add_observer(&publisher);
+	other_driver.new_scan(vector<double>(other_driver.measurements(), 7));
+	other_driver.remove_observer(&publisher);
+
+	int status = 0;
+	bool child_ok = waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	ok = ok && child_ok && publisher.published() == static_cast<uint64_t>(scans);
+
+	//Scrittura diretta nel segmento, senza passare dal driver
+	span<double> slot = publisher.begin_write();
+	fill(slot.begin(), slot.end(), 42.0);
+	publisher.commit();
+	SharedScanReader reader(name);
+	SharedScanReader::ScanView view;
+	ok = ok && reader.get_distance(10) == 42 && reader.scan(scans, view) && reader.valid(view) && !reader.scan(scans - 4, view);
+	return ok;
+#endif
+}
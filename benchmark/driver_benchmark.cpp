@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numbers>
+#include <new>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "CompactLaserScannerDriver.h"
+#include "LaserScannerDriver.h"
+#include "ScanExport.h"
+#include "ScanFilters.h"
+#include "ScanGeometry.h"
+#include "ScanOccupancy.h"
+#include "ScanSharedMemory.h"
+
+using namespace std;
+
+// Microbenchmark delle operazioni principali di LaserScannerDriver, al variare della risoluzione angolare e del numero di scansioni nel buffer.
+// Per ogni operazione vengono riportati:
+// - ns/op: tempo medio per operazione
+// - alloc/op e alloc B/op: allocazioni nel free store (e byte allocati) per operazione, contate sostituendo operator new
+// - copied B/op: byte di misurazioni che l'operazione deve copiare (valore calcolato dal benchmark, non misurato)
+//
+// Uso: lsdriver_benchmark [tempo minimo per misura in ms, default 100]
+
+namespace
+{
+	atomic<size_t> allocation_count{ 0 };
+	atomic<size_t> allocated_bytes{ 0 };
+
+	void* allocate(size_t size)
+	{
+		allocation_count.fetch_add(1, memory_order_relaxed);
+		allocated_bytes.fetch_add(size, memory_order_relaxed);
+		if (void* p = malloc(size > 0 ? size : 1))
+			return p;
+		throw bad_alloc();
+	}
+
+	void* allocate_aligned(size_t size, align_val_t align)
+	{
+		allocation_count.fetch_add(1, memory_order_relaxed);
+		allocated_bytes.fetch_add(size, memory_order_relaxed);
+		size_t alignment = static_cast<size_t>(align);
+#ifdef _MSC_VER
+		void* p = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+		//aligned_alloc richiede una dimensione multipla dell'allineamento
+		void* p = aligned_alloc(alignment, size > 0 ? (size + alignment - 1) / alignment * alignment : alignment);
+#endif
+		if (p)
+			return p;
+		throw bad_alloc();
+	}
+
+	void deallocate_aligned(void* p)
+	{
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, align_val_t align) { return allocate_aligned(size, align); }
+void* operator new[](size_t size, align_val_t align) { return allocate_aligned(size, align); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete[](void* p, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { deallocate_aligned(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { deallocate_aligned(p); }
+
+namespace
+{
+	constexpr int kCapacity = 8;
+	constexpr int kFilterWindow = 5;
+	const double kResolutions[] = { 0.1, 0.2, 0.25, 0.5, 0.764, 1 };
+	const int kOccupancies[] = { 1, kCapacity / 2, kCapacity };
+
+	volatile double sink;	//I risultati vengono scritti qui per evitare che il compilatore elimini le operazioni misurate
+
+	/*!
+	 * @brief streambuf che scarta tutto ciò che riceve: misura la formattazione di operator<< senza il costo della console
+	*/
+	class NullBuffer : public streambuf
+	{
+	protected:
+		int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+		streamsize xsputn(const char*, streamsize n) override { return n; }
+	};
+
+	struct Measure
+	{
+		double ns_per_op;
+		double allocations_per_op;
+		double allocated_bytes_per_op;
+	};
+
+	/*!
+	 * @brief Esegue op un numero di volte crescente finchè la misura non dura almeno min_time
+	*/
+	template <class Op>
+	Measure measure(Op op, chrono::nanoseconds min_time)
+	{
+		op();	//Riscaldamento: cache e eventuali allocazioni iniziali
+		for (long long iterations = 1; ; iterations *= 2)
+		{
+			size_t allocations_before = allocation_count.load(memory_order_relaxed);
+			size_t bytes_before = allocated_bytes.load(memory_order_relaxed);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (long long i = 0; i < iterations; i++)
+				op();
+			chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+
+			if (elapsed >= min_time)
+			{
+				double n = static_cast<double>(iterations);
+				return Measure{ elapsed.count() / n,
+					(allocation_count.load(memory_order_relaxed) - allocations_before) / n,
+					(allocated_bytes.load(memory_order_relaxed) - bytes_before) / n };
+			}
+		}
+	}
+
+	void print_header()
+	{
+		cout << left << setw(26) << "benchmark" << right << setw(11) << "resolution" << setw(14) << "measurements" << setw(11) << "occupancy"
+			<< setw(13) << "ns/op" << setw(11) << "alloc/op" << setw(13) << "alloc B/op" << setw(13) << "copied B/op" << endl;
+	}
+
+	void print_row(const string& name, const LaserScannerDriver& lsd, int occupancy, const Measure& m, size_t copied_bytes)
+	{
+		cout << left << setw(26) << name << right << fixed << setprecision(3) << setw(11) << lsd.angular_resolution()
+			<< setw(14) << lsd.measurements() << setw(11) << occupancy << setprecision(1) << setw(13) << m.ns_per_op
+			<< setprecision(2) << setw(11) << m.allocations_per_op << setprecision(0) << setw(13) << m.allocated_bytes_per_op
+			<< setw(13) << copied_bytes << endl;
+	}
+
+	vector<double> random_scan(int measurements, mt19937& generator)
+	{
+		uniform_real_distribution<double> distance(0, 20);
+		vector<double> v(measurements);
+		for (double& d : v)
+			d = distance(generator);
+		return v;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	chrono::nanoseconds min_time = chrono::milliseconds(argc > 1 ? atoi(argv[1]) : 100);
+	mt19937 generator(42);
+	NullBuffer null_buffer;
+	ostream null_stream(&null_buffer);
+
+	cout << "LaserScannerDriver benchmark, buffer capacity " << kCapacity << endl;
+	print_header();
+
+	for (double resolution : kResolutions)
+	{
+		LaserScannerDriver lsd(resolution, kCapacity);
+		const size_t scan_bytes = lsd.measurements() * sizeof(double);
+		const vector<double> scan = random_scan(lsd.measurements(), generator);
+		uniform_real_distribution<double> angle_distribution(0, LaserScannerDriver::kMaxAngle);
+		vector<double> angles(1024);
+		for (double& a : angles)
+			a = angle_distribution(generator);
+
+		for (int occupancy : kOccupancies)
+		{
+			lsd.clear_buffer();
+			for (int i = 0; i < occupancy; i++)
+				lsd.new_scan(scan);
+
+			//A buffer pieno new_scan() sovrascrive sempre la scansione meno recente: la misura ha senso solo con occupancy == capacità
+			if (occupancy == kCapacity)
+			{
+				print_row("new_scan (overwrite)", lsd, occupancy, measure([&] { lsd.new_scan(scan); }, min_time), scan_bytes);
+
+				//Costo aggiunto a new_scan() da un filtro temporale registrato (finestra di kFilterWindow scansioni)
+				EmaFilter ema(resolution, 0.3);
+				MedianFilter median(resolution, kFilterWindow);
+				MinFilter minimum(resolution, kFilterWindow);
+				for (auto [name, filter] : { pair<const char*, ScanFilter*>{ "new_scan + EMA", &ema },
+					pair<const char*, ScanFilter*>{ "new_scan + median", &median }, pair<const char*, ScanFilter*>{ "new_scan + min", &minimum } })
+				{
+					lsd.add_observer(filter);
+					print_row(name, lsd, occupancy, measure([&] { lsd.new_scan(scan); }, min_time), scan_bytes);
+					lsd.remove_observer(filter);
+				}
+
+				//Griglia di occupazione di 200x200 celle da 5 cm: ogni new_scan() aggiunge la nuova scansione e sottrae quella sovrascritta
+				OccupancyGrid grid(resolution);
+				grid.rebuild(lsd);
+				lsd.add_observer(&grid);
+				print_row("new_scan + occupancy grid", lsd, occupancy, measure([&] { lsd.new_scan(scan); }, min_time), scan_bytes);
+				lsd.remove_observer(&grid);
+
+#ifndef _WIN32
+				//Replica nel segmento di memoria condivisa (una copia per scansione) e lettura da un lettore dello stesso processo, senza copie
+				SharedScanPublisher publisher("/lsdriver_benchmark", resolution, kCapacity + 1);
+				SharedScanReader reader(publisher.name());
+				lsd.add_observer(&publisher);
+				print_row("new_scan + shm publish", lsd, occupancy, measure([&] { lsd.new_scan(scan); }, min_time), 2 * scan_bytes);
+				lsd.remove_observer(&publisher);
+				size_t next_angle = 0;
+				print_row("shm get_distance", lsd, occupancy, measure([&] {
+					sink = reader.get_distance(angles[next_angle]);
+					next_angle = (next_angle + 1) % angles.size();
+					}, min_time), 0);
+#endif
+			}
+
+			//get_scan() seguito da new_scan(): il numero di scansioni nel buffer resta occupancy
+			print_row("get_scan + new_scan", lsd, occupancy, measure([&] {
+				sink = lsd.get_scan()[0];
+				lsd.new_scan(scan);
+				}, min_time), 2 * scan_bytes);
+
+			size_t next_angle = 0;
+			print_row("get_distance", lsd, occupancy, measure([&] {
+				sink = lsd.get_distance(angles[next_angle]);
+				next_angle = (next_angle + 1) % angles.size();
+				}, min_time), 0);
+
+			//Ricerca binaria sugli istanti di acquisizione e interpolazione tra le due scansioni vicine, con istanti distribuiti su tutto il buffer
+			vector<LaserScannerDriver::Clock::time_point> times(angles.size());
+			for (size_t i = 0; i < times.size(); i++)
+				times[i] = lsd.timestamp(0) + (lsd.timestamp(lsd.size() - 1) - lsd.timestamp(0)) * i / times.size();
+			print_row("get_distance(angle, t)", lsd, occupancy, measure([&] {
+				sink = lsd.get_distance(angles[next_angle], times[next_angle]);
+				next_angle = (next_angle + 1) % angles.size();
+				}, min_time), 0);
+
+			//Riduzione a circa 1 grado (multiplo della risoluzione): calcolata una volta per scansione (new_scan() la invalida) e poi letta dalla cache
+			const double coarse = resolution * max(1L, lround(1 / resolution));
+			print_row("new_scan + downsample", lsd, occupancy, measure([&] {
+				lsd.take_scan().release();
+				lsd.new_scan(scan);
+				sink = lsd.downsampled_scan(coarse, Downsampling::kMin)[0];
+				}, min_time), scan_bytes);
+			print_row("get_distance(a, coarse)", lsd, occupancy, measure([&] {
+				sink = lsd.get_distance(angles[next_angle], coarse, Downsampling::kMin);
+				next_angle = (next_angle + 1) % angles.size();
+				}, min_time), 0);
+
+			//Ambiente statico (tutte le scansioni uguali): il confronto con la scansione precedente non trova intervalli cambiati
+			vector<ScanRange> ranges;
+			print_row("changed_ranges", lsd, occupancy, measure([&] {
+				sink = lsd.changed_ranges(0.01, ranges);
+				}, min_time), 0);
+
+			//Le scansioni sono condivise con la copia (copy-on-write): nessuna misurazione viene copiata
+			print_row("copy constructor", lsd, occupancy, measure([&] {
+				LaserScannerDriver copy(lsd);
+				sink = copy.size();
+				}, min_time), 0);
+
+			//Copia "istantanea" seguita da una nuova scansione mentre la copia è ancora in vita: lo slot da sovrascrivere è condiviso e va sostituito.
+			//La scansione meno recente viene rimossa (senza copiarla) per mantenere occupancy scansioni nel buffer
+			print_row("snapshot + new_scan", lsd, occupancy, measure([&] {
+				LaserScannerDriver snapshot(lsd);
+				lsd.take_scan().release();
+				lsd.new_scan(scan);
+				sink = snapshot.size();
+				}, min_time), scan_bytes);
+
+			//Il move constructor lascia lsd vuoto: il move assignment lo ripristina per la prossima iterazione
+			print_row("move ctor + move assign", lsd, occupancy, measure([&] {
+				LaserScannerDriver moved(std::move(lsd));
+				lsd = std::move(moved);
+				}, min_time), 0);
+
+			print_row("operator<<", lsd, occupancy, measure([&] { null_stream << lsd; }, min_time), 0);
+
+			//Esportazione della scansione più recente nei tre formati (stesso stream di operator<<)
+			ScanExporter csv(ExportFormat::kCsv), json(ExportFormat::kJsonLines), binary(ExportFormat::kBinary);
+			print_row("export CSV", lsd, occupancy, measure([&] { csv.write_newest(null_stream, lsd); }, min_time), 0);
+			print_row("export JSON lines", lsd, occupancy, measure([&] { json.write_newest(null_stream, lsd); }, min_time), 0);
+			print_row("export binary", lsd, occupancy, measure([&] { binary.write_newest(null_stream, lsd); }, min_time), 0);
+
+			//Conversione in coordinate cartesiane con la tabella precalcolata, confrontata con il calcolo diretto di seno e coseno per ogni misurazione
+			vector<double> x(lsd.measurements());
+			vector<double> y(lsd.measurements());
+			print_row("get_points", lsd, occupancy, measure([&] {
+				lsd.get_points(x, y);
+				sink = x[0];
+				}, min_time), 0);
+			print_row("get_points + mounting", lsd, occupancy, measure([&] {
+				lsd.get_points(x, y, MountingTransform{ 0.1, -0.2, 45 });
+				sink = x[0];
+				}, min_time), 0);
+			print_row("std::sin/cos reference", lsd, occupancy, measure([&] {
+				span<const double> newest = lsd.newest_scan();
+				for (int i = 0; i < lsd.measurements(); i++)
+				{
+					double angle = i * resolution * numbers::pi / 180;
+					x[i] = newest[i] * cos(angle);
+					y[i] = newest[i] * sin(angle);
+				}
+				sink = x[0];
+				}, min_time), 0);
+
+			//Distanza minima tra 60 e 120 gradi: con l'indice già costruito, con la costruzione dell'indice (nuova scansione ad ogni interrogazione)
+			//e con una chiamata a get_distance() per ogni misurazione dell'intervallo
+			print_row("min_distance", lsd, occupancy, measure([&] { sink = lsd.min_distance(60, 120); }, min_time), 0);
+			if (occupancy == kCapacity)
+				print_row("new_scan + min_distance", lsd, occupancy, measure([&] {
+					lsd.new_scan(scan);
+					sink = lsd.min_distance(60, 120);
+					}, min_time), scan_bytes);
+			print_row("get_distance loop (min)", lsd, occupancy, measure([&] {
+				double minimum = lsd.get_distance(60);
+				for (double angle = 60 + resolution; angle <= 120; angle += resolution)
+					minimum = min(minimum, lsd.get_distance(angle));
+				sink = minimum;
+				}, min_time), 0);
+
+			//CompactLaserScannerDriver a buffer pieno: conversione in new_scan() e in get_scan() per ogni precisione. copied B/op è la dimensione
+			//della scansione memorizzata, a cui si aggiunge (per get_scan) la scansione convertita in double
+			if (occupancy == kCapacity)
+				for (auto [name, precision] : { pair<string, StoragePrecision>{ "double", StoragePrecision::kDouble },
+					pair<string, StoragePrecision>{ "float", StoragePrecision::kFloat }, pair<string, StoragePrecision>{ "fixed16", StoragePrecision::kFixed16 } })
+				{
+					CompactLaserScannerDriver compact(resolution, kCapacity, precision);
+					vector<double> read(compact.measurements());
+					for (int i = 0; i < kCapacity; i++)
+						compact.new_scan(scan);
+					const size_t stored_bytes = compact.measurements() * static_cast<size_t>(storage_size(precision));
+					print_row("compact new_scan " + name, lsd, occupancy, measure([&] { compact.new_scan(scan); }, min_time), stored_bytes);
+					print_row("compact get+new " + name, lsd, occupancy, measure([&] {
+						compact.get_scan(read);
+						compact.new_scan(scan);
+						sink = read[0];
+						}, min_time), 2 * stored_bytes);
+				}
+		}
+	}
+
+	return 0;
+}